@@ -0,0 +1,252 @@
+// Native benchmarks of all reduction kernels over synthetic index
+// distributions, bypassing the Python and autograd dispatch overhead.
+//
+// Results are reported as bytes and items (entries of `src`) per second.
+// Pass `--benchmark_format=json` (or `--benchmark_out=<file>
+// --benchmark_out_format=json`) for machine-readable output, and
+// `--benchmark_filter=<regex>` to select a subset, e.g.,
+// `--benchmark_filter='segment_csr_cuda/power_law/float/K:64'`.
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <torch/torch.h>
+
+#include "cpu/scatter_cpu.h"
+#include "cpu/segment_coo_cpu.h"
+#include "cpu/segment_csr_cpu.h"
+
+#ifdef WITH_CUDA
+#include <ATen/cuda/CUDAContext.h>
+
+#include "cuda/scatter_cuda.h"
+#include "cuda/segment_coo_cuda.h"
+#include "cuda/segment_csr_cuda.h"
+#endif
+
+// The number of elements of `src` (*not* entries) in each problem, such that
+// problems of all `K` read the same amount of memory.
+#define NUMEL (1 << 24)
+
+enum class Distribution { UNIFORM, POWER_LAW, SHORT_ROWS, LONG_ROWS };
+
+const std::vector<std::pair<Distribution, std::string>> distributions = {
+    {Distribution::UNIFORM, "uniform"},
+    {Distribution::POWER_LAW, "power_law"},
+    {Distribution::SHORT_ROWS, "short_rows"},
+    {Distribution::LONG_ROWS, "long_rows"},
+};
+
+const std::vector<std::pair<torch::ScalarType, std::string>> dtypes = {
+    {torch::kHalf, "half"},
+    {torch::kFloat, "float"},
+    {torch::kDouble, "double"},
+};
+
+const std::vector<int64_t> Ks = {1, 16, 64};
+
+const std::vector<std::string> reduces = {"sum", "mean", "min", "max"};
+
+struct Problem {
+  torch::Tensor src;    // [E, K]
+  torch::Tensor index;  // [E], sorted
+  torch::Tensor indptr; // [N + 1]
+  torch::Tensor out;    // [N, K]
+};
+
+// Returns a sorted `index` of `E` entries pointing to `N` rows, whose row
+// lengths follow the given distribution.
+torch::Tensor make_index(Distribution distribution, int64_t E) {
+  torch::manual_seed(12345);
+  switch (distribution) {
+  case Distribution::UNIFORM: // Rows hold 16 entries on average.
+    return std::get<0>(torch::randint(E / 16, {E}, torch::kLong).sort());
+  case Distribution::POWER_LAW: { // Zipf-like row lengths with exponent ~2.
+    auto N = std::max<int64_t>(E / 16, 1);
+    auto weight = torch::rand({N}, torch::kDouble).pow(-1.0).clamp_max(1e6);
+    return std::get<0>(torch::multinomial(weight, E, true).sort());
+  }
+  case Distribution::SHORT_ROWS: // Rows hold 2 entries on average.
+    return std::get<0>(torch::randint(E / 2, {E}, torch::kLong).sort());
+  case Distribution::LONG_ROWS: // Rows hold 4096 entries on average.
+    return std::get<0>(
+        torch::randint(std::max<int64_t>(E / 4096, 1), {E}, torch::kLong)
+            .sort());
+  }
+  AT_ERROR("Unknown distribution");
+}
+
+Problem make_problem(Distribution distribution, torch::ScalarType dtype,
+                     int64_t K, torch::Device device) {
+  auto E = NUMEL / K;
+  auto index = make_index(distribution, E);
+  auto N = index[-1].item<int64_t>() + 1;
+  auto count = torch::bincount(index, {}, N);
+  auto indptr = torch::cat({count.new_zeros({1}), count.cumsum(0)});
+
+  Problem problem;
+  problem.src = torch::randn({E, K}, torch::dtype(dtype)).to(device);
+  problem.index = index.to(device);
+  problem.indptr = indptr.to(device);
+  problem.out = torch::randn({N, K}, torch::dtype(dtype)).to(device);
+  return problem;
+}
+
+void synchronize(torch::Device device) {
+#ifdef WITH_CUDA
+  if (device.is_cuda())
+    AT_CUDA_CHECK(cudaStreamSynchronize(at::cuda::getCurrentCUDAStream()));
+#endif
+}
+
+// Runs `fn(problem)` repeatedly and reports the bytes moved by reading
+// `src`, `index` or `indptr` and writing (reductions) or reading (gathers)
+// `out`.
+template <typename Fn>
+void run(benchmark::State &state, Distribution distribution,
+         torch::ScalarType dtype, int64_t K, torch::Device device,
+         bool uses_indptr, Fn fn) {
+  torch::NoGradGuard no_grad;
+  auto problem = make_problem(distribution, dtype, K, device);
+
+  fn(problem); // Warm-up of allocator and kernel caches.
+  synchronize(device);
+
+#ifdef WITH_CUDA
+  cudaEvent_t start, stop;
+  if (device.is_cuda()) {
+    AT_CUDA_CHECK(cudaEventCreate(&start));
+    AT_CUDA_CHECK(cudaEventCreate(&stop));
+  }
+#endif
+
+  for (auto _ : state) {
+#ifdef WITH_CUDA
+    if (device.is_cuda()) {
+      auto stream = at::cuda::getCurrentCUDAStream();
+      AT_CUDA_CHECK(cudaEventRecord(start, stream));
+      fn(problem);
+      AT_CUDA_CHECK(cudaEventRecord(stop, stream));
+      AT_CUDA_CHECK(cudaEventSynchronize(stop));
+      float ms;
+      AT_CUDA_CHECK(cudaEventElapsedTime(&ms, start, stop));
+      state.SetIterationTime(ms / 1000.0);
+      continue;
+    }
+#endif
+    auto start_time = std::chrono::high_resolution_clock::now();
+    fn(problem);
+    auto stop_time = std::chrono::high_resolution_clock::now();
+    state.SetIterationTime(
+        std::chrono::duration<double>(stop_time - start_time).count());
+  }
+
+#ifdef WITH_CUDA
+  if (device.is_cuda()) {
+    AT_CUDA_CHECK(cudaEventDestroy(start));
+    AT_CUDA_CHECK(cudaEventDestroy(stop));
+  }
+#endif
+
+  auto index = uses_indptr ? problem.indptr : problem.index;
+  int64_t bytes = problem.src.nbytes() + index.nbytes() + problem.out.nbytes();
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.SetItemsProcessed(state.iterations() * problem.src.size(0));
+  state.counters["E"] = problem.src.size(0);
+  state.counters["N"] = problem.out.size(0);
+}
+
+template <typename Fn>
+void register_benchmark(const std::string &name, torch::Device device,
+                        bool uses_indptr, Fn fn) {
+  for (const auto &distribution : distributions) {
+    for (const auto &dtype : dtypes) {
+      for (auto K : Ks) {
+        auto full_name = name + "/" + distribution.second + "/" +
+                         dtype.second + "/K:" + std::to_string(K);
+        benchmark::RegisterBenchmark(
+            full_name.c_str(),
+            [=](benchmark::State &state) {
+              run(state, distribution.first, dtype.first, K, device,
+                  uses_indptr, fn);
+            })
+            ->UseManualTime()
+            ->Unit(benchmark::kMicrosecond);
+      }
+    }
+  }
+}
+
+void register_benchmarks(torch::Device device) {
+  std::string suffix = device.is_cuda() ? "_cuda" : "_cpu";
+
+  for (const auto &reduce : reduces) {
+    register_benchmark("scatter" + suffix + "/" + reduce, device, false,
+                       [=](const Problem &p) {
+                         auto N = p.out.size(0);
+#ifdef WITH_CUDA
+                         if (p.src.is_cuda())
+                           return scatter_cuda(p.src, p.index, 0,
+                                               torch::nullopt, N, reduce);
+#endif
+                         return scatter_cpu(p.src, p.index, 0, torch::nullopt,
+                                            N, reduce);
+                       });
+
+    register_benchmark("segment_coo" + suffix + "/" + reduce, device, false,
+                       [=](const Problem &p) {
+                         auto N = p.out.size(0);
+#ifdef WITH_CUDA
+                         if (p.src.is_cuda())
+                           return segment_coo_cuda(p.src, p.index,
+                                                   torch::nullopt, N, reduce);
+#endif
+                         return segment_coo_cpu(p.src, p.index, torch::nullopt,
+                                                N, reduce);
+                       });
+
+    register_benchmark("segment_csr" + suffix + "/" + reduce, device, true,
+                       [=](const Problem &p) {
+#ifdef WITH_CUDA
+                         if (p.src.is_cuda())
+                           return segment_csr_cuda(p.src, p.indptr,
+                                                   torch::nullopt, reduce);
+#endif
+                         return segment_csr_cpu(p.src, p.indptr,
+                                                torch::nullopt, reduce);
+                       });
+  }
+
+  register_benchmark("gather_coo" + suffix, device, false,
+                     [=](const Problem &p) {
+#ifdef WITH_CUDA
+                       if (p.src.is_cuda())
+                         return gather_coo_cuda(p.out, p.index, torch::nullopt);
+#endif
+                       return gather_coo_cpu(p.out, p.index, torch::nullopt);
+                     });
+
+  register_benchmark("gather_csr" + suffix, device, true,
+                     [=](const Problem &p) {
+#ifdef WITH_CUDA
+                       if (p.src.is_cuda())
+                         return gather_csr_cuda(p.out, p.indptr,
+                                                torch::nullopt);
+#endif
+                       return gather_csr_cpu(p.out, p.indptr, torch::nullopt);
+                     });
+}
+
+int main(int argc, char **argv) {
+  register_benchmarks(torch::kCPU);
+#ifdef WITH_CUDA
+  if (torch::cuda::is_available())
+    register_benchmarks(torch::kCUDA);
+#endif
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
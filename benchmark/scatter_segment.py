@@ -137,6 +137,16 @@ def timing(dataset):
     def seg_csr(x):
         return segment_csr(x, rowptr, reduce=args.reduce)
 
+    def deterministic(func):
+        def wrapper(x):
+            torch.use_deterministic_algorithms(True)
+            try:
+                return func(x)
+            finally:
+                torch.use_deterministic_algorithms(False)
+
+        return wrapper
+
     def dense1(x):
         return getattr(torch, args.reduce)(x, dim=-2)
 
@@ -144,6 +154,8 @@ def timing(dataset):
         return getattr(torch, args.reduce)(x, dim=-1)
 
     t1, t2, t3, t4, t5, t6, t7, t8 = [], [], [], [], [], [], [], []
+    t9, t10, t11 = [], [], []
+    with_det = args.reduce in ['sum', 'mean'] and args.device != 'cpu'
 
     for size in sizes:
         try:
@@ -157,6 +169,11 @@ def timing(dataset):
             t5 += [time_func(seg_coo, x)]
             t6 += [time_func(seg_csr, x)]
 
+            if with_det:
+                t9 += [time_func(deterministic(sca2_row), x)]
+                t10 += [time_func(deterministic(sca2_col), x)]
+                t11 += [time_func(deterministic(seg_coo), x)]
+
             del x
 
         except RuntimeError as e:
@@ -165,6 +182,9 @@ def timing(dataset):
             torch.cuda.empty_cache()
             for t in (t1, t2, t3, t4, t5, t6):
                 t.append(float('inf'))
+            if with_det:
+                for t in (t9, t10, t11):
+                    t.append(float('inf'))
 
         try:
             x = torch.randn((dim_size, int(avg_row_len + 1), size),
@@ -207,6 +227,13 @@ def timing(dataset):
                     [bold(f'{t:.5f}', f) for t, f in zip(t7, winner[6])]))
     print('\t'.join([bold('DENSE2  ')] +
                     [bold(f'{t:.5f}', f) for t, f in zip(t8, winner[7])]))
+
+    if with_det:  # Deterministic timings and their overhead over atomics:
+        for label, ts, ref in [('DSCA2ROW', t9, t3), ('DSCA2COL', t10, t4),
+                               ('DSEG_COO', t11, t5)]:
+            print('\t'.join([bold(label)] + [f'{t:.5f}' for t in ts]))
+            print('\t'.join([bold('  OVERHD')] +
+                             [f'{t / r:.2f}x' for t, r in zip(ts, ref)]))
     print()
 
 
@@ -4,9 +4,40 @@
 
 #define MAX_TENSORINFO_DIMS 25
 
-template <typename scalar_t> struct TensorInfo {
-  TensorInfo(scalar_t *p, int dim, int sz[MAX_TENSORINFO_DIMS],
-             int st[MAX_TENSORINFO_DIMS]) {
+// Selects 64-bit offset arithmetic in case any of the given tensors holds
+// more elements than can be addressed via 32-bit integers, and the faster
+// 32-bit arithmetic otherwise.
+#define AT_DISPATCH_OFFSET_TYPES(use_64bit, ...)                               \
+  [&] {                                                                        \
+    if (use_64bit) {                                                           \
+      using offset_t = int64_t;                                                \
+      return __VA_ARGS__();                                                    \
+    } else {                                                                   \
+      using offset_t = int;                                                    \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+  }()
+
+inline bool use_64bit_offsets(const std::vector<torch::Tensor> &tensors) {
+  for (const auto &tensor : tensors)
+    if (tensor.numel() > std::numeric_limits<int>::max())
+      return true;
+  return false;
+}
+
+// Whether `index` holds the same value for all entries along the dimensions
+// following `dim`, e.g., because it got broadcasted from a lower-dimensional
+// tensor.
+inline bool index_is_broadcasted(const torch::Tensor &index, int64_t dim) {
+  for (auto i = dim + 1; i < index.dim(); i++)
+    if (index.size(i) > 1 && index.stride(i) != 0)
+      return false;
+  return true;
+}
+
+template <typename scalar_t, typename offset_t = int> struct TensorInfo {
+  TensorInfo(scalar_t *p, int dim, offset_t sz[MAX_TENSORINFO_DIMS],
+             offset_t st[MAX_TENSORINFO_DIMS]) {
     data = p;
     dims = dim;
     AT_ASSERT(dims < MAX_TENSORINFO_DIMS);
@@ -19,14 +50,14 @@ template <typename scalar_t> struct TensorInfo {
 
   scalar_t *data;
   int dims;
-  int sizes[MAX_TENSORINFO_DIMS];
-  int strides[MAX_TENSORINFO_DIMS];
+  offset_t sizes[MAX_TENSORINFO_DIMS];
+  offset_t strides[MAX_TENSORINFO_DIMS];
 };
 
-template <typename scalar_t>
-TensorInfo<scalar_t> getTensorInfo(const torch::Tensor &tensor) {
-  int sizes[MAX_TENSORINFO_DIMS];
-  int strides[MAX_TENSORINFO_DIMS];
+template <typename scalar_t, typename offset_t = int>
+TensorInfo<scalar_t, offset_t> getTensorInfo(const torch::Tensor &tensor) {
+  offset_t sizes[MAX_TENSORINFO_DIMS];
+  offset_t strides[MAX_TENSORINFO_DIMS];
 
   int dims = tensor.dim();
   for (int i = 0; i < dims; ++i) {
@@ -34,13 +65,14 @@ TensorInfo<scalar_t> getTensorInfo(const torch::Tensor &tensor) {
     strides[i] = tensor.stride(i);
   }
 
-  return TensorInfo<scalar_t>(tensor.data_ptr<scalar_t>(), dims, sizes,
-                              strides);
+  return TensorInfo<scalar_t, offset_t>(tensor.data_ptr<scalar_t>(), dims,
+                                        sizes, strides);
 }
 
-template <typename scalar_t> struct IndexToOffset {
-  static inline int get(int idx, const TensorInfo<scalar_t> &info) {
-    int offset = 0;
+template <typename scalar_t, typename offset_t = int> struct IndexToOffset {
+  static inline offset_t get(offset_t idx,
+                             const TensorInfo<scalar_t, offset_t> &info) {
+    offset_t offset = 0;
     for (int i = info.dims - 1; i >= 0; --i) {
       offset += (idx % info.sizes[i]) * info.strides[i];
       idx /= info.sizes[i];
@@ -49,9 +81,36 @@ template <typename scalar_t> struct IndexToOffset {
   }
 };
 
-template <typename scalar_t> struct IndexPtrToOffset {
-  static inline int get(int idx, const TensorInfo<scalar_t> &info) {
-    int offset = idx % (info.sizes[info.dims - 1] - 1);
+// Returns the offsets of all entries spanned by dimensions `[start, end)` of
+// `info` in row-major order. Offsets are computed via incremental counters
+// instead of dividing each linear index by all sizes as in `IndexToOffset`.
+template <typename scalar_t, typename offset_t>
+std::vector<offset_t> getOffsets(const TensorInfo<scalar_t, offset_t> &info,
+                                 int start, int end) {
+  int64_t numel = 1;
+  for (int i = start; i < end; i++)
+    numel *= info.sizes[i];
+
+  std::vector<offset_t> offsets(numel);
+  std::vector<offset_t> counter(MAX_TENSORINFO_DIMS, 0);
+  offset_t offset = 0;
+  for (int64_t n = 0; n < numel; n++) {
+    offsets[n] = offset;
+    for (int i = end - 1; i >= start; i--) {
+      offset += info.strides[i];
+      if (++counter[i] < info.sizes[i])
+        break;
+      offset -= counter[i] * info.strides[i];
+      counter[i] = 0;
+    }
+  }
+  return offsets;
+}
+
+template <typename scalar_t, typename offset_t = int> struct IndexPtrToOffset {
+  static inline offset_t get(offset_t idx,
+                             const TensorInfo<scalar_t, offset_t> &info) {
+    offset_t offset = idx % (info.sizes[info.dims - 1] - 1);
     offset *= info.strides[info.dims - 1];
     idx /= info.sizes[info.dims - 1] - 1;
     for (int i = info.dims - 2; i >= 0; --i) {
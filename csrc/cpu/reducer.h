@@ -1,9 +1,17 @@
 #pragma once
 
+#include <ATen/AccumulateType.h>
+#include <ATen/cpu/vec/vec.h>
+
 #include <limits>
 #include <map>
+#include <type_traits>
+#include <vector>
 
-enum ReductionType { SUM, MEAN, MUL, DIV, MIN, MAX };
+// VAR, STD and LOGSUMEXP need more than a single value of running state, and
+// are therefore only supported by the segment kernels via `Welford` and
+// `LogSumExp` (dispatched via `AT_DISPATCH_STAT_TYPES`).
+enum ReductionType { SUM, MEAN, MUL, DIV, MIN, MAX, VAR, STD, LOGSUMEXP };
 
 const std::map<std::string, ReductionType> reduce2REDUCE = {
     {"sum", SUM}, {"mean", MEAN}, {"mul", MUL},
@@ -37,6 +45,31 @@ const std::map<std::string, ReductionType> reduce2REDUCE = {
       static constexpr ReductionType REDUCE = MAX;                             \
       return __VA_ARGS__();                                                    \
     }                                                                          \
+    default:                                                                   \
+      AT_ERROR("Invalid reduction type");                                      \
+    }                                                                          \
+  }()
+
+const std::map<std::string, ReductionType> stat2REDUCE = {
+    {"var", VAR}, {"std", STD}, {"logsumexp", LOGSUMEXP}};
+
+#define AT_DISPATCH_STAT_TYPES(reduce, ...)                                    \
+  [&] {                                                                        \
+    switch (stat2REDUCE.at(reduce)) {                                          \
+    case VAR: {                                                                \
+      static constexpr ReductionType REDUCE = VAR;                             \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    case STD: {                                                                \
+      static constexpr ReductionType REDUCE = STD;                             \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    case LOGSUMEXP: {                                                          \
+      static constexpr ReductionType REDUCE = LOGSUMEXP;                       \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    default:                                                                   \
+      AT_ERROR("Invalid reduction type");                                      \
     }                                                                          \
   }()
 
@@ -52,7 +85,8 @@ template <typename scalar_t, ReductionType REDUCE> struct Reducer {
       return (scalar_t)0;
   }
 
-  static inline void update(scalar_t *val, scalar_t new_val, int64_t *arg,
+  template <typename arg_t>
+  static inline void update(scalar_t *val, scalar_t new_val, arg_t *arg,
                             int64_t new_arg) {
     if (REDUCE == SUM || REDUCE == MEAN)
       *val = *val + new_val;
@@ -63,22 +97,313 @@ template <typename scalar_t, ReductionType REDUCE> struct Reducer {
     else if ((REDUCE == MIN && new_val < *val) ||
              (REDUCE == MAX && new_val > *val)) {
       *val = new_val;
-      *arg = new_arg;
+      *arg = (arg_t)new_arg;
     }
   }
 
-  static inline void write(scalar_t *address, scalar_t val,
-                           int64_t *arg_address, int64_t arg, int count) {
+  template <typename out_t, typename arg_t>
+  static inline void write(out_t *address, scalar_t val, arg_t *arg_address,
+                           int64_t arg, int count) {
     if (REDUCE == SUM || REDUCE == MUL || REDUCE == DIV)
-      *address = val;
+      *address = (out_t)val;
     else if (REDUCE == MEAN)
-      *address = val / (scalar_t)(count > 0 ? count : 1);
+      *address = (out_t)(val / (scalar_t)(count > 0 ? count : 1));
     else if (REDUCE == MIN || REDUCE == MAX) {
       if (count > 0) {
-        *address = val;
-        *arg_address = arg;
+        *address = (out_t)val;
+        *arg_address = (arg_t)arg;
       } else
-        *address = (scalar_t)0;
+        *address = (out_t)0;
     }
   }
 };
+
+// The type in which values are reduced before being written back, i.e.,
+// reduced precision floating point types get accumulated in `float`.
+template <typename scalar_t> struct AccType { using type = scalar_t; };
+template <> struct AccType<at::Half> {
+  using type = at::acc_type<at::Half, /*is_cuda=*/false>;
+};
+template <> struct AccType<at::BFloat16> {
+  using type = at::acc_type<at::BFloat16, /*is_cuda=*/false>;
+};
+
+// Returns `val` scaled by the weight of its entry `e` along the reduced
+// dimension, or `val` itself in case no weights are given.
+template <typename scalar_t>
+inline scalar_t weigh(scalar_t val, const scalar_t *weight_data, int64_t e) {
+  return weight_data == nullptr ? val : (scalar_t)(val * weight_data[e]);
+}
+
+// Whether `reduce` supports weighting each entry before reduction.
+inline bool supports_weight(const std::string &reduce) {
+  auto REDUCE = reduce2REDUCE.at(reduce);
+  return REDUCE == SUM || REDUCE == MEAN || REDUCE == MIN || REDUCE == MAX;
+}
+
+// Running state of Welford's algorithm, which computes the mean and the sum of
+// squared deviations `m2` of a sequence of values in a single, numerically
+// stable pass. Partial states can be merged via Chan's formula.
+template <typename scalar_t> struct Welford {
+  int64_t count = 0;
+  scalar_t mean = (scalar_t)0, m2 = (scalar_t)0;
+
+  inline void update(scalar_t val) {
+    count++;
+    scalar_t delta = val - mean;
+    mean += delta / (scalar_t)count;
+    m2 += delta * (val - mean);
+  }
+
+  inline void merge(int64_t other_count, scalar_t other_mean,
+                    scalar_t other_m2) {
+    if (other_count == 0)
+      return;
+    auto total = count + other_count;
+    scalar_t delta = other_mean - mean;
+    scalar_t weight = (scalar_t)other_count / (scalar_t)total;
+    mean += delta * weight;
+    m2 += other_m2 + delta * delta * (scalar_t)count * weight;
+    count = total;
+  }
+
+  inline scalar_t var(bool unbiased) const {
+    auto denom = count - (int64_t)unbiased;
+    return denom > 0 ? m2 / (scalar_t)denom : (scalar_t)0;
+  }
+};
+
+// Running state of an online log-sum-exp, which keeps the sum of exponentials
+// relative to the running maximum.
+template <typename scalar_t> struct LogSumExp {
+  scalar_t max = -std::numeric_limits<scalar_t>::infinity();
+  scalar_t sum = (scalar_t)0;
+
+  inline void update(scalar_t val) { merge(val, (scalar_t)1); }
+
+  inline void merge(scalar_t other_max, scalar_t other_sum) {
+    if (other_sum == (scalar_t)0 ||
+        other_max == -std::numeric_limits<scalar_t>::infinity())
+      return;
+    if (other_max > max) {
+      sum = sum * std::exp(max - other_max) + other_sum;
+      max = other_max;
+    } else
+      sum += other_sum * std::exp(other_max - max);
+  }
+
+  inline scalar_t value() const {
+    return sum > (scalar_t)0 ? max + std::log(sum)
+                             : -std::numeric_limits<scalar_t>::infinity();
+  }
+};
+
+// Maximum number of reductions `segment_csr_multi` computes in a single pass.
+#define MAX_MULTI_REDUCES 8
+
+// The reductions of `segment_csr_multi` in output order. This is passed to
+// kernels by value.
+struct MultiReduce {
+  int num = 0;
+  ReductionType reduces[MAX_MULTI_REDUCES];
+
+  inline bool has(ReductionType reduce) const {
+    for (int r = 0; r < num; r++)
+      if (reduces[r] == reduce)
+        return true;
+    return false;
+  }
+};
+
+inline MultiReduce getMultiReduce(const std::vector<std::string> &reduces) {
+  AT_ASSERTM(reduces.size() > 0 && reduces.size() <= MAX_MULTI_REDUCES,
+             "Expected between 1 and ", MAX_MULTI_REDUCES, " reductions");
+  MultiReduce multi;
+  for (const auto &reduce : reduces) {
+    ReductionType REDUCE;
+    if (reduce2REDUCE.count(reduce) > 0)
+      REDUCE = reduce2REDUCE.at(reduce);
+    else if (stat2REDUCE.count(reduce) > 0)
+      REDUCE = stat2REDUCE.at(reduce);
+    else
+      AT_ERROR("Invalid reduction type");
+    AT_ASSERTM(REDUCE != MUL && REDUCE != DIV && REDUCE != LOGSUMEXP,
+               "Reduction type \"", reduce, "\" is not supported");
+    multi.reduces[multi.num++] = REDUCE;
+  }
+  return multi;
+}
+
+// Running state of all reductions supported by `MultiReduce`, such that any
+// subset of them can be computed from a single pass over the values.
+template <typename scalar_t> struct MultiReducer {
+  scalar_t sum = (scalar_t)0;
+  scalar_t min = std::numeric_limits<scalar_t>::max();
+  scalar_t max = std::numeric_limits<scalar_t>::lowest();
+  int64_t arg_min, arg_max;
+  Welford<scalar_t> welford;
+
+  MultiReducer(int64_t arg_init)
+      : arg_min(arg_init), arg_max(arg_init) {}
+
+  inline void update(scalar_t val, int64_t arg) {
+    sum += val;
+    if (val < min) {
+      min = val;
+      arg_min = arg;
+    }
+    if (val > max) {
+      max = val;
+      arg_max = arg;
+    }
+    welford.update(val);
+  }
+
+  // Ties are resolved towards the smaller argument, i.e., the first
+  // occurrence of the minimum or maximum.
+  inline void merge(scalar_t other_sum, scalar_t other_min,
+                              int64_t other_arg_min, scalar_t other_max,
+                              int64_t other_arg_max, int64_t other_count,
+                              scalar_t other_mean, scalar_t other_m2) {
+    sum += other_sum;
+    if (other_min < min || (other_min == min && other_arg_min < arg_min)) {
+      min = other_min;
+      arg_min = other_arg_min;
+    }
+    if (other_max > max || (other_max == max && other_arg_max < arg_max)) {
+      max = other_max;
+      arg_max = other_arg_max;
+    }
+    welford.merge(other_count, other_mean, other_m2);
+  }
+
+  inline scalar_t value(ReductionType reduce, bool unbiased) const {
+    auto count = welford.count;
+    switch (reduce) {
+    case SUM:
+      return sum;
+    case MEAN:
+      return sum / (scalar_t)(count > 0 ? count : 1);
+    case MIN:
+      return count > 0 ? min : (scalar_t)0;
+    case MAX:
+      return count > 0 ? max : (scalar_t)0;
+    case VAR:
+      return welford.var(unbiased);
+    default:
+      return std::sqrt(welford.var(unbiased));
+    }
+  }
+};
+
+// Applies `Reducer` to `K` consecutive entries at once, i.e., updates `vals[k]`
+// with `src[k]` and writes `vals[k]` to `out[k]` for all `k` in `[0, K)`.
+template <typename scalar_t, ReductionType REDUCE, typename Enable = void>
+struct VecReducer {
+  using acc_t = typename AccType<scalar_t>::type;
+
+  static inline void update(acc_t *vals, const scalar_t *src, int64_t *args,
+                            int64_t arg, int64_t K) {
+    for (int64_t k = 0; k < K; k++)
+      Reducer<acc_t, REDUCE>::update(vals + k, src[k], args + k, arg);
+  }
+
+  static inline void update(acc_t *vals, const scalar_t *src, scalar_t weight,
+                            int64_t *args, int64_t arg, int64_t K) {
+    for (int64_t k = 0; k < K; k++)
+      Reducer<acc_t, REDUCE>::update(vals + k, (acc_t)weight * (acc_t)src[k],
+                                     args + k, arg);
+  }
+
+  template <typename arg_t>
+  static inline void write(scalar_t *out, const acc_t *vals, arg_t *arg_out,
+                           const int64_t *args, int count, int64_t K) {
+    for (int64_t k = 0; k < K; k++)
+      Reducer<acc_t, REDUCE>::write(out + k, vals[k], arg_out + k, args[k],
+                                    count);
+  }
+};
+
+// Single and double precision values get reduced via `at::vec::Vectorized`.
+// For MIN and MAX, we compare and select whole vectors and only update the
+// arguments of lanes whose value changed, which quickly becomes rare.
+// Integer and reduced precision types use the scalar fallback above.
+template <typename scalar_t, ReductionType REDUCE>
+struct VecReducer<scalar_t, REDUCE,
+                  typename std::enable_if<
+                      std::is_same<scalar_t, float>::value ||
+                      std::is_same<scalar_t, double>::value>::type> {
+  using acc_t = scalar_t;
+  using Vec = at::vec::Vectorized<scalar_t>;
+
+  static inline void update_vec(acc_t *vals, const Vec &new_val, int64_t *args,
+                                int64_t arg) {
+    auto val = Vec::loadu(vals);
+    if (REDUCE == SUM || REDUCE == MEAN)
+      val = val + new_val;
+    else if (REDUCE == MUL)
+      val = val * new_val;
+    else if (REDUCE == DIV)
+      val = val / new_val;
+    else if (REDUCE == MIN || REDUCE == MAX) {
+      auto mask = REDUCE == MIN ? new_val < val : new_val > val;
+      // Lanes of `mask` are either all zero or all one bits.
+      int changed = ~mask.zero_mask() & ((1 << Vec::size()) - 1);
+      if (changed == 0)
+        return;
+      val = Vec::blendv(val, new_val, mask);
+      for (int i = 0; i < Vec::size(); i++)
+        if (changed & (1 << i))
+          args[i] = arg;
+    }
+    val.store(vals);
+  }
+
+  static inline void update(acc_t *vals, const scalar_t *src, int64_t *args,
+                            int64_t arg, int64_t K) {
+    int64_t k = 0;
+    for (; k + Vec::size() <= K; k += Vec::size())
+      update_vec(vals + k, Vec::loadu(src + k), args + k, arg);
+    for (; k < K; k++)
+      Reducer<acc_t, REDUCE>::update(vals + k, src[k], args + k, arg);
+  }
+
+  static inline void update(acc_t *vals, const scalar_t *src, scalar_t weight,
+                            int64_t *args, int64_t arg, int64_t K) {
+    int64_t k = 0;
+    auto weight_vec = Vec(weight);
+    for (; k + Vec::size() <= K; k += Vec::size())
+      update_vec(vals + k, weight_vec * Vec::loadu(src + k), args + k, arg);
+    for (; k < K; k++)
+      Reducer<acc_t, REDUCE>::update(vals + k, weight * src[k], args + k, arg);
+  }
+
+  template <typename arg_t>
+  static inline void write(scalar_t *out, const acc_t *vals, arg_t *arg_out,
+                           const int64_t *args, int count, int64_t K) {
+    int64_t k = 0;
+    if (REDUCE == MEAN) {
+      auto count_vec = Vec((scalar_t)(count > 0 ? count : 1));
+      for (; k + Vec::size() <= K; k += Vec::size())
+        (Vec::loadu(vals + k) / count_vec).store(out + k);
+    }
+    for (; k < K; k++)
+      Reducer<acc_t, REDUCE>::write(out + k, vals[k], arg_out + k, args[k],
+                                    count);
+  }
+};
+
+// Division which rounds integers towards negative infinity, matching
+// `div_(..., "floor")`.
+template <typename scalar_t,
+          bool IS_INTEGRAL = std::is_integral<scalar_t>::value>
+struct FloorDiv {
+  static inline scalar_t apply(scalar_t a, scalar_t b) { return a / b; }
+};
+
+template <typename scalar_t> struct FloorDiv<scalar_t, true> {
+  static inline scalar_t apply(scalar_t a, scalar_t b) {
+    scalar_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? (scalar_t)(q - 1) : q;
+  }
+};
@@ -1,5 +1,6 @@
 #include "scatter_cpu.h"
 
+#include "../workspace.h"
 #include "index_info.h"
 #include "reducer.h"
 #include "utils.h"
@@ -7,11 +8,14 @@
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 scatter_cpu(torch::Tensor src, torch::Tensor index, int64_t dim,
             torch::optional<torch::Tensor> optional_out,
-            torch::optional<int64_t> dim_size, std::string reduce) {
+            torch::optional<int64_t> dim_size, std::string reduce,
+            torch::optional<torch::Tensor> optional_weight) {
   CHECK_CPU(src);
   CHECK_CPU(index);
   if (optional_out.has_value())
     CHECK_CPU(optional_out.value());
+  if (optional_weight.has_value())
+    CHECK_CPU(optional_weight.value());
 
   CHECK_INPUT(src.dim() == index.dim());
   for (auto i = 0; i < index.dim() - 1; i++)
@@ -19,6 +23,15 @@ scatter_cpu(torch::Tensor src, torch::Tensor index, int64_t dim,
 
   src = src.contiguous();
 
+  torch::Tensor weight;
+  if (optional_weight.has_value()) {
+    AT_ASSERTM(supports_weight(reduce), "Reduction type \"", reduce,
+               "\" does not support weights");
+    weight = optional_weight.value().contiguous();
+    CHECK_INPUT(weight.dim() == 1 && weight.numel() == src.size(dim));
+    CHECK_INPUT(weight.scalar_type() == src.scalar_type());
+  }
+
   torch::Tensor out;
   if (optional_out.has_value()) {
     out = optional_out.value().contiguous();
@@ -32,56 +45,372 @@ scatter_cpu(torch::Tensor src, torch::Tensor index, int64_t dim,
     else if (index.numel() == 0)
       sizes[dim] = 0;
     else
-      sizes[dim] = 1 + *index.max().data_ptr<int64_t>();
+      sizes[dim] = 1 + index.max().item<int64_t>();
     out = torch::empty(sizes, src.options());
   }
 
+  int64_t B = 1;
+  for (auto i = 0; i < dim; i++)
+    B *= src.size(i);
+  auto E = src.size(dim);
+  auto K = src.numel() / std::max<int64_t>(B * E, 1);
+  auto N = out.size(dim);
+
+  // For MEAN, `arg_out` holds the number of entries scattered to each output.
+  // In case `index` is broadcasted along all trailing dimensions, a single
+  // count per (b, idx) suffices (`CK == 1`) instead of one count per
+  // (b, idx, k) (`CK == K`).
+  int64_t CK = K;
   torch::optional<torch::Tensor> arg_out = torch::nullopt;
-  int64_t *arg_out_data = nullptr;
-  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX) {
+  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
     arg_out = torch::full_like(out, src.size(dim), index.options());
-    arg_out_data = arg_out.value().data_ptr<int64_t>();
+  else if (reduce2REDUCE.at(reduce) == MEAN) {
+    auto sizes = out.sizes().vec();
+    if (index_is_broadcasted(index, dim)) {
+      CK = 1;
+      for (auto i = dim + 1; i < out.dim(); i++)
+        sizes[i] = 1;
+    }
+    arg_out = torch::zeros(sizes, src.options());
   }
 
   if (src.numel() == 0) {
     if (!optional_out.has_value())
       out.fill_(0);
+    if (reduce2REDUCE.at(reduce) == MEAN)
+      arg_out.value().fill_(1);
     return std::make_tuple(out, arg_out);
   }
 
-  auto B = 1;
+  auto use_64bit = use_64bit_offsets({src, index, out});
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *weight_data = nullptr;
+    if (optional_weight.has_value())
+      weight_data = weight.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        index_t *arg_out_data = nullptr;
+        scalar_t *count_data = nullptr;
+        if (REDUCE == MIN || REDUCE == MAX)
+          arg_out_data = arg_out.value().data_ptr<index_t>();
+        if (REDUCE == MEAN)
+          count_data = arg_out.value().data_ptr<scalar_t>();
+
+        if (!optional_out.has_value())
+          out.fill_(Reducer<scalar_t, REDUCE>::init());
+
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto index_info = getTensorInfo<index_t, offset_t>(index);
+
+          // In case `index` matches the shape of `src` (which is guaranteed via
+          // `broadcast()`), the offset of `index[b, e, k]` decomposes into
+          // `outer[b] + e * stride + inner[k]`. If `index` is furthermore
+          // expanded along all trailing dimensions, `inner` is all zero and
+          // we only need to read a single index per (b, e).
+          auto separable = index.sizes() == src.sizes();
+          std::vector<offset_t> outer, inner;
+          offset_t stride = 0;
+          if (separable) {
+            outer = getOffsets(index_info, 0, dim);
+            inner = getOffsets(index_info, dim + 1, index_info.dims);
+            stride = index_info.strides[dim];
+          }
+          auto broadcasted = separable && index_is_broadcasted(index, dim);
+
+          auto get_idx = [&](int64_t b, int64_t e, int64_t k) -> int64_t {
+            if (separable)
+              return index_info.data[outer[b] + e * stride + inner[k]];
+            return index_info.data[IndexToOffset<index_t, offset_t>::get(
+                b * E * K + e * K + k, index_info)];
+          };
+
+          if (B * K >= at::get_num_threads()) {
+            // Each (b, k) pair writes to a disjoint slice of `out`, so we can
+            // partition over them without any synchronization. Entries along
+            // `dim` are still reduced in order, which keeps results
+            // deterministic.
+            at::parallel_for(
+                0, B * K, grain_size(B * K, src.numel()),
+                [&](int64_t begin, int64_t end) {
+                  int64_t i, idx;
+                  for (auto b = begin / K; b <= (end - 1) / K; b++) {
+                    auto k_start = b == begin / K ? begin % K : 0;
+                    auto k_end = b == (end - 1) / K ? (end - 1) % K + 1 : K;
+                    for (int64_t e = 0; e < E; e++) {
+                      if (broadcasted)
+                        idx = get_idx(b, e, 0);
+                      for (auto k = k_start; k < k_end; k++) {
+                        i = b * E * K + e * K + k;
+                        if (!broadcasted)
+                          idx = get_idx(b, e, k);
+                        Reducer<scalar_t, REDUCE>::update(
+                            out_data + b * N * K + idx * K + k,
+                            weigh(src_data[i], weight_data, e),
+                            arg_out_data + b * N * K + idx * K + k, e);
+                        if (REDUCE == MEAN && (CK > 1 || k == 0))
+                          count_data[(b * N + idx) * CK + k % CK] +=
+                              (scalar_t)1;
+                      }
+                    }
+                  }
+                });
+          } else if (N > 0) {
+            // Not enough independent (b, k) pairs to keep all threads busy.
+            // We instead let each of `T` threads own a contiguous range of
+            // output indices. Entries (or rows of entries in case `index` is
+            // broadcasted) are first bucketed by their owner via a stable
+            // counting sort, such that each entry is visited by one thread
+            // only, and entries are still reduced in order.
+            auto U = broadcasted ? B * E : B * E * K;
+            auto T = std::max<int64_t>(
+                std::min<int64_t>(at::get_num_threads(), std::min(N, U)), 1);
+            auto owner = [&](int64_t idx) { return idx * T / N; };
+            auto unit_idx = [&](int64_t u) -> int64_t {
+              if (broadcasted)
+                return get_idx(u / E, u % E, 0);
+              return get_idx(u / (E * K), (u / K) % E, u % K);
+            };
+
+            // `offset[p * T + c]` holds the number of entries in the `p`-th
+            // chunk of units that are owned by thread `c`:
+            std::vector<int64_t> offset(T * T, 0), bucket(T + 1, 0);
+            at::parallel_for(0, T, 1, [&](int64_t begin, int64_t end) {
+              for (auto p = begin; p < end; p++)
+                for (auto u = p * U / T; u < (p + 1) * U / T; u++)
+                  offset[p * T + owner(unit_idx(u))]++;
+            });
+            int64_t total = 0;
+            for (int64_t c = 0; c < T; c++) {
+              for (int64_t p = 0; p < T; p++) {
+                auto count = offset[p * T + c];
+                offset[p * T + c] = total;
+                total += count;
+              }
+              bucket[c + 1] = total;
+            }
+            std::vector<int64_t> perm(U);
+            at::parallel_for(0, T, 1, [&](int64_t begin, int64_t end) {
+              for (auto p = begin; p < end; p++)
+                for (auto u = p * U / T; u < (p + 1) * U / T; u++)
+                  perm[offset[p * T + owner(unit_idx(u))]++] = u;
+            });
+
+            auto apply = [&](int64_t b, int64_t e, int64_t k, int64_t idx) {
+              Reducer<scalar_t, REDUCE>::update(
+                  out_data + b * N * K + idx * K + k,
+                  weigh(src_data[b * E * K + e * K + k], weight_data, e),
+                  arg_out_data + b * N * K + idx * K + k, e);
+              if (REDUCE == MEAN && (CK > 1 || k == 0))
+                count_data[(b * N + idx) * CK + k % CK] += (scalar_t)1;
+            };
+            at::parallel_for(0, T, 1, [&](int64_t begin, int64_t end) {
+              for (auto c = begin; c < end; c++) {
+                for (auto j = bucket[c]; j < bucket[c + 1]; j++) {
+                  auto u = perm[j];
+                  auto idx = unit_idx(u);
+                  if (broadcasted) {
+                    for (int64_t k = 0; k < K; k++)
+                      apply(u / E, u % E, k, idx);
+                  } else {
+                    apply(u / (E * K), (u / K) % E, u % K, idx);
+                  }
+                }
+              }
+            });
+          }
+        });
+
+        if (!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX))
+          out.masked_fill_(out == Reducer<scalar_t, REDUCE>::init(),
+                           (scalar_t)0);
+
+        if (REDUCE == MEAN) {
+          // Divides by the clamped counts, which are kept for backward.
+          at::parallel_for(
+              0, B * N, grain_size(B * N, out.numel()),
+              [&](int64_t begin, int64_t end) {
+                scalar_t count;
+                for (auto i = begin; i < end; i++) {
+                  for (int64_t k = 0; k < K; k++) {
+                    count = count_data[i * CK + k % CK];
+                    count = count < (scalar_t)1 ? (scalar_t)1 : count;
+                    out_data[i * K + k] =
+                        FloorDiv<scalar_t>::apply(out_data[i * K + k], count);
+                    count_data[i * CK + k % CK] = count;
+                  }
+                }
+              });
+        }
+      });
+    });
+  });
+
+  return std::make_tuple(out, arg_out);
+}
+
+torch::Tensor scatter_softmax_cpu(torch::Tensor src, torch::Tensor index,
+                                  int64_t dim, int64_t dim_size, bool log) {
+  CHECK_CPU(src);
+  CHECK_CPU(index);
+  WorkspaceScope workspace_scope(SCATTER_WORKSPACE);
+
+  CHECK_INPUT(src.sizes() == index.sizes());
+
+  src = src.contiguous();
+  auto out = torch::empty_like(src);
+  if (src.numel() == 0)
+    return out;
+
+  int64_t B = 1;
   for (auto i = 0; i < dim; i++)
     B *= src.size(i);
   auto E = src.size(dim);
   auto K = src.numel() / (B * E);
-  auto N = out.size(dim);
+  auto N = dim_size;
 
-  auto index_info = getTensorInfo<int64_t>(index);
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
+    using acc_t = typename AccType<scalar_t>::type;
 
-    int64_t i, idx;
-    AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
-      if (!optional_out.has_value())
-        out.fill_(Reducer<scalar_t, REDUCE>::init());
-
-      for (auto b = 0; b < B; b++) {
-        for (auto e = 0; e < E; e++) {
-          for (auto k = 0; k < K; k++) {
-            i = b * E * K + e * K + k;
-            idx = index_info.data[IndexToOffset<int64_t>::get(i, index_info)];
-            Reducer<scalar_t, REDUCE>::update(
-                out_data + b * N * K + idx * K + k, src_data[i],
-                arg_out_data + b * N * K + idx * K + k, e);
-          }
-        }
-      }
+    // Holds the maximum (or the log-normalizer for log-softmax) and the sum of
+    // exponentials of each output.
+    auto acc_options =
+        src.options().dtype(c10::CppTypeToScalarType<acc_t>::value);
+    auto max = workspace_empty({B, N, K}, acc_options)
+                   .fill_(-std::numeric_limits<double>::infinity());
+    auto sum = workspace_empty({B, N, K}, acc_options).zero_();
+    auto max_data = max.data_ptr<acc_t>();
+    auto sum_data = sum.data_ptr<acc_t>();
 
-      if (!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX))
-        out.masked_fill_(out == Reducer<scalar_t, REDUCE>::init(), (scalar_t)0);
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      auto index_info = getTensorInfo<index_t, int64_t>(index);
+      auto outer = getOffsets(index_info, 0, dim);
+      auto inner = getOffsets(index_info, dim + 1, index_info.dims);
+      auto stride = index_info.strides[dim];
+
+      // Applies `fn(i, j)` to all entries `i` of `src` and their outputs `j`.
+      // Each (b, k) pair owns a disjoint slice of all outputs, so that we can
+      // partition over them without any synchronization.
+      auto for_each = [&](auto fn) {
+        at::parallel_for(
+            0, B * K, grain_size(B * K, src.numel()),
+            [&](int64_t begin, int64_t end) {
+              int64_t idx;
+              for (auto b = begin / K; b <= (end - 1) / K; b++) {
+                auto k_start = b == begin / K ? begin % K : 0;
+                auto k_end = b == (end - 1) / K ? (end - 1) % K + 1 : K;
+                for (int64_t e = 0; e < E; e++) {
+                  for (auto k = k_start; k < k_end; k++) {
+                    idx = index_info.data[outer[b] + e * stride + inner[k]];
+                    fn(b * E * K + e * K + k, (b * N + idx) * K + k);
+                  }
+                }
+              }
+            });
+      };
+
+      for_each([&](int64_t i, int64_t j) {
+        max_data[j] = std::max(max_data[j], (acc_t)src_data[i]);
+      });
+      for_each([&](int64_t i, int64_t j) {
+        sum_data[j] += std::exp((acc_t)src_data[i] - max_data[j]);
+      });
+      if (log)
+        max.add_(sum.log());
+      for_each([&](int64_t i, int64_t j) {
+        acc_t val = (acc_t)src_data[i] - max_data[j];
+        out_data[i] = (scalar_t)(log ? val : std::exp(val) / sum_data[j]);
+      });
     });
   });
 
-  return std::make_tuple(out, arg_out);
+  return out;
+}
+
+torch::Tensor scatter_softmax_backward_cpu(torch::Tensor out,
+                                           torch::Tensor grad_out,
+                                           torch::Tensor index, int64_t dim,
+                                           int64_t dim_size, bool log) {
+  CHECK_CPU(out);
+  CHECK_CPU(grad_out);
+  CHECK_CPU(index);
+  WorkspaceScope workspace_scope(SCATTER_WORKSPACE);
+
+  CHECK_INPUT(out.sizes() == index.sizes());
+  CHECK_INPUT(out.sizes() == grad_out.sizes());
+
+  out = out.contiguous();
+  grad_out = grad_out.contiguous();
+  auto grad_in = torch::empty_like(out);
+  if (out.numel() == 0)
+    return grad_in;
+
+  int64_t B = 1;
+  for (auto i = 0; i < dim; i++)
+    B *= out.size(i);
+  auto E = out.size(dim);
+  auto K = out.numel() / (B * E);
+  auto N = dim_size;
+
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(out.scalar_type(), "_", [&] {
+    auto out_data = out.data_ptr<scalar_t>();
+    auto grad_out_data = grad_out.data_ptr<scalar_t>();
+    auto grad_in_data = grad_in.data_ptr<scalar_t>();
+    using acc_t = typename AccType<scalar_t>::type;
+
+    auto acc_options =
+        out.options().dtype(c10::CppTypeToScalarType<acc_t>::value);
+    auto dot = workspace_empty({B, N, K}, acc_options).zero_();
+    auto dot_data = dot.data_ptr<acc_t>();
+
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      auto index_info = getTensorInfo<index_t, int64_t>(index);
+      auto outer = getOffsets(index_info, 0, dim);
+      auto inner = getOffsets(index_info, dim + 1, index_info.dims);
+      auto stride = index_info.strides[dim];
+
+      // Same partitioning as in `scatter_softmax_cpu`.
+      auto for_each = [&](auto fn) {
+        at::parallel_for(
+            0, B * K, grain_size(B * K, out.numel()),
+            [&](int64_t begin, int64_t end) {
+              int64_t idx;
+              for (auto b = begin / K; b <= (end - 1) / K; b++) {
+                auto k_start = b == begin / K ? begin % K : 0;
+                auto k_end = b == (end - 1) / K ? (end - 1) % K + 1 : K;
+                for (int64_t e = 0; e < E; e++) {
+                  for (auto k = k_start; k < k_end; k++) {
+                    idx = index_info.data[outer[b] + e * stride + inner[k]];
+                    fn(b * E * K + e * K + k, (b * N + idx) * K + k);
+                  }
+                }
+              }
+            });
+      };
+
+      // The gradient of softmax `y` is given by `y * (grad - sum(grad * y))`,
+      // and the one of log-softmax `y` by `grad - exp(y) * sum(grad)`.
+      for_each([&](int64_t i, int64_t j) {
+        acc_t grad = (acc_t)grad_out_data[i];
+        dot_data[j] += log ? grad : grad * (acc_t)out_data[i];
+      });
+      for_each([&](int64_t i, int64_t j) {
+        acc_t y = (acc_t)out_data[i], grad = (acc_t)grad_out_data[i];
+        grad_in_data[i] = (scalar_t)(log ? grad - std::exp(y) * dot_data[j]
+                                         : y * (grad - dot_data[j]));
+      });
+    });
+  });
+
+  return grad_in;
+}
+
+torch::Tensor scatter_arg_backward_cpu(torch::Tensor grad_out,
+                                       torch::Tensor arg_out, int64_t dim,
+                                       std::vector<int64_t> src_sizes) {
+  return arg_backward_cpu(grad_out, arg_out, dim, src_sizes);
 }
@@ -4,6 +4,18 @@
 #include "reducer.h"
 #include "utils.h"
 
+int64_t segment_coo_dim_size_cpu(torch::Tensor index) {
+  CHECK_CPU(index);
+  if (index.numel() == 0)
+    return 0;
+
+  // Since `index` is sorted, its maximum is found in its last column.
+  auto dim = index.dim() - 1;
+  auto tmp = index.select(dim, index.size(dim) - 1);
+  tmp = tmp.numel() > 1 ? tmp.max() : tmp;
+  return 1 + tmp.item<int64_t>();
+}
+
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_coo_cpu(torch::Tensor src, torch::Tensor index,
                 torch::optional<torch::Tensor> optional_out,
@@ -34,21 +46,14 @@ segment_coo_cpu(torch::Tensor src, torch::Tensor index,
     sizes = src.sizes().vec();
     if (dim_size.has_value())
       sizes[dim] = dim_size.value();
-    else if (index.numel() == 0)
-      sizes[dim] = 0;
-    else {
-      auto tmp = index.select(dim, index.size(dim) - 1);
-      tmp = tmp.numel() > 1 ? tmp.max() : tmp;
-      sizes[dim] = 1 + *tmp.data_ptr<int64_t>();
-    }
+    else
+      sizes[dim] = segment_coo_dim_size_cpu(index);
     out = torch::empty(sizes, src.options());
   }
 
   torch::optional<torch::Tensor> arg_out = torch::nullopt;
-  int64_t *arg_out_data = nullptr;
   if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX) {
     arg_out = torch::full_like(out, src.size(dim), index.options());
-    arg_out_data = arg_out.value().data_ptr<int64_t>();
   } else if (reduce2REDUCE.at(reduce) == MEAN) {
     auto sizes = index.sizes().vec();
     sizes[dim] = out.size(dim);
@@ -66,72 +71,113 @@ segment_coo_cpu(torch::Tensor src, torch::Tensor index,
   auto K = src.numel() / index.numel();
   auto N = out.size(dim);
 
-  auto index_info = getTensorInfo<int64_t>(index);
-  auto stride = index_info.strides[index_info.dims - 1];
-  std::vector<int64_t> args(K);
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
     scalar_t *count_data = nullptr;
 
-    std::vector<scalar_t> vals(K);
-    int64_t idx, next_idx, row_start;
-    AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
-      if (!optional_out.has_value())
-        out.fill_(Reducer<scalar_t, REDUCE>::init());
-      if (REDUCE == MEAN)
-        count_data = arg_out.value().data_ptr<scalar_t>();
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      auto index_info = getTensorInfo<index_t, int64_t>(index);
+      auto stride = index_info.strides[index_info.dims - 1];
+      index_t *arg_out_data = nullptr;
 
-      for (auto b = 0; b < B; b++) {
-        auto offset = IndexToOffset<int64_t>::get(b * E, index_info);
-        idx = index_info.data[offset];
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        if (!optional_out.has_value())
+          out.fill_(Reducer<scalar_t, REDUCE>::init());
+        if (REDUCE == MIN || REDUCE == MAX)
+          arg_out_data = arg_out.value().data_ptr<index_t>();
+        if (REDUCE == MEAN)
+          count_data = arg_out.value().data_ptr<scalar_t>();
 
-        for (auto k = 0; k < K; k++)
-          vals[k] = out_data[b * N * K + k];
+        using acc_t = typename AccType<scalar_t>::type;
+
+        // Reduces all segments in `[e_start, e_end)` of batch `b`. The range
+        // needs to be aligned to segment boundaries.
+        auto reduce_range = [&](int64_t b, int64_t e_start, int64_t e_end) {
+          if (e_start >= e_end)
+            return;
 
-        row_start = 0;
-        for (auto e = 0; e < E; e++) {
+          std::vector<acc_t> vals(K);
+          std::vector<int64_t> args(K);
+          int64_t idx, next_idx, row_start;
+
+          auto offset =
+              IndexToOffset<index_t, int64_t>::get(b * E, index_info);
+          idx = index_info.data[offset + e_start * stride];
 
           for (auto k = 0; k < K; k++)
-            Reducer<scalar_t, REDUCE>::update(
-                &vals[k], src_data[b * E * K + e * K + k], &args[k], e);
-
-          if (e == E - 1) {
-            for (auto k = 0; k < K; k++)
-              Reducer<scalar_t, REDUCE>::write(
-                  out_data + b * N * K + idx * K + k, vals[k],
-                  arg_out_data + b * N * K + idx * K + k, args[k],
-                  e + 1 - row_start);
-            if (REDUCE == MEAN)
-              count_data[b * N + idx] = (scalar_t)(e + 1 - row_start);
-          } else {
-            next_idx = index_info.data[offset + (e + 1) * stride];
-            assert(idx <= next_idx);
+            vals[k] = out_data[b * N * K + idx * K + k];
 
-            if (idx != next_idx) {
-              for (auto k = 0; k < K; k++) {
-                Reducer<scalar_t, REDUCE>::write(
-                    out_data + b * N * K + idx * K + k, vals[k],
-                    arg_out_data + b * N * K + idx * K + k, args[k],
-                    e + 1 - row_start);
+          row_start = e_start;
+          for (auto e = e_start; e < e_end; e++) {
 
-                vals[k] = out_data[b * N * K + next_idx * K + k];
-              }
+            VecReducer<scalar_t, REDUCE>::update(
+                vals.data(), src_data + b * E * K + e * K, args.data(), e, K);
+
+            if (e == e_end - 1) {
+              VecReducer<scalar_t, REDUCE>::write(
+                  out_data + b * N * K + idx * K, vals.data(),
+                  arg_out_data + b * N * K + idx * K, args.data(),
+                  e + 1 - row_start, K);
               if (REDUCE == MEAN)
                 count_data[b * N + idx] = (scalar_t)(e + 1 - row_start);
-              row_start = e + 1;
-            }
+            } else {
+              next_idx = index_info.data[offset + (e + 1) * stride];
+              assert(idx <= next_idx);
+
+              if (idx != next_idx) {
+                VecReducer<scalar_t, REDUCE>::write(
+                    out_data + b * N * K + idx * K, vals.data(),
+                    arg_out_data + b * N * K + idx * K, args.data(),
+                    e + 1 - row_start, K);
+                for (auto k = 0; k < K; k++)
+                  vals[k] = out_data[b * N * K + next_idx * K + k];
+                if (REDUCE == MEAN)
+                  count_data[b * N + idx] = (scalar_t)(e + 1 - row_start);
+                row_start = e + 1;
+              }
 
-            idx = next_idx;
+              idx = next_idx;
+            }
+          }
+        };
+
+        if (B >= at::get_num_threads()) {
+          at::parallel_for(0, B, grain_size(B, src.numel()),
+                           [&](int64_t begin, int64_t end) {
+                             for (auto b = begin; b < end; b++)
+                               reduce_range(b, 0, E);
+                           });
+        } else {
+          // Since `index` is sorted, every segment maps to a contiguous range
+          // of entries. We split each batch into equally-sized chunks and move
+          // chunk boundaries forward until they hit a segment boundary, so that
+          // every segment is reduced by exactly one thread.
+          for (int64_t b = 0; b < B; b++) {
+            auto offset =
+                IndexToOffset<index_t, int64_t>::get(b * E, index_info);
+            auto align = [&](int64_t e) {
+              while (e > 0 && e < E &&
+                     index_info.data[offset + e * stride] ==
+                         index_info.data[offset + (e - 1) * stride])
+                e++;
+              return e;
+            };
+            at::parallel_for(0, E, grain_size(E, src.numel() / B),
+                             [&](int64_t begin, int64_t end) {
+                               reduce_range(b, align(begin), align(end));
+                             });
           }
         }
-      }
-      if (!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX))
-        out.masked_fill_(out == Reducer<scalar_t, REDUCE>::init(), (scalar_t)0);
 
-      if (REDUCE == MEAN)
-        arg_out.value().masked_fill_(arg_out.value() < (scalar_t)1,
-                                     (scalar_t)1);
+        if (!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX))
+          out.masked_fill_(out == Reducer<scalar_t, REDUCE>::init(),
+                           (scalar_t)0);
+
+        if (REDUCE == MEAN)
+          arg_out.value().masked_fill_(arg_out.value() < (scalar_t)1,
+                                       (scalar_t)1);
+      });
     });
   });
 
@@ -176,38 +222,68 @@ torch::Tensor gather_coo_cpu(torch::Tensor src, torch::Tensor index,
   auto K = out.numel() / index.numel();
   auto N = src.size(dim);
 
-  auto index_info = getTensorInfo<int64_t>(index);
-  auto stride = index_info.strides[index_info.dims - 1];
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
 
-    std::vector<scalar_t> vals(K);
-    int64_t idx, next_idx;
-    for (auto b = 0; b < B; b++) {
-      auto offset = IndexToOffset<int64_t>::get(b * E, index_info);
-      idx = index_info.data[offset];
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      auto index_info = getTensorInfo<index_t, int64_t>(index);
+      auto stride = index_info.strides[index_info.dims - 1];
 
-      for (auto k = 0; k < K; k++)
-        vals[k] = src_data[b * N * K + idx * K + k];
+      // Output entries are independent of each other, so we can split every
+      // batch into chunks and only need to re-read `src` at chunk boundaries.
+      auto gather_range = [&](int64_t b, int64_t e_start, int64_t e_end) {
+        if (e_start >= e_end)
+          return;
+
+        std::vector<scalar_t> vals(K);
+        int64_t idx, next_idx;
+
+        auto offset =
+            IndexToOffset<index_t, int64_t>::get(b * E, index_info);
+        idx = index_info.data[offset + e_start * stride];
 
-      for (auto e = 0; e < E; e++) {
         for (auto k = 0; k < K; k++)
-          out_data[b * E * K + e * K + k] = vals[k];
+          vals[k] = src_data[b * N * K + idx * K + k];
 
-        if (e < E - 1) {
-          next_idx = index_info.data[offset + (e + 1) * stride];
-          CHECK_INPUT(idx <= next_idx);
+        for (auto e = e_start; e < e_end; e++) {
+          for (auto k = 0; k < K; k++)
+            out_data[b * E * K + e * K + k] = vals[k];
 
-          if (idx != next_idx) {
-            idx = next_idx;
-            for (auto k = 0; k < K; k++)
-              vals[k] = src_data[b * N * K + idx * K + k];
+          if (e < E - 1) {
+            next_idx = index_info.data[offset + (e + 1) * stride];
+            CHECK_INPUT(idx <= next_idx);
+
+            if (idx != next_idx && e < e_end - 1) {
+              idx = next_idx;
+              for (auto k = 0; k < K; k++)
+                vals[k] = src_data[b * N * K + idx * K + k];
+            }
           }
         }
+      };
+
+      if (B >= at::get_num_threads()) {
+        at::parallel_for(0, B, grain_size(B, out.numel()),
+                         [&](int64_t begin, int64_t end) {
+                           for (auto b = begin; b < end; b++)
+                             gather_range(b, 0, E);
+                         });
+      } else {
+        for (int64_t b = 0; b < B; b++)
+          at::parallel_for(0, E, grain_size(E, out.numel() / B),
+                           [&](int64_t begin, int64_t end) {
+                             gather_range(b, begin, end);
+                           });
       }
-    }
+    });
   });
 
   return out;
 }
+
+torch::Tensor segment_coo_arg_backward_cpu(torch::Tensor grad_out,
+                                           torch::Tensor arg_out, int64_t dim,
+                                           std::vector<int64_t> src_sizes) {
+  return arg_backward_cpu(grad_out, arg_out, dim, src_sizes);
+}
@@ -2,6 +2,8 @@
 
 #include <torch/extension.h>
 
+int64_t segment_coo_dim_size_cpu(torch::Tensor index);
+
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_coo_cpu(torch::Tensor src, torch::Tensor index,
                 torch::optional<torch::Tensor> optional_out,
@@ -9,3 +11,7 @@ segment_coo_cpu(torch::Tensor src, torch::Tensor index,
 
 torch::Tensor gather_coo_cpu(torch::Tensor src, torch::Tensor index,
                              torch::optional<torch::Tensor> optional_out);
+
+torch::Tensor segment_coo_arg_backward_cpu(torch::Tensor grad_out,
+                                           torch::Tensor arg_out, int64_t dim,
+                                           std::vector<int64_t> src_sizes);
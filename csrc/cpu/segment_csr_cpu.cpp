@@ -6,12 +6,14 @@
 
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_csr_cpu(torch::Tensor src, torch::Tensor indptr,
-                torch::optional<torch::Tensor> optional_out,
-                std::string reduce) {
+                torch::optional<torch::Tensor> optional_out, std::string reduce,
+                torch::optional<torch::Tensor> optional_weight) {
   CHECK_CPU(src);
   CHECK_CPU(indptr);
   if (optional_out.has_value())
     CHECK_CPU(optional_out.value());
+  if (optional_weight.has_value())
+    CHECK_CPU(optional_weight.value());
 
   CHECK_INPUT(src.dim() >= indptr.dim());
 
@@ -24,6 +26,15 @@ segment_csr_cpu(torch::Tensor src, torch::Tensor indptr,
 
   src = src.contiguous();
 
+  torch::Tensor weight;
+  if (optional_weight.has_value()) {
+    AT_ASSERTM(supports_weight(reduce), "Reduction type \"", reduce,
+               "\" does not support weights");
+    weight = optional_weight.value().contiguous();
+    CHECK_INPUT(weight.dim() == 1 && weight.numel() == src.size(dim));
+    CHECK_INPUT(weight.scalar_type() == src.scalar_type());
+  }
+
   torch::Tensor out;
   if (optional_out.has_value()) {
     out = optional_out.value().contiguous();
@@ -38,11 +49,8 @@ segment_csr_cpu(torch::Tensor src, torch::Tensor indptr,
   }
 
   torch::optional<torch::Tensor> arg_out = torch::nullopt;
-  int64_t *arg_out_data = nullptr;
-  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX) {
+  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
     arg_out = torch::full(out.sizes(), src.size(dim), indptr.options());
-    arg_out_data = arg_out.value().data_ptr<int64_t>();
-  }
 
   if (src.numel() == 0) {
     if (!optional_out.has_value())
@@ -54,35 +62,57 @@ segment_csr_cpu(torch::Tensor src, torch::Tensor indptr,
   auto K = out.numel() / N;
   auto E = src.size(dim);
 
-  auto indptr_info = getTensorInfo<int64_t>(indptr);
-  auto stride = indptr_info.strides[indptr_info.dims - 1];
-  std::vector<int64_t> args(K);
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *weight_data = nullptr;
+    if (optional_weight.has_value())
+      weight_data = weight.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_info = getTensorInfo<index_t, int64_t>(indptr);
+      auto stride = indptr_info.strides[indptr_info.dims - 1];
+      index_t *arg_out_data = nullptr;
+      if (arg_out.has_value())
+        arg_out_data = arg_out.value().data_ptr<index_t>();
+
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        using acc_t = typename AccType<scalar_t>::type;
+
+        // Rows are independent of each other, so we simply partition them
+        // across threads.
+        at::parallel_for(
+            0, N, grain_size(N, src.numel()), [&](int64_t begin, int64_t end) {
+              std::vector<acc_t> vals(K);
+              std::vector<int64_t> args(K);
+              int64_t row_start, row_end;
+              for (auto n = begin; n < end; n++) {
+                auto offset =
+                    IndexPtrToOffset<index_t, int64_t>::get(n, indptr_info);
+                row_start = indptr_info.data[offset];
+                row_end = indptr_info.data[offset + stride];
+
+                offset = (n / (indptr.size(-1) - 1)) * E * K;
+                for (auto k = 0; k < K; k++)
+                  vals[k] = Reducer<acc_t, REDUCE>::init();
 
-    std::vector<scalar_t> vals(K);
-    int64_t row_start, row_end;
-    AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
-      for (auto n = 0; n < N; n++) {
-        auto offset = IndexPtrToOffset<int64_t>::get(n, indptr_info);
-        row_start = indptr_info.data[offset];
-        row_end = indptr_info.data[offset + stride];
-
-        offset = (n / (indptr.size(-1) - 1)) * E * K;
-        for (auto k = 0; k < K; k++)
-          vals[k] = Reducer<scalar_t, REDUCE>::init();
-
-        for (auto e = row_start; e < row_end; e++)
-          for (auto k = 0; k < K; k++)
-            Reducer<scalar_t, REDUCE>::update(
-                &vals[k], src_data[offset + e * K + k], &args[k], e);
-
-        for (auto k = 0; k < K; k++)
-          Reducer<scalar_t, REDUCE>::write(out_data + n * K + k, vals[k],
-                                           arg_out_data + n * K + k, args[k],
-                                           row_end - row_start);
-      }
+                for (auto e = row_start; e < row_end; e++) {
+                  if (weight_data != nullptr)
+                    VecReducer<scalar_t, REDUCE>::update(
+                        vals.data(), src_data + offset + e * K, weight_data[e],
+                        args.data(), e, K);
+                  else
+                    VecReducer<scalar_t, REDUCE>::update(
+                        vals.data(), src_data + offset + e * K, args.data(), e,
+                        K);
+                }
+
+                VecReducer<scalar_t, REDUCE>::write(
+                    out_data + n * K, vals.data(), arg_out_data + n * K,
+                    args.data(), row_end - row_start, K);
+              }
+            });
+      });
     });
   });
 
@@ -117,7 +147,7 @@ torch::Tensor gather_csr_cpu(torch::Tensor src, torch::Tensor indptr,
   } else {
     auto sizes = src.sizes().vec();
     if (src.numel() > 0)
-      sizes[dim] = *indptr.flatten()[-1].data_ptr<int64_t>();
+      sizes[dim] = indptr.flatten()[-1].item<int64_t>();
     else
       sizes[dim] = 0;
     out = torch::empty(sizes, src.options());
@@ -133,28 +163,605 @@ torch::Tensor gather_csr_cpu(torch::Tensor src, torch::Tensor indptr,
   auto K = src.numel() / N;
   auto E = out.size(dim);
 
-  auto indptr_info = getTensorInfo<int64_t>(indptr);
-  auto stride = indptr_info.strides[indptr_info.dims - 1];
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
 
-    std::vector<scalar_t> vals(K);
-    int64_t row_start, row_end;
-    for (auto n = 0; n < N; n++) {
-      auto offset = IndexPtrToOffset<int64_t>::get(n, indptr_info);
-      row_start = indptr_info.data[offset];
-      row_end = indptr_info.data[offset + stride];
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_info = getTensorInfo<index_t, int64_t>(indptr);
+      auto stride = indptr_info.strides[indptr_info.dims - 1];
+      at::parallel_for(
+          0, N, grain_size(N, out.numel()), [&](int64_t begin, int64_t end) {
+            std::vector<scalar_t> vals(K);
+            int64_t row_start, row_end;
+            for (auto n = begin; n < end; n++) {
+              auto offset =
+                  IndexPtrToOffset<index_t, int64_t>::get(n, indptr_info);
+              row_start = indptr_info.data[offset];
+              row_end = indptr_info.data[offset + stride];
+
+              for (auto k = 0; k < K; k++)
+                vals[k] = src_data[n * K + k];
+
+              offset = (n / (indptr.size(-1) - 1)) * E * K;
+              for (auto e = row_start; e < row_end; e++)
+                for (auto k = 0; k < K; k++)
+                  out_data[offset + e * K + k] = vals[k];
+            }
+          });
+    });
+  });
+
+  return out;
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_csr_gather_cpu(torch::Tensor src, torch::Tensor indptr,
+                       torch::Tensor col,
+                       torch::optional<torch::Tensor> optional_weight,
+                       std::string reduce) {
+  CHECK_CPU(src);
+  CHECK_CPU(indptr);
+  CHECK_CPU(col);
+  if (optional_weight.has_value())
+    CHECK_CPU(optional_weight.value());
+
+  CHECK_INPUT(src.dim() >= 1);
+  CHECK_INPUT(indptr.dim() == 1);
+  CHECK_INPUT(col.dim() == 1);
+  CHECK_INPUT(indptr.scalar_type() == col.scalar_type());
+  if (optional_weight.has_value()) {
+    CHECK_INPUT(optional_weight.value().dim() == 1);
+    CHECK_INPUT(optional_weight.value().numel() == col.numel());
+    CHECK_INPUT(optional_weight.value().scalar_type() == src.scalar_type());
+  }
+
+  src = src.contiguous();
+  indptr = indptr.contiguous();
+  col = col.contiguous();
+
+  auto sizes = src.sizes().vec();
+  sizes[0] = std::max<int64_t>(indptr.numel() - 1, 0);
+  auto out = torch::empty(sizes, src.options());
+
+  torch::optional<torch::Tensor> arg_out = torch::nullopt;
+  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
+    arg_out = torch::full(out.sizes(), col.numel(), col.options());
+
+  if (out.numel() == 0)
+    return std::make_tuple(out, arg_out);
 
-      for (auto k = 0; k < K; k++)
-        vals[k] = src_data[n * K + k];
+  if (col.numel() == 0) {
+    out.fill_(0);
+    return std::make_tuple(out, arg_out);
+  }
+
+  auto N = out.size(0);
+  auto K = out.numel() / N;
 
-      offset = (n / (indptr.size(-1) - 1)) * E * K;
-      for (auto e = row_start; e < row_end; e++)
-        for (auto k = 0; k < K; k++)
-          out_data[offset + e * K + k] = vals[k];
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+
+    torch::Tensor weight;
+    scalar_t *weight_data = nullptr;
+    if (optional_weight.has_value()) {
+      weight = optional_weight.value().contiguous();
+      weight_data = weight.data_ptr<scalar_t>();
     }
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_data = indptr.data_ptr<index_t>();
+      auto col_data = col.data_ptr<index_t>();
+      index_t *arg_out_data = nullptr;
+      if (arg_out.has_value())
+        arg_out_data = arg_out.value().data_ptr<index_t>();
+
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        using acc_t = typename AccType<scalar_t>::type;
+
+        // Instead of materializing `src[col]`, we read the source rows of each
+        // edge directly while reducing.
+        at::parallel_for(
+            0, N, grain_size(N, col.numel() * K),
+            [&](int64_t begin, int64_t end) {
+              std::vector<acc_t> vals(K);
+              std::vector<int64_t> args(K);
+              int64_t row_start, row_end, offset;
+              for (auto n = begin; n < end; n++) {
+                row_start = indptr_data[n];
+                row_end = indptr_data[n + 1];
+
+                for (auto k = 0; k < K; k++)
+                  vals[k] = Reducer<acc_t, REDUCE>::init();
+
+                for (auto e = row_start; e < row_end; e++) {
+                  offset = col_data[e] * K;
+                  if (weight_data != nullptr)
+                    VecReducer<scalar_t, REDUCE>::update(
+                        vals.data(), src_data + offset, weight_data[e],
+                        args.data(), e, K);
+                  else
+                    VecReducer<scalar_t, REDUCE>::update(
+                        vals.data(), src_data + offset, args.data(), e, K);
+                }
+
+                VecReducer<scalar_t, REDUCE>::write(
+                    out_data + n * K, vals.data(), arg_out_data + n * K,
+                    args.data(), row_end - row_start, K);
+              }
+            });
+      });
+    });
+  });
+
+  return std::make_tuple(out, arg_out);
+}
+
+torch::Tensor sddmm_csr_cpu(torch::Tensor a, torch::Tensor indptr,
+                            torch::Tensor col, torch::Tensor b) {
+  CHECK_CPU(a);
+  CHECK_CPU(indptr);
+  CHECK_CPU(col);
+  CHECK_CPU(b);
+
+  CHECK_INPUT(indptr.dim() == 1 && col.dim() == 1);
+  CHECK_INPUT(indptr.scalar_type() == col.scalar_type());
+  CHECK_INPUT(a.size(0) == indptr.numel() - 1);
+  CHECK_INPUT(a.numel() / std::max<int64_t>(a.size(0), 1) ==
+              b.numel() / std::max<int64_t>(b.size(0), 1));
+
+  a = a.contiguous();
+  b = b.contiguous();
+  indptr = indptr.contiguous();
+  col = col.contiguous();
+
+  auto out = torch::zeros({col.numel()}, a.options());
+  if (col.numel() == 0 || a.numel() == 0)
+    return out;
+
+  auto N = a.size(0);
+  auto K = a.numel() / N;
+
+  AT_DISPATCH_SCATTER_TYPES(a.scalar_type(), "_", [&] {
+    auto a_data = a.data_ptr<scalar_t>();
+    auto b_data = b.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_data = indptr.data_ptr<index_t>();
+      auto col_data = col.data_ptr<index_t>();
+      at::parallel_for(
+          0, N, grain_size(N, col.numel() * K),
+          [&](int64_t begin, int64_t end) {
+            using acc_t = typename AccType<scalar_t>::type;
+            acc_t val;
+            for (auto n = begin; n < end; n++) {
+              for (int64_t e = indptr_data[n]; e < indptr_data[n + 1]; e++) {
+                val = (acc_t)0;
+                for (auto k = 0; k < K; k++)
+                  val += (acc_t)a_data[n * K + k] *
+                         (acc_t)b_data[col_data[e] * K + k];
+                out_data[e] = (scalar_t)val;
+              }
+            }
+          });
+    });
   });
 
   return out;
 }
+
+torch::Tensor segment_softmax_csr_cpu(torch::Tensor src, torch::Tensor indptr,
+                                      bool log) {
+  CHECK_CPU(src);
+  CHECK_CPU(indptr);
+
+  CHECK_INPUT(src.dim() >= indptr.dim());
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = src.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  src = src.contiguous();
+
+  // Every entry of `src` is expected to belong to exactly one segment, such
+  // that `out` gets fully written without any prior initialization.
+  auto out = torch::empty_like(src);
+  if (src.numel() == 0 || indptr.size(dim) <= 1)
+    return out;
+
+  auto N = (indptr.size(dim) - 1) * (indptr.numel() / indptr.size(-1));
+  auto E = src.size(dim);
+  auto K = src.numel() / (E * (indptr.numel() / indptr.size(-1)));
+
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_info = getTensorInfo<index_t, int64_t>(indptr);
+      auto stride = indptr_info.strides[indptr_info.dims - 1];
+      using acc_t = typename AccType<scalar_t>::type;
+
+      at::parallel_for(
+          0, N, grain_size(N, src.numel()), [&](int64_t begin, int64_t end) {
+            std::vector<acc_t> max(K), sum(K);
+            int64_t row_start, row_end;
+            acc_t val;
+            for (auto n = begin; n < end; n++) {
+              auto offset =
+                  IndexPtrToOffset<index_t, int64_t>::get(n, indptr_info);
+              row_start = indptr_info.data[offset];
+              row_end = indptr_info.data[offset + stride];
+
+              offset = (n / (indptr.size(-1) - 1)) * E * K;
+              auto src_row = src_data + offset, out_row = out_data + offset;
+              for (auto k = 0; k < K; k++) {
+                max[k] = -std::numeric_limits<acc_t>::infinity();
+                sum[k] = (acc_t)0;
+              }
+
+              for (auto e = row_start; e < row_end; e++)
+                for (auto k = 0; k < K; k++)
+                  max[k] = std::max(max[k], (acc_t)src_row[e * K + k]);
+              for (auto e = row_start; e < row_end; e++)
+                for (auto k = 0; k < K; k++)
+                  sum[k] += std::exp((acc_t)src_row[e * K + k] - max[k]);
+              if (log)
+                for (auto k = 0; k < K; k++)
+                  max[k] += std::log(sum[k]);
+
+              for (auto e = row_start; e < row_end; e++) {
+                for (auto k = 0; k < K; k++) {
+                  val = (acc_t)src_row[e * K + k] - max[k];
+                  out_row[e * K + k] =
+                      (scalar_t)(log ? val : std::exp(val) / sum[k]);
+                }
+              }
+            }
+          });
+    });
+  });
+
+  return out;
+}
+
+torch::Tensor segment_softmax_csr_backward_cpu(torch::Tensor out,
+                                               torch::Tensor grad_out,
+                                               torch::Tensor indptr, bool log) {
+  CHECK_CPU(out);
+  CHECK_CPU(grad_out);
+  CHECK_CPU(indptr);
+
+  CHECK_INPUT(out.sizes() == grad_out.sizes());
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = out.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  out = out.contiguous();
+  grad_out = grad_out.contiguous();
+
+  auto grad_in = torch::empty_like(out);
+  if (out.numel() == 0 || indptr.size(dim) <= 1)
+    return grad_in;
+
+  auto N = (indptr.size(dim) - 1) * (indptr.numel() / indptr.size(-1));
+  auto E = out.size(dim);
+  auto K = out.numel() / (E * (indptr.numel() / indptr.size(-1)));
+
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(out.scalar_type(), "_", [&] {
+    auto out_data = out.data_ptr<scalar_t>();
+    auto grad_out_data = grad_out.data_ptr<scalar_t>();
+    auto grad_in_data = grad_in.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_info = getTensorInfo<index_t, int64_t>(indptr);
+      auto stride = indptr_info.strides[indptr_info.dims - 1];
+      using acc_t = typename AccType<scalar_t>::type;
+
+      // The gradient of softmax `y` is given by `y * (grad - sum(grad * y))`,
+      // and the one of log-softmax `y` by `grad - exp(y) * sum(grad)`.
+      at::parallel_for(
+          0, N, grain_size(N, out.numel()), [&](int64_t begin, int64_t end) {
+            std::vector<acc_t> dot(K);
+            int64_t row_start, row_end, i;
+            acc_t y, grad;
+            for (auto n = begin; n < end; n++) {
+              auto offset =
+                  IndexPtrToOffset<index_t, int64_t>::get(n, indptr_info);
+              row_start = indptr_info.data[offset];
+              row_end = indptr_info.data[offset + stride];
+
+              offset = (n / (indptr.size(-1) - 1)) * E * K;
+              for (auto k = 0; k < K; k++)
+                dot[k] = (acc_t)0;
+
+              for (auto e = row_start; e < row_end; e++) {
+                for (auto k = 0; k < K; k++) {
+                  i = offset + e * K + k;
+                  grad = (acc_t)grad_out_data[i];
+                  dot[k] += log ? grad : grad * (acc_t)out_data[i];
+                }
+              }
+
+              for (auto e = row_start; e < row_end; e++) {
+                for (auto k = 0; k < K; k++) {
+                  i = offset + e * K + k;
+                  y = (acc_t)out_data[i];
+                  grad = (acc_t)grad_out_data[i];
+                  grad_in_data[i] = (scalar_t)(log ? grad - std::exp(y) * dot[k]
+                                                   : y * (grad - dot[k]));
+                }
+              }
+            }
+          });
+    });
+  });
+
+  return grad_in;
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_stat_csr_cpu(torch::Tensor src, torch::Tensor indptr,
+                     std::string reduce, bool unbiased) {
+  CHECK_CPU(src);
+  CHECK_CPU(indptr);
+
+  CHECK_INPUT(src.dim() >= indptr.dim());
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = src.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  src = src.contiguous();
+
+  sizes = src.sizes().vec();
+  sizes[dim] = std::max<int64_t>(indptr.size(dim) - 1, 0);
+  auto out = torch::empty(sizes, src.options());
+
+  // For VAR and STD, `mean` holds the mean of each segment for backward.
+  torch::optional<torch::Tensor> mean = torch::nullopt;
+  if (stat2REDUCE.at(reduce) != LOGSUMEXP)
+    mean = torch::empty(sizes, src.options());
+
+  if (src.numel() == 0 || out.numel() == 0) {
+    if (stat2REDUCE.at(reduce) == LOGSUMEXP)
+      out.fill_(-std::numeric_limits<double>::infinity());
+    else {
+      out.fill_(0);
+      mean.value().fill_(0);
+    }
+    return std::make_tuple(out, mean);
+  }
+
+  auto N = out.size(dim) * (indptr.numel() / indptr.size(-1));
+  auto K = out.numel() / N;
+  auto E = src.size(dim);
+
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *mean_data = nullptr;
+    if (mean.has_value())
+      mean_data = mean.value().data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_info = getTensorInfo<index_t, int64_t>(indptr);
+      auto stride = indptr_info.strides[indptr_info.dims - 1];
+
+      AT_DISPATCH_STAT_TYPES(reduce, [&] {
+        using acc_t = typename AccType<scalar_t>::type;
+
+        // Each row is reduced in a single pass over `src` by keeping a
+        // `Welford` (for VAR/STD) or a `LogSumExp` (for LOGSUMEXP) state per
+        // entry of the feature dimension.
+        at::parallel_for(
+            0, N, grain_size(N, src.numel()), [&](int64_t begin, int64_t end) {
+              std::vector<Welford<acc_t>> welford(K);
+              std::vector<LogSumExp<acc_t>> lse(K);
+              int64_t row_start, row_end;
+              for (auto n = begin; n < end; n++) {
+                auto offset =
+                    IndexPtrToOffset<index_t, int64_t>::get(n, indptr_info);
+                row_start = indptr_info.data[offset];
+                row_end = indptr_info.data[offset + stride];
+
+                offset = (n / (indptr.size(-1) - 1)) * E * K;
+                for (auto k = 0; k < K; k++) {
+                  if (REDUCE == LOGSUMEXP)
+                    lse[k] = LogSumExp<acc_t>();
+                  else
+                    welford[k] = Welford<acc_t>();
+                }
+
+                for (auto e = row_start; e < row_end; e++) {
+                  for (auto k = 0; k < K; k++) {
+                    auto val = (acc_t)src_data[offset + e * K + k];
+                    if (REDUCE == LOGSUMEXP)
+                      lse[k].update(val);
+                    else
+                      welford[k].update(val);
+                  }
+                }
+
+                for (auto k = 0; k < K; k++) {
+                  if (REDUCE == LOGSUMEXP)
+                    out_data[n * K + k] = (scalar_t)lse[k].value();
+                  else {
+                    auto var = welford[k].var(unbiased);
+                    out_data[n * K + k] =
+                        (scalar_t)(REDUCE == STD ? std::sqrt(var) : var);
+                    mean_data[n * K + k] = (scalar_t)welford[k].mean;
+                  }
+                }
+              }
+            });
+      });
+    });
+  });
+
+  return std::make_tuple(out, mean);
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>,
+           torch::optional<torch::Tensor>>
+segment_csr_multi_cpu(torch::Tensor src, torch::Tensor indptr,
+                      std::vector<std::string> reduces, bool unbiased) {
+  CHECK_CPU(src);
+  CHECK_CPU(indptr);
+
+  CHECK_INPUT(src.dim() >= indptr.dim());
+
+  auto multi = getMultiReduce(reduces);
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = src.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  src = src.contiguous();
+
+  // All outputs are stacked along a new leading dimension in the order given
+  // by `reduces`.
+  sizes = src.sizes().vec();
+  sizes[dim] = std::max<int64_t>(indptr.size(dim) - 1, 0);
+  sizes.insert(sizes.begin(), multi.num);
+  auto out = torch::empty(sizes, src.options());
+
+  // For VAR and STD, `mean` holds the mean of each segment for backward.
+  torch::optional<torch::Tensor> mean = torch::nullopt;
+  if (multi.has(VAR) || multi.has(STD))
+    mean = torch::zeros(out[0].sizes(), src.options());
+
+  // Arguments are only written for MIN and MAX, and point to `src.size(dim)`
+  // otherwise.
+  torch::optional<torch::Tensor> arg_out = torch::nullopt;
+  if (multi.has(MIN) || multi.has(MAX))
+    arg_out = torch::full(out.sizes(), src.size(dim), indptr.options());
+
+  if (src.numel() == 0 || out.numel() == 0) {
+    out.fill_(0);
+    return std::make_tuple(out, mean, arg_out);
+  }
+
+  auto N = out.size(dim + 1) * (indptr.numel() / indptr.size(-1));
+  auto K = out[0].numel() / N;
+  auto E = src.size(dim);
+
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
+    using acc_t = typename AccType<scalar_t>::type;
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *mean_data = nullptr;
+    if (mean.has_value())
+      mean_data = mean.value().data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_info = getTensorInfo<index_t, int64_t>(indptr);
+      auto stride = indptr_info.strides[indptr_info.dims - 1];
+      index_t *arg_out_data = nullptr;
+      if (arg_out.has_value())
+        arg_out_data = arg_out.value().data_ptr<index_t>();
+
+      // Each row is reduced in a single pass over `src` by keeping the state
+      // of all requested reductions per entry of the feature dimension.
+      at::parallel_for(
+          0, N, grain_size(N, src.numel()), [&](int64_t begin, int64_t end) {
+            std::vector<MultiReducer<acc_t>> vals(K, MultiReducer<acc_t>(E));
+            int64_t row_start, row_end;
+            for (auto n = begin; n < end; n++) {
+              auto offset =
+                  IndexPtrToOffset<index_t, int64_t>::get(n, indptr_info);
+              row_start = indptr_info.data[offset];
+              row_end = indptr_info.data[offset + stride];
+
+              offset = (n / (indptr.size(-1) - 1)) * E * K;
+              std::fill(vals.begin(), vals.end(), MultiReducer<acc_t>(E));
+
+              for (auto e = row_start; e < row_end; e++)
+                for (auto k = 0; k < K; k++)
+                  vals[k].update((acc_t)src_data[offset + e * K + k], e);
+
+              for (auto k = 0; k < K; k++) {
+                for (auto r = 0; r < multi.num; r++) {
+                  auto out_idx = r * N * K + n * K + k;
+                  auto reduce = multi.reduces[r];
+                  out_data[out_idx] = (scalar_t)vals[k].value(reduce, unbiased);
+                  if (row_end > row_start && (reduce == MIN || reduce == MAX))
+                    arg_out_data[out_idx] = (index_t)(
+                        reduce == MIN ? vals[k].arg_min : vals[k].arg_max);
+                }
+                if (mean_data != nullptr)
+                  mean_data[n * K + k] = (scalar_t)vals[k].welford.mean;
+              }
+            }
+          });
+    });
+  });
+
+  return std::make_tuple(out, mean, arg_out);
+}
+
+std::vector<torch::Tensor>
+segment_csr_batched_cpu(std::vector<torch::Tensor> srcs,
+                        std::vector<torch::Tensor> indptrs,
+                        std::string reduce) {
+  CHECK_INPUT(srcs.size() == indptrs.size());
+  if (srcs.size() == 0)
+    return {};
+
+  // All outputs are views into a single allocation, in problem order.
+  std::vector<std::vector<int64_t>> sizes;
+  std::vector<int64_t> offsets = {0};
+  int64_t numel = 0;
+  for (size_t i = 0; i < srcs.size(); i++) {
+    CHECK_CPU(srcs[i]);
+    CHECK_CPU(indptrs[i]);
+    CHECK_INPUT(srcs[i].dim() >= 1 && indptrs[i].dim() == 1);
+    CHECK_INPUT(srcs[i].scalar_type() == srcs[0].scalar_type());
+
+    auto size = srcs[i].sizes().vec();
+    size[0] = std::max<int64_t>(indptrs[i].numel() - 1, 0);
+    int64_t size_numel = 1;
+    for (auto s : size)
+      size_numel *= s;
+    sizes.push_back(size);
+    numel += size_numel;
+    offsets.push_back(numel);
+  }
+
+  auto out = torch::empty({numel}, srcs[0].options());
+  std::vector<torch::Tensor> outs;
+  for (size_t i = 0; i < srcs.size(); i++) {
+    outs.push_back(out.narrow(0, offsets[i], offsets[i + 1] - offsets[i])
+                       .view(sizes[i]));
+
+    // There is no launch overhead to amortize on the CPU, so problems are
+    // simply reduced one after another.
+    if (srcs[i].numel() == 0)
+      outs[i].fill_(0);
+    else
+      segment_csr_cpu(srcs[i], indptrs[i], outs[i], reduce);
+  }
+
+  return outs;
+}
+
+torch::Tensor segment_csr_arg_backward_cpu(torch::Tensor grad_out,
+                                           torch::Tensor arg_out, int64_t dim,
+                                           std::vector<int64_t> src_sizes) {
+  return arg_backward_cpu(grad_out, arg_out, dim, src_sizes);
+}
@@ -4,8 +4,43 @@
 
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_csr_cpu(torch::Tensor src, torch::Tensor indptr,
-                torch::optional<torch::Tensor> optional_out,
-                std::string reduce);
+                torch::optional<torch::Tensor> optional_out, std::string reduce,
+                torch::optional<torch::Tensor> optional_weight =
+                    torch::nullopt);
 
 torch::Tensor gather_csr_cpu(torch::Tensor src, torch::Tensor indptr,
                              torch::optional<torch::Tensor> optional_out);
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_csr_gather_cpu(torch::Tensor src, torch::Tensor indptr,
+                       torch::Tensor col,
+                       torch::optional<torch::Tensor> optional_weight,
+                       std::string reduce);
+
+torch::Tensor sddmm_csr_cpu(torch::Tensor a, torch::Tensor indptr,
+                            torch::Tensor col, torch::Tensor b);
+
+torch::Tensor segment_softmax_csr_cpu(torch::Tensor src, torch::Tensor indptr,
+                                      bool log);
+
+torch::Tensor segment_softmax_csr_backward_cpu(torch::Tensor out,
+                                               torch::Tensor grad_out,
+                                               torch::Tensor indptr, bool log);
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_stat_csr_cpu(torch::Tensor src, torch::Tensor indptr,
+                     std::string reduce, bool unbiased);
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>,
+           torch::optional<torch::Tensor>>
+segment_csr_multi_cpu(torch::Tensor src, torch::Tensor indptr,
+                      std::vector<std::string> reduces, bool unbiased);
+
+std::vector<torch::Tensor>
+segment_csr_batched_cpu(std::vector<torch::Tensor> srcs,
+                        std::vector<torch::Tensor> indptrs,
+                        std::string reduce);
+
+torch::Tensor segment_csr_arg_backward_cpu(torch::Tensor grad_out,
+                                           torch::Tensor arg_out, int64_t dim,
+                                           std::vector<int64_t> src_sizes);
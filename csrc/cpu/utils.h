@@ -1,6 +1,72 @@
 #pragma once
 
+#include <ATen/Parallel.h>
 #include <torch/extension.h>
 
 #define CHECK_CPU(x) AT_ASSERTM(x.device().is_cpu(), #x " must be CPU tensor")
 #define CHECK_INPUT(x) AT_ASSERTM(x, "Input mismatch")
+
+// Dispatches over all data types supported by our kernels.
+#define AT_DISPATCH_SCATTER_TYPES(TYPE, NAME, ...)                             \
+  AT_DISPATCH_ALL_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16,   \
+                             TYPE, NAME, __VA_ARGS__)
+
+// Dispatches over all floating-point data types supported by our kernels.
+#define AT_DISPATCH_SCATTER_FLOATING_TYPES(TYPE, NAME, ...)                    \
+  AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half,                        \
+                                  at::ScalarType::BFloat16, TYPE, NAME,        \
+                                  __VA_ARGS__)
+
+// Returns the grain size for `at::parallel_for` over `numel` independent
+// iterations that touch `work` elements in total. Small workloads run on a
+// single thread, while larger ones are split into one chunk per thread as
+// configured via `torch.set_num_threads()`.
+inline int64_t grain_size(int64_t numel, int64_t work) {
+  if (work < at::internal::GRAIN_SIZE)
+    return std::max<int64_t>(numel, 1);
+  int64_t num_threads = at::get_num_threads();
+  return std::max<int64_t>((numel + num_threads - 1) / num_threads, 1);
+}
+
+// Routes `grad_out` to the positions `arg_out` along `dim` of a zero-filled
+// gradient of size `src_sizes`, which is the backward pass of MIN and MAX.
+// Arguments equal to `src_sizes[dim]` mark outputs which did not receive any
+// value and are skipped. Since every source entry is the argument of at most
+// one output, all writes are independent of each other.
+inline torch::Tensor arg_backward_cpu(torch::Tensor grad_out,
+                                      torch::Tensor arg_out, int64_t dim,
+                                      std::vector<int64_t> src_sizes) {
+  grad_out = grad_out.contiguous();
+  arg_out = arg_out.contiguous();
+  auto grad_in = torch::zeros(src_sizes, grad_out.options());
+  if (grad_out.numel() == 0 || grad_in.numel() == 0)
+    return grad_in;
+
+  auto E = grad_in.size(dim);
+  auto N = grad_out.size(dim);
+  auto K = grad_out.stride(dim);
+  auto BN = grad_out.numel() / K;
+
+  AT_DISPATCH_SCATTER_TYPES(grad_out.scalar_type(), "_", [&] {
+    auto grad_out_data = grad_out.data_ptr<scalar_t>();
+    auto grad_in_data = grad_in.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(arg_out.scalar_type(), "_", [&] {
+      auto arg_out_data = arg_out.data_ptr<index_t>();
+      at::parallel_for(
+          0, BN, grain_size(BN, grad_out.numel()),
+          [&](int64_t begin, int64_t end) {
+            for (auto i = begin; i < end; i++) {
+              auto offset = (i / N) * E * K;
+              for (auto k = 0; k < K; k++) {
+                int64_t arg = arg_out_data[i * K + k];
+                if (arg >= 0 && arg < E)
+                  grad_in_data[offset + arg * K + k] = grad_out_data[i * K + k];
+              }
+            }
+          });
+    });
+  });
+
+  return grad_in;
+}
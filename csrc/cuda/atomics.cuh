@@ -1,5 +1,9 @@
 #pragma once
 
+#if defined(CUDA_VERSION) && CUDA_VERSION >= 11000
+#include <cuda_bf16.h>
+#endif
+
 #define ATOMIC(NAME)                                                           \
   template <typename scalar, size_t size> struct Atomic##NAME##IntegerImpl;    \
                                                                                \
@@ -77,7 +81,7 @@
                                                                                \
       do {                                                                     \
         assumed = old;                                                         \
-        at::Half hsum;                                                         \
+        scalar hsum;                                                           \
         hsum.x = (size_t)address & 2 ? (old >> 16) : (old & 0xffff);           \
         hsum = OP(hsum, val);                                                  \
         old = (size_t)address & 2 ? (old & 0xffff) | (hsum.x << 16)            \
@@ -135,15 +139,30 @@ static inline __device__ void atomAdd(int32_t *address, int32_t val) {
 static inline __device__ void atomAdd(int64_t *address, int64_t val) {
   AtomicAddIntegerImpl<int64_t, sizeof(int64_t)>()(address, val);
 }
-#if defined(__CUDA_ARCH__) && (__CUDA_ARCH__ < 700 || CUDA_VERSION < 10000)
 static inline __device__ void atomAdd(at::Half *address, at::Half val) {
+#if defined(__CUDA_ARCH__) && (__CUDA_ARCH__ < 600 || CUDA_VERSION < 10000)
   AtomicAddDecimalImpl<at::Half, sizeof(at::Half)>()(address, val);
-}
+#elif defined(__CUDA_ARCH__) && __CUDA_ARCH__ < 700
+  // Pre-Volta GPUs only provide a native `__half2` atomic, so we add zero to
+  // the neighbouring value sharing the same 32-bit word.
+  __half2 *address_as_h2 =
+      (__half2 *)((char *)address - ((size_t)address & 2));
+  __half zero = __float2half(0.0f);
+  atomicAdd(address_as_h2, (size_t)address & 2 ? __halves2half2(zero, val)
+                                               : __halves2half2(val, zero));
 #else
-static inline __device__ void atomAdd(at::Half *address, at::Half val) {
   atomicAdd(reinterpret_cast<__half *>(address), val);
+#endif
 }
+static inline __device__ void atomAdd(at::BFloat16 *address, at::BFloat16 val) {
+#if defined(__CUDA_ARCH__) && __CUDA_ARCH__ >= 800 && CUDA_VERSION >= 11000
+  __nv_bfloat16_raw raw;
+  raw.x = val.x;
+  atomicAdd(reinterpret_cast<__nv_bfloat16 *>(address), __nv_bfloat16(raw));
+#else
+  AtomicAddDecimalImpl<at::BFloat16, sizeof(at::BFloat16)>()(address, val);
 #endif
+}
 static inline __device__ void atomAdd(float *address, float val) {
   atomicAdd(address, val);
 }
@@ -181,6 +200,10 @@ static inline __device__ void atomMul(float *address, float val) {
 static inline __device__ void atomMul(at::Half *address, at::Half val) {
   AtomicMulDecimalImpl<at::Half, sizeof(at::Half)>()(address, val);
 }
+static inline __device__ void atomMul(at::BFloat16 *address,
+                                      at::BFloat16 val) {
+  AtomicMulDecimalImpl<at::BFloat16, sizeof(at::BFloat16)>()(address, val);
+}
 static inline __device__ void atomMul(double *address, double val) {
   AtomicMulDecimalImpl<double, sizeof(double)>()(address, val);
 }
@@ -206,6 +229,10 @@ static inline __device__ void atomDiv(int64_t *address, int64_t val) {
 static inline __device__ void atomDiv(at::Half *address, at::Half val) {
   AtomicDivDecimalImpl<at::Half, sizeof(at::Half)>()(address, val);
 }
+static inline __device__ void atomDiv(at::BFloat16 *address,
+                                      at::BFloat16 val) {
+  AtomicDivDecimalImpl<at::BFloat16, sizeof(at::BFloat16)>()(address, val);
+}
 static inline __device__ void atomDiv(float *address, float val) {
   AtomicDivDecimalImpl<float, sizeof(float)>()(address, val);
 }
@@ -234,6 +261,10 @@ static inline __device__ void atomMax(int64_t *address, int64_t val) {
 static inline __device__ void atomMax(at::Half *address, at::Half val) {
   AtomicMaxDecimalImpl<at::Half, sizeof(at::Half)>()(address, val);
 }
+static inline __device__ void atomMax(at::BFloat16 *address,
+                                      at::BFloat16 val) {
+  AtomicMaxDecimalImpl<at::BFloat16, sizeof(at::BFloat16)>()(address, val);
+}
 static inline __device__ void atomMax(float *address, float val) {
   AtomicMaxDecimalImpl<float, sizeof(float)>()(address, val);
 }
@@ -262,6 +293,10 @@ static inline __device__ void atomMin(int64_t *address, int64_t val) {
 static inline __device__ void atomMin(at::Half *address, at::Half val) {
   AtomicMinDecimalImpl<at::Half, sizeof(at::Half)>()(address, val);
 }
+static inline __device__ void atomMin(at::BFloat16 *address,
+                                      at::BFloat16 val) {
+  AtomicMinDecimalImpl<at::BFloat16, sizeof(at::BFloat16)>()(address, val);
+}
 static inline __device__ void atomMin(float *address, float val) {
   AtomicMinDecimalImpl<float, sizeof(float)>()(address, val);
 }
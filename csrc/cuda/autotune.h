@@ -0,0 +1,159 @@
+#pragma once
+
+#include <ATen/cuda/CUDAContext.h>
+#include <torch/extension.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "host_sync.h"
+
+// Kernel variants (such as the number of lanes `TB` cooperating on a row)
+// are picked via fixed thresholds on the average row length by default.
+// Setting `TORCH_SCATTER_AUTOTUNE=1` instead benchmarks all candidates on
+// the first call for a given (device architecture, dtype, K bucket, average
+// row length bucket), and re-uses the winner from then on:
+//   `TORCH_SCATTER_AUTOTUNE_CACHE=<file>`: Loads winners from and stores
+//       them to the given file for a fast warm startup.
+//   `TORCH_SCATTER_TB=<value>`: Forces the given variant wherever it is a
+//       candidate, regardless of autotuning.
+// Benchmarking requires a host-device sync, and is hence skipped in
+// "strict" sync mode and during CUDA graph capture.
+
+#define AUTOTUNE_RUNS 3
+
+inline bool autotune_enabled() {
+  auto value = std::getenv("TORCH_SCATTER_AUTOTUNE");
+  return value != nullptr && std::string(value) == "1";
+}
+
+inline int autotune_override() {
+  auto value = std::getenv("TORCH_SCATTER_TB");
+  return value == nullptr ? 0 : std::atoi(value);
+}
+
+inline int64_t autotune_bucket(double value) {
+  return value < 1 ? 0 : (int64_t)std::log2(value) + 1;
+}
+
+// Returns the cache key of problems of the given class.
+inline std::string autotune_key(const std::string &name,
+                                const torch::Tensor &src, int64_t K,
+                                double avg_len) {
+  auto prop = at::cuda::getDeviceProperties(src.get_device());
+  return c10::str(name, ":sm", prop->major, prop->minor, ":",
+                  src.scalar_type(), ":K", autotune_bucket(K), ":L",
+                  autotune_bucket(avg_len));
+}
+
+inline std::mutex &autotune_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Returns the tuned winners of this extension, populated from
+// `TORCH_SCATTER_AUTOTUNE_CACHE` (holding `<key> <value>` lines) on first
+// access.
+inline std::unordered_map<std::string, int> &autotune_cache() {
+  static std::unordered_map<std::string, int> cache = [] {
+    std::unordered_map<std::string, int> cache;
+    auto path = std::getenv("TORCH_SCATTER_AUTOTUNE_CACHE");
+    if (path != nullptr) {
+      std::ifstream file(path);
+      std::string key;
+      int value;
+      while (file >> key >> value)
+        cache[key] = value;
+    }
+    return cache;
+  }();
+  return cache;
+}
+
+// Merges the winners of this extension into `TORCH_SCATTER_AUTOTUNE_CACHE`,
+// which may also hold the ones of other extensions.
+inline void autotune_save() {
+  auto path = std::getenv("TORCH_SCATTER_AUTOTUNE_CACHE");
+  if (path == nullptr)
+    return;
+  std::unordered_map<std::string, int> merged;
+  {
+    std::ifstream file(path);
+    std::string key;
+    int value;
+    while (file >> key >> value)
+      merged[key] = value;
+  }
+  for (const auto &entry : autotune_cache())
+    merged[entry.first] = entry.second;
+  std::ofstream file(path, std::ios::trunc);
+  for (const auto &entry : merged)
+    file << entry.first << " " << entry.second << "\n";
+}
+
+// Returns the variant out of `candidates` to use for problems with the key
+// returned by `get_key()`. If autotuning is enabled and the key is not yet
+// known, times `run(candidate)` for each candidate on the current stream, and
+// counts the required sync under `tag`.
+// `run` needs to write to scratch buffers only, since each candidate is run
+// several times.
+template <typename KeyFn, typename F>
+int autotune(SyncTag tag, KeyFn get_key, const std::vector<int> &candidates,
+             int fallback, F run) {
+  auto forced = autotune_override();
+  for (auto candidate : candidates)
+    if (candidate == forced)
+      return forced;
+
+  if (!autotune_enabled() || candidates.size() < 2)
+    return fallback;
+
+  auto key = get_key();
+  {
+    std::lock_guard<std::mutex> lock(autotune_mutex());
+    auto &cache = autotune_cache();
+    auto it = cache.find(key);
+    if (it != cache.end())
+      return it->second;
+  }
+
+  if (sync_mode() == SYNC_STRICT || is_stream_capturing())
+    return fallback;
+
+  auto stream = at::cuda::getCurrentCUDAStream();
+  cudaEvent_t start, stop;
+  C10_CUDA_CHECK(cudaEventCreate(&start));
+  C10_CUDA_CHECK(cudaEventCreate(&stop));
+
+  int best = fallback;
+  float best_time = std::numeric_limits<float>::infinity();
+  for (auto candidate : candidates) {
+    run(candidate); // Warm-up.
+    C10_CUDA_CHECK(cudaEventRecord(start, stream));
+    for (int i = 0; i < AUTOTUNE_RUNS; i++)
+      run(candidate);
+    C10_CUDA_CHECK(cudaEventRecord(stop, stream));
+    C10_CUDA_CHECK(cudaEventSynchronize(stop));
+    float time;
+    C10_CUDA_CHECK(cudaEventElapsedTime(&time, start, stop));
+    if (time < best_time) {
+      best = candidate;
+      best_time = time;
+    }
+  }
+
+  C10_CUDA_CHECK(cudaEventDestroy(start));
+  C10_CUDA_CHECK(cudaEventDestroy(stop));
+  host_sync_counters()[tag]++;
+
+  std::lock_guard<std::mutex> lock(autotune_mutex());
+  autotune_cache()[key] = best;
+  autotune_save();
+  return best;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <ATen/cuda/CUDAContext.h>
+#include <ATen/record_function.h>
+#include <torch/extension.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Output sizes that are not given explicitly need to be read back from the GPU,
+// which blocks the host until all queued kernels have finished and is illegal
+// during CUDA graph capture. The `TORCH_SCATTER_SYNC_MODE` environment variable
+// controls how this is handled:
+//   "default": Reads back the size on every call.
+//   "cache":   Reads back the size once per index tensor and re-uses it as long
+//              as the tensor is alive and has not been modified in-place.
+//   "strict":  Never reads back any size and raises an error on a cache miss.
+enum SyncMode { SYNC_DEFAULT, SYNC_CACHE, SYNC_STRICT };
+
+// The reasons for host-device syncs. All but the autotuning ones name values
+// that can be derived from (and hence cached for) a tensor.
+enum SyncTag {
+  SCATTER_SIZE,
+  SEGMENT_COO_SIZE,
+  SEGMENT_COO_AUTOTUNE,
+  GATHER_CSR_SIZE,
+  MERGE_PATH,
+  SEGMENT_CSR_AUTOTUNE,
+  NUM_SYNC_TAGS
+};
+
+inline SyncMode sync_mode() {
+  auto mode = std::getenv("TORCH_SCATTER_SYNC_MODE");
+  if (mode == nullptr || std::strcmp(mode, "default") == 0)
+    return SYNC_DEFAULT;
+  if (std::strcmp(mode, "cache") == 0)
+    return SYNC_CACHE;
+  if (std::strcmp(mode, "strict") == 0)
+    return SYNC_STRICT;
+  AT_ERROR("Invalid TORCH_SCATTER_SYNC_MODE '", mode,
+           "' (expected 'default', 'cache' or 'strict')");
+}
+
+// Syncs are counted per tag, since depending on the platform, the counters of
+// all extensions may get merged into a single object. Each extension then only
+// reports the tags of its own operations.
+inline std::array<std::atomic<int64_t>, NUM_SYNC_TAGS> &host_sync_counters() {
+  static std::array<std::atomic<int64_t>, NUM_SYNC_TAGS> counters{};
+  return counters;
+}
+
+// Returns the number of host-device syncs with the given tags performed so far.
+inline int64_t host_sync_count(const std::vector<SyncTag> &tags, bool reset) {
+  int64_t count = 0;
+  for (auto tag : tags) {
+    auto &counter = host_sync_counters()[tag];
+    count += reset ? counter.exchange(0) : counter.load();
+  }
+  return count;
+}
+
+inline bool is_stream_capturing() {
+  cudaStreamCaptureStatus status;
+  C10_CUDA_CHECK(
+      cudaStreamIsCapturing(at::cuda::getCurrentCUDAStream(), &status));
+  return status != cudaStreamCaptureStatusNone;
+}
+
+struct SyncCacheEntry {
+  SyncCacheEntry(const torch::Tensor &tensor, SyncTag tag, int64_t value)
+      : storage(tensor.storage().getIntrusivePtr()),
+        version(tensor._version()), offset(tensor.storage_offset()),
+        sizes(tensor.sizes().vec()), strides(tensor.strides().vec()), tag(tag),
+        value(value) {}
+
+  bool matches(const torch::Tensor &tensor, SyncTag tag) const {
+    // A weak reference ensures that we never match a new tensor which happens
+    // to be allocated at the address of an already freed one.
+    auto ptr = storage.lock();
+    return ptr.get() == tensor.storage().unsafeGetStorageImpl() &&
+           this->tag == tag && version == tensor._version() &&
+           offset == tensor.storage_offset() && sizes == tensor.sizes() &&
+           strides == tensor.strides();
+  }
+
+  c10::weak_intrusive_ptr<c10::StorageImpl> storage;
+  int64_t version, offset;
+  std::vector<int64_t> sizes, strides;
+  SyncTag tag;
+  int64_t value;
+};
+
+#define SYNC_CACHE_SIZE 16
+
+inline std::vector<SyncCacheEntry> &sync_cache() {
+  static std::vector<SyncCacheEntry> cache;
+  return cache;
+}
+
+inline std::mutex &sync_cache_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Returns the value of the single-element tensor computed by `fn` from
+// `tensor`, or `nullopt` in case this would require a host-device sync which
+// is not allowed in the current mode.
+template <typename F>
+torch::optional<int64_t> sync_item(const torch::Tensor &tensor, SyncTag tag,
+                                   F fn) {
+  auto mode = sync_mode();
+  bool cacheable = mode != SYNC_DEFAULT && !tensor.is_inference();
+
+  if (cacheable) {
+    std::lock_guard<std::mutex> lock(sync_cache_mutex());
+    for (const auto &entry : sync_cache())
+      if (entry.matches(tensor, tag))
+        return entry.value;
+  }
+
+  if (mode == SYNC_STRICT || is_stream_capturing())
+    return torch::nullopt;
+
+  host_sync_counters()[tag]++;
+  int64_t value;
+  {
+    RECORD_FUNCTION("torch_scatter::host_sync", std::vector<c10::IValue>());
+    value = fn().template item<int64_t>();
+  }
+
+  if (cacheable) {
+    std::lock_guard<std::mutex> lock(sync_cache_mutex());
+    auto &cache = sync_cache();
+    if (cache.size() >= SYNC_CACHE_SIZE)
+      cache.erase(cache.begin());
+    cache.emplace_back(tensor, tag, value);
+  }
+
+  return value;
+}
@@ -1,13 +1,46 @@
 #pragma once
 
 #include <ATen/cuda/detail/TensorInfo.cuh>
+#include <torch/extension.h>
+
+// Selects 64-bit offset arithmetic in case any of the given tensors holds
+// more elements than can be addressed via 32-bit integers, and the faster
+// 32-bit arithmetic otherwise.
+#define AT_DISPATCH_OFFSET_TYPES(use_64bit, ...)                               \
+  [&] {                                                                        \
+    if (use_64bit) {                                                           \
+      using offset_t = int64_t;                                                \
+      return __VA_ARGS__();                                                    \
+    } else {                                                                   \
+      using offset_t = int;                                                    \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+  }()
+
+inline bool use_64bit_offsets(const std::vector<torch::Tensor> &tensors) {
+  for (const auto &tensor : tensors)
+    if (tensor.numel() > std::numeric_limits<int>::max())
+      return true;
+  return false;
+}
+
+// Whether `index` holds the same value for all entries along the dimensions
+// following `dim`, e.g., because it got broadcasted from a lower-dimensional
+// tensor.
+inline bool index_is_broadcasted(const torch::Tensor &index, int64_t dim) {
+  for (auto i = dim + 1; i < index.dim(); i++)
+    if (index.size(i) > 1 && index.stride(i) != 0)
+      return false;
+  return true;
+}
 
 // We need our own `IndexToOffset` implementation since we do not want to
 // access the last element of the `indexptr`.
-template <typename scalar_t> struct IndexPtrToOffset {
-  static inline __host__ __device__ int
-  get(int idx, const at::cuda::detail::TensorInfo<scalar_t, int> &info) {
-    int offset = idx % (info.sizes[info.dims - 1] - 1);
+template <typename scalar_t, typename offset_t = int> struct IndexPtrToOffset {
+  static inline __host__ __device__ offset_t
+  get(offset_t idx,
+      const at::cuda::detail::TensorInfo<scalar_t, offset_t> &info) {
+    offset_t offset = idx % (info.sizes[info.dims - 1] - 1);
     offset *= info.strides[info.dims - 1];
     idx /= info.sizes[info.dims - 1] - 1;
     for (int i = info.dims - 2; i >= 0; --i) {
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <ATen/AccumulateType.h>
+
 #include <limits>
 #include <map>
+#include <type_traits>
+#include <vector>
 
 #include "atomics.cuh"
 
-enum ReductionType { SUM, MEAN, MUL, DIV, MIN, MAX };
+// VAR, STD and LOGSUMEXP need more than a single value of running state, and
+// are therefore only supported by the segment kernels via `Welford` and
+// `LogSumExp` (dispatched via `AT_DISPATCH_STAT_TYPES`).
+enum ReductionType { SUM, MEAN, MUL, DIV, MIN, MAX, VAR, STD, LOGSUMEXP };
 
 const std::map<std::string, ReductionType> reduce2REDUCE = {
     {"sum", SUM}, {"mean", MEAN}, {"mul", MUL},
@@ -39,6 +46,31 @@ const std::map<std::string, ReductionType> reduce2REDUCE = {
       const ReductionType REDUCE = MAX;                                        \
       return __VA_ARGS__();                                                    \
     }                                                                          \
+    default:                                                                   \
+      AT_ERROR("Invalid reduction type");                                      \
+    }                                                                          \
+  }()
+
+const std::map<std::string, ReductionType> stat2REDUCE = {
+    {"var", VAR}, {"std", STD}, {"logsumexp", LOGSUMEXP}};
+
+#define AT_DISPATCH_STAT_TYPES(reduce, ...)                                    \
+  [&] {                                                                        \
+    switch (stat2REDUCE.at(reduce)) {                                          \
+    case VAR: {                                                                \
+      const ReductionType REDUCE = VAR;                                        \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    case STD: {                                                                \
+      const ReductionType REDUCE = STD;                                        \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    case LOGSUMEXP: {                                                          \
+      const ReductionType REDUCE = LOGSUMEXP;                                  \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    default:                                                                   \
+      AT_ERROR("Invalid reduction type");                                      \
     }                                                                          \
   }()
 
@@ -68,8 +100,9 @@ template <typename scalar_t, ReductionType REDUCE> struct Reducer {
     }
   }
 
+  template <typename arg_t>
   static inline __host__ __device__ void update(scalar_t *val, scalar_t new_val,
-                                                int64_t *arg, int64_t new_arg) {
+                                                arg_t *arg, int64_t new_arg) {
     if (REDUCE == SUM || REDUCE == MEAN)
       *val = *val + new_val;
     else if (REDUCE == MUL)
@@ -79,23 +112,25 @@ template <typename scalar_t, ReductionType REDUCE> struct Reducer {
     else if ((REDUCE == MIN && new_val < *val) ||
              (REDUCE == MAX && new_val > *val)) {
       *val = new_val;
-      *arg = new_arg;
+      *arg = (arg_t)new_arg;
     }
   }
 
-  static inline __host__ __device__ void write(scalar_t *address, scalar_t val,
-                                               int64_t *arg_address,
-                                               int64_t arg, int count) {
+  template <typename out_t, typename arg_t>
+  static inline __host__ __device__ void write(out_t *address, scalar_t val,
+                                               arg_t *arg_address, int64_t arg,
+                                               int count) {
     if (REDUCE == SUM || REDUCE == MUL || REDUCE == DIV)
-      *address = val;
+      *address = (out_t)val;
     else if (REDUCE == MEAN)
-      *address = val / (scalar_t)(count > 0 ? count : 1);
+      *address = (out_t)(val / (scalar_t)(count > 0 ? count : 1));
     else if (REDUCE == MIN || REDUCE == MAX) {
-      if (count > 0) {
-        *address = val;
-        *arg_address = arg;
-      } else
-        *address = (scalar_t)0;
+      // Empty segments receive the initial `arg` value, so that `arg_out` does
+      // not need to be pre-filled in a separate launch. Arguments are skipped
+      // in case the caller does not need them.
+      *address = count > 0 ? (out_t)val : (out_t)0;
+      if (arg_address != nullptr)
+        *arg_address = (arg_t)arg;
     }
   }
 
@@ -112,3 +147,442 @@ template <typename scalar_t, ReductionType REDUCE> struct Reducer {
       atomMax(address, val);
   }
 };
+
+// The type in which values are reduced in registers before being written back,
+// i.e., reduced precision floating point types get accumulated in `float`.
+template <typename scalar_t> struct AccType { using type = scalar_t; };
+template <> struct AccType<at::Half> {
+  using type = at::acc_type<at::Half, /*is_cuda=*/true>;
+};
+template <> struct AccType<at::BFloat16> {
+  using type = at::acc_type<at::BFloat16, /*is_cuda=*/true>;
+};
+
+// Returns `val` scaled by the weight of its entry `e` along the reduced
+// dimension, or `val` itself in case no weights are given.
+template <typename scalar_t>
+__host__ __device__ inline scalar_t
+weigh(scalar_t val, const scalar_t *weight_data, int64_t e) {
+  return weight_data == nullptr ? val : (scalar_t)(val * weight_data[e]);
+}
+
+// Whether `reduce` supports weighting each entry before reduction.
+inline bool supports_weight(const std::string &reduce) {
+  auto REDUCE = reduce2REDUCE.at(reduce);
+  return REDUCE == SUM || REDUCE == MEAN || REDUCE == MIN || REDUCE == MAX;
+}
+
+// Running state of Welford's algorithm, which computes the mean and the sum of
+// squared deviations `m2` of a sequence of values in a single, numerically
+// stable pass. Partial states can be merged via Chan's formula.
+template <typename scalar_t> struct Welford {
+  int64_t count = 0;
+  scalar_t mean = (scalar_t)0, m2 = (scalar_t)0;
+
+  __host__ __device__ inline void update(scalar_t val) {
+    count++;
+    scalar_t delta = val - mean;
+    mean += delta / (scalar_t)count;
+    m2 += delta * (val - mean);
+  }
+
+  __host__ __device__ inline void merge(int64_t other_count,
+                                        scalar_t other_mean,
+                                        scalar_t other_m2) {
+    if (other_count == 0)
+      return;
+    auto total = count + other_count;
+    scalar_t delta = other_mean - mean;
+    scalar_t weight = (scalar_t)other_count / (scalar_t)total;
+    mean += delta * weight;
+    m2 += other_m2 + delta * delta * (scalar_t)count * weight;
+    count = total;
+  }
+
+  __host__ __device__ inline scalar_t var(bool unbiased) const {
+    auto denom = count - (int64_t)unbiased;
+    return denom > 0 ? m2 / (scalar_t)denom : (scalar_t)0;
+  }
+};
+
+// Running state of an online log-sum-exp, which keeps the sum of exponentials
+// relative to the running maximum.
+template <typename scalar_t> struct LogSumExp {
+  scalar_t max = -std::numeric_limits<scalar_t>::infinity();
+  scalar_t sum = (scalar_t)0;
+
+  __host__ __device__ inline void update(scalar_t val) {
+    merge(val, (scalar_t)1);
+  }
+
+  __host__ __device__ inline void merge(scalar_t other_max,
+                                        scalar_t other_sum) {
+    if (other_sum == (scalar_t)0 ||
+        other_max == -std::numeric_limits<scalar_t>::infinity())
+      return;
+    if (other_max > max) {
+      sum = sum * exp(max - other_max) + other_sum;
+      max = other_max;
+    } else
+      sum += other_sum * exp(other_max - max);
+  }
+
+  __host__ __device__ inline scalar_t value() const {
+    return sum > (scalar_t)0 ? max + log(sum)
+                             : -std::numeric_limits<scalar_t>::infinity();
+  }
+};
+
+// Maximum number of reductions `segment_csr_multi` computes in a single pass.
+#define MAX_MULTI_REDUCES 8
+
+// The reductions of `segment_csr_multi` in output order. This is passed to
+// kernels by value.
+struct MultiReduce {
+  int num = 0;
+  ReductionType reduces[MAX_MULTI_REDUCES];
+
+  inline bool has(ReductionType reduce) const {
+    for (int r = 0; r < num; r++)
+      if (reduces[r] == reduce)
+        return true;
+    return false;
+  }
+};
+
+inline MultiReduce getMultiReduce(const std::vector<std::string> &reduces) {
+  AT_ASSERTM(reduces.size() > 0 && reduces.size() <= MAX_MULTI_REDUCES,
+             "Expected between 1 and ", MAX_MULTI_REDUCES, " reductions");
+  MultiReduce multi;
+  for (const auto &reduce : reduces) {
+    ReductionType REDUCE;
+    if (reduce2REDUCE.count(reduce) > 0)
+      REDUCE = reduce2REDUCE.at(reduce);
+    else if (stat2REDUCE.count(reduce) > 0)
+      REDUCE = stat2REDUCE.at(reduce);
+    else
+      AT_ERROR("Invalid reduction type");
+    AT_ASSERTM(REDUCE != MUL && REDUCE != DIV && REDUCE != LOGSUMEXP,
+               "Reduction type \"", reduce, "\" is not supported");
+    multi.reduces[multi.num++] = REDUCE;
+  }
+  return multi;
+}
+
+// Running state of all reductions supported by `MultiReduce`, such that any
+// subset of them can be computed from a single pass over the values.
+template <typename scalar_t> struct MultiReducer {
+  scalar_t sum = (scalar_t)0;
+  scalar_t min = std::numeric_limits<scalar_t>::max();
+  scalar_t max = std::numeric_limits<scalar_t>::lowest();
+  int64_t arg_min, arg_max;
+  Welford<scalar_t> welford;
+
+  __host__ __device__ MultiReducer(int64_t arg_init)
+      : arg_min(arg_init), arg_max(arg_init) {}
+
+  __host__ __device__ inline void update(scalar_t val, int64_t arg) {
+    sum += val;
+    if (val < min) {
+      min = val;
+      arg_min = arg;
+    }
+    if (val > max) {
+      max = val;
+      arg_max = arg;
+    }
+    welford.update(val);
+  }
+
+  // Ties are resolved towards the smaller argument, i.e., the first
+  // occurrence of the minimum or maximum.
+  __host__ __device__ inline void
+  merge(scalar_t other_sum, scalar_t other_min, int64_t other_arg_min,
+        scalar_t other_max, int64_t other_arg_max, int64_t other_count,
+        scalar_t other_mean, scalar_t other_m2) {
+    sum += other_sum;
+    if (other_min < min || (other_min == min && other_arg_min < arg_min)) {
+      min = other_min;
+      arg_min = other_arg_min;
+    }
+    if (other_max > max || (other_max == max && other_arg_max < arg_max)) {
+      max = other_max;
+      arg_max = other_arg_max;
+    }
+    welford.merge(other_count, other_mean, other_m2);
+  }
+
+  __host__ __device__ inline scalar_t value(ReductionType reduce,
+                                            bool unbiased) const {
+    auto count = welford.count;
+    switch (reduce) {
+    case SUM:
+      return sum;
+    case MEAN:
+      return sum / (scalar_t)(count > 0 ? count : 1);
+    case MIN:
+      return count > 0 ? min : (scalar_t)0;
+    case MAX:
+      return count > 0 ? max : (scalar_t)0;
+    case VAR:
+      return welford.var(unbiased);
+    default:
+      return ::sqrt(welford.var(unbiased));
+    }
+  }
+};
+
+// Division which rounds integers towards negative infinity, matching
+// `div_(..., "floor")`.
+template <typename scalar_t,
+          bool IS_INTEGRAL = std::is_integral<scalar_t>::value>
+struct FloorDiv {
+  static inline __device__ scalar_t apply(scalar_t a, scalar_t b) {
+    return a / b;
+  }
+};
+
+template <typename scalar_t> struct FloorDiv<scalar_t, true> {
+  static inline __device__ scalar_t apply(scalar_t a, scalar_t b) {
+    scalar_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? (scalar_t)(q - 1) : q;
+  }
+};
+
+// Fills `out` with the initial value of the reduction and `arg_out` with
+// `arg_init` in a single launch. Either fill is skipped for zero `numel`.
+template <typename scalar_t, ReductionType REDUCE, typename arg_t>
+__global__ void reducer_init_kernel(scalar_t *out_data, int64_t out_numel,
+                                    arg_t *arg_out_data, arg_t arg_init,
+                                    int64_t arg_numel) {
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  if (thread_idx < out_numel)
+    out_data[thread_idx] = Reducer<scalar_t, REDUCE>::init();
+  if (thread_idx < arg_numel)
+    arg_out_data[thread_idx] = arg_init;
+}
+
+// Resets entries of `out` which did not receive any value to zero (for
+// MIN/MAX), or divides them by their clamped number of values `count` (for
+// MEAN), where each `count` entry is shared across `K` consecutive entries.
+template <typename scalar_t, ReductionType REDUCE>
+__global__ void reducer_finalize_kernel(scalar_t *out_data,
+                                        scalar_t *count_data, int64_t K,
+                                        int64_t numel) {
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  if (thread_idx < numel) {
+    if (REDUCE == MIN || REDUCE == MAX) {
+      if (out_data[thread_idx] == Reducer<scalar_t, REDUCE>::init())
+        out_data[thread_idx] = (scalar_t)0;
+    } else if (REDUCE == MEAN) {
+      scalar_t count = count_data[thread_idx / K];
+      count = count < (scalar_t)1 ? (scalar_t)1 : count;
+      out_data[thread_idx] = FloorDiv<scalar_t>::apply(out_data[thread_idx],
+                                                       count);
+      if (thread_idx % K == 0)
+        count_data[thread_idx / K] = count;
+    }
+  }
+}
+
+// Floating-point SUM, MEAN and MUL depend on the order in which atomic
+// operations get applied. In case deterministic algorithms are requested via
+// `torch.use_deterministic_algorithms(True)`, we reduce over sorted indices
+// via `sorted_reduce_kernel` instead.
+template <typename scalar_t, ReductionType REDUCE>
+inline bool use_sorted_reduce() {
+  return (REDUCE == SUM || REDUCE == MEAN || REDUCE == MUL) &&
+         at::isFloatingType(c10::CppTypeToScalarType<scalar_t>::value) &&
+         at::globalContext().deterministicAlgorithms();
+}
+
+// Computes each output `(b, n, k)` with a single thread by reducing all
+// entries of `src` (of shape `[B, E, K]`) whose index equals `n`, where
+// `index` (of shape `[B, E, CK]`) is sorted along `E` and `CK` equals `1` or
+// `K`. Entries are visited in sorted order and mapped back to `src` via
+// `perm_data`, or taken as is in case `perm_data` is `nullptr`. Entries are
+// optionally scaled by `weight_data` (of shape `[E]`). Both `out` and `count`
+// (for MEAN) are fully written, so that no initialization is needed.
+template <typename scalar_t, ReductionType REDUCE, typename index_t>
+__global__ void
+sorted_reduce_kernel(const scalar_t *src_data, const index_t *index_data,
+                     const int64_t *perm_data, const scalar_t *weight_data,
+                     scalar_t *out_data, scalar_t *count_data, bool has_out,
+                     int64_t E, int64_t K, int64_t CK, int64_t N,
+                     int64_t numel) {
+  using acc_t = typename AccType<scalar_t>::type;
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  int64_t b = thread_idx / (N * K);
+  int64_t n = (thread_idx / K) % N;
+  int64_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    const index_t *row = index_data + b * E * CK + k % CK;
+
+    int64_t lo = 0, hi = E, mid;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if ((int64_t)row[mid * CK] < n)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    int64_t start = lo;
+    hi = E;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if ((int64_t)row[mid * CK] <= n)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    int64_t end = lo;
+
+    acc_t val = has_out ? (acc_t)out_data[thread_idx]
+                        : Reducer<acc_t, REDUCE>::init();
+    for (int64_t e = start; e < end; e++) {
+      int64_t src_e = perm_data ? perm_data[b * E * CK + e * CK + k % CK] : e;
+      Reducer<acc_t, REDUCE>::update(
+          &val, (acc_t)weigh(src_data[(b * E + src_e) * K + k], weight_data,
+                             src_e));
+    }
+
+    if (REDUCE == MEAN) {
+      int64_t count = end - start > 1 ? end - start : 1;
+      val = val / (acc_t)count;
+      if (CK > 1 || k == 0)
+        count_data[(b * N + n) * CK + k % CK] = (scalar_t)count;
+    }
+    out_data[thread_idx] = (scalar_t)val;
+  }
+}
+
+// Maps floating-point values to unsigned integers of the same ordering.
+template <typename scalar_t> struct OrderedBits {
+  static const bool supported = false;
+  static inline __device__ uint32_t encode(scalar_t val) { return 0; }
+  static inline __device__ scalar_t decode(uint32_t bits) {
+    return (scalar_t)0;
+  }
+};
+
+template <> struct OrderedBits<float> {
+  static const bool supported = true;
+  static inline __device__ uint32_t encode(float val) {
+    uint32_t bits = __float_as_uint(val);
+    return bits ^ ((bits >> 31) ? 0xffffffff : 0x80000000);
+  }
+  static inline __device__ float decode(uint32_t bits) {
+    return __uint_as_float(bits ^ ((bits >> 31) ? 0x80000000 : 0xffffffff));
+  }
+};
+
+template <> struct OrderedBits<at::Half> {
+  static const bool supported = true;
+  static inline __device__ uint32_t encode(at::Half val) {
+    uint32_t bits = val.x;
+    return bits ^ ((bits >> 15) ? 0xffff : 0x8000);
+  }
+  static inline __device__ at::Half decode(uint32_t bits) {
+    bits ^= (bits >> 15) ? 0x8000 : 0xffff;
+    return at::Half((uint16_t)bits, at::Half::from_bits());
+  }
+};
+
+template <> struct OrderedBits<at::BFloat16> {
+  static const bool supported = true;
+  static inline __device__ uint32_t encode(at::BFloat16 val) {
+    uint32_t bits = val.x;
+    return bits ^ ((bits >> 15) ? 0xffff : 0x8000);
+  }
+  static inline __device__ at::BFloat16 decode(uint32_t bits) {
+    bits ^= (bits >> 15) ? 0x8000 : 0xffff;
+    return at::BFloat16((uint16_t)bits, at::BFloat16::from_bits());
+  }
+};
+
+// Packs a value and its argument into a single 64-bit key whose unsigned
+// ordering matches the reduction, such that `out` and `arg_out` can be
+// computed in a single pass via 64-bit atomics. Ties are broken in favor of
+// the smallest argument, which makes the result deterministic.
+template <typename scalar_t, ReductionType REDUCE> struct ArgKey {
+  static inline __device__ uint64_t init() {
+    return REDUCE == MIN ? ~(uint64_t)0 : (uint64_t)0;
+  }
+
+  static inline __device__ uint64_t pack(scalar_t val, int64_t arg) {
+    // Signed zeros compare equal, such that ties between them need to be
+    // broken by their arguments as well:
+    if (val == (scalar_t)0)
+      val = (scalar_t)0;
+    uint32_t bits = REDUCE == MIN ? (uint32_t)arg : ~(uint32_t)arg;
+    return ((uint64_t)OrderedBits<scalar_t>::encode(val) << 32) | bits;
+  }
+
+  static inline __device__ scalar_t value(uint64_t key) {
+    return OrderedBits<scalar_t>::decode((uint32_t)(key >> 32));
+  }
+
+  static inline __device__ int64_t arg(uint64_t key) {
+    return REDUCE == MIN ? (uint32_t)key : ~(uint32_t)key;
+  }
+
+  static inline __device__ void update(uint64_t *key, uint64_t new_key) {
+    if ((REDUCE == MIN && new_key < *key) || (REDUCE == MAX && new_key > *key))
+      *key = new_key;
+  }
+
+  static inline __device__ void atomic_write(uint64_t *address, uint64_t key) {
+    if (REDUCE == MIN)
+      atomicMin((unsigned long long *)address, (unsigned long long)key);
+    else
+      atomicMax((unsigned long long *)address, (unsigned long long)key);
+  }
+};
+
+// Whether MIN/MAX of `scalar_t` over `E` arguments can be computed via packed
+// keys. The argument `E` of empty entries needs to fit into 32 bits as well.
+template <typename scalar_t> inline bool use_arg_key(int64_t E) {
+  return OrderedBits<scalar_t>::supported &&
+         E < (int64_t)std::numeric_limits<uint32_t>::max();
+}
+
+// Initializes keys from `out` in case it is given by the user, such that its
+// values take part in the reduction under the argument `E`.
+template <typename scalar_t, ReductionType REDUCE>
+__global__ void arg_key_init_kernel(const scalar_t *out_data,
+                                    uint64_t *key_data, int64_t E,
+                                    int64_t numel) {
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  if (thread_idx < numel)
+    key_data[thread_idx] =
+        out_data != nullptr
+            ? ArgKey<scalar_t, REDUCE>::pack(out_data[thread_idx], E)
+            : ArgKey<scalar_t, REDUCE>::init();
+}
+
+// Unpacks keys into `out` and `arg_out`. Entries which did not receive any
+// value are set to zero with argument `E`.
+template <typename scalar_t, ReductionType REDUCE, typename arg_t>
+__global__ void arg_key_finalize_kernel(const uint64_t *key_data,
+                                        scalar_t *out_data,
+                                        arg_t *arg_out_data, int64_t E,
+                                        int64_t numel) {
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  if (thread_idx < numel) {
+    uint64_t key = key_data[thread_idx];
+    if (key == ArgKey<scalar_t, REDUCE>::init()) {
+      out_data[thread_idx] = (scalar_t)0;
+      arg_out_data[thread_idx] = (arg_t)E;
+    } else {
+      out_data[thread_idx] = ArgKey<scalar_t, REDUCE>::value(key);
+      arg_out_data[thread_idx] = (arg_t)ArgKey<scalar_t, REDUCE>::arg(key);
+    }
+  }
+}
@@ -3,67 +3,201 @@
 #include <ATen/cuda/CUDAContext.h>
 #include <ATen/cuda/detail/IndexUtils.cuh>
 #include <ATen/cuda/detail/TensorInfo.cuh>
+#include <c10/cuda/CUDAGuard.h>
 
+#include "../profiler.h"
+#include "../workspace.h"
+#include "host_sync.h"
+#include "index_info.cuh"
 #include "reducer.cuh"
 #include "utils.cuh"
 
 #define THREADS 1024
 #define BLOCKS(N) (N + THREADS - 1) / THREADS
 
-template <typename scalar_t, ReductionType REDUCE>
+// Outputs of up to this many bytes (in the accumulation type) get privatized
+// per block in shared memory, given that there are at least `SHARED_RATIO`
+// source entries per output entry and block.
+#define SHARED_BYTES 16384
+#define SHARED_RATIO 32
+
+template <typename scalar_t, ReductionType REDUCE, typename index_t,
+          typename offset_t>
 __global__ void
 scatter_kernel(const scalar_t *src_data,
-               const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-               scalar_t *out_data, int E, int K, int N, int numel) {
+               const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+               const scalar_t *weight_data, scalar_t *out_data,
+               scalar_t *count_data, offset_t E, offset_t K, offset_t CK,
+               offset_t N, offset_t numel) {
+
+  // For MEAN, we count the number of entries per output on the fly, either
+  // once per (b, idx) (`CK == 1`) or once per (b, idx, k) (`CK == K`).
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
 
-  int b = thread_idx / (E * K);
-  int k = thread_idx % K;
+  offset_t b = thread_idx / (E * K);
+  offset_t e = (thread_idx / K) % E;
+  offset_t k = thread_idx % K;
 
   if (thread_idx < numel) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        thread_idx, index_info);
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
     int64_t idx = index_info.data[offset];
 
-    Reducer<scalar_t, REDUCE>::atomic_write(out_data + b * N * K + idx * K + k,
-                                            src_data[thread_idx]);
+    Reducer<scalar_t, REDUCE>::atomic_write(
+        out_data + b * N * K + idx * K + k,
+        weigh(src_data[thread_idx], weight_data, e));
+    if (REDUCE == MEAN && (CK > 1 || k == 0))
+      Reducer<scalar_t, SUM>::atomic_write(
+          count_data + (b * N + idx) * CK + k % CK, (scalar_t)1);
   }
 }
 
-template <typename scalar_t>
-__global__ void
-scatter_arg_kernel(const scalar_t *src_data,
-                   const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-                   const scalar_t *out_data, int64_t *arg_out_data, int E,
-                   int K, int N, int numel) {
+template <typename scalar_t, ReductionType REDUCE, typename index_t,
+          typename offset_t>
+__global__ void scatter_shared_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    const scalar_t *weight_data, scalar_t *out_data, scalar_t *count_data,
+    offset_t E, offset_t K, offset_t CK, offset_t N, offset_t numel,
+    offset_t out_numel, offset_t count_numel) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each block reduces a grid-strided part of `src` into a private copy of
+  // `out` (and `count`) in shared memory, such that heavily contended atomic
+  // operations on few global addresses (and CAS loops for reduced precision
+  // types) turn into cheap shared memory atomics. The partial results are
+  // flushed to global memory once per block.
+
+  extern __shared__ __align__(sizeof(double)) unsigned char shared_data[];
+  auto out_shared = reinterpret_cast<acc_t *>(shared_data);
+  auto count_shared = out_shared + out_numel;
+
+  for (offset_t i = threadIdx.x; i < out_numel; i += blockDim.x)
+    out_shared[i] = Reducer<acc_t, REDUCE>::init();
+  for (offset_t i = threadIdx.x; i < count_numel; i += blockDim.x)
+    count_shared[i] = (acc_t)0;
+  __syncthreads();
+
+  for (offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+       thread_idx < numel; thread_idx += (offset_t)gridDim.x * blockDim.x) {
+    offset_t b = thread_idx / (E * K);
+    offset_t e = (thread_idx / K) % E;
+    offset_t k = thread_idx % K;
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    Reducer<acc_t, REDUCE>::atomic_write(
+        out_shared + b * N * K + idx * K + k,
+        (acc_t)weigh(src_data[thread_idx], weight_data, e));
+    if (REDUCE == MEAN && (CK > 1 || k == 0))
+      Reducer<acc_t, SUM>::atomic_write(
+          count_shared + (b * N + idx) * CK + k % CK, (acc_t)1);
+  }
+  __syncthreads();
 
-  int b = thread_idx / (E * K);
-  int e = (thread_idx / K) % E;
-  int k = thread_idx % K;
+  for (offset_t i = threadIdx.x; i < out_numel; i += blockDim.x) {
+    acc_t val = out_shared[i];
+    if (val != Reducer<acc_t, REDUCE>::init())
+      Reducer<scalar_t, REDUCE>::atomic_write(out_data + i, (scalar_t)val);
+  }
+  for (offset_t i = threadIdx.x; i < count_numel; i += blockDim.x) {
+    acc_t val = count_shared[i];
+    if (val != (acc_t)0)
+      Reducer<scalar_t, SUM>::atomic_write(count_data + i, (scalar_t)val);
+  }
+}
+
+// Returns the number of blocks of `scatter_shared_kernel` in case `out` (and
+// `count`) can be privatized in shared memory, and zero otherwise.
+template <typename scalar_t, ReductionType REDUCE>
+int64_t scatter_shared_blocks(int64_t numel, int64_t out_numel,
+                              int64_t count_numel) {
+  using acc_t = typename AccType<scalar_t>::type;
+  if (REDUCE == DIV || out_numel == 0)
+    return 0;
+  if ((out_numel + count_numel) * (int64_t)sizeof(acc_t) > SHARED_BYTES)
+    return 0;
+  auto blocks = numel / (SHARED_RATIO * out_numel);
+  auto max_blocks =
+      2 * at::cuda::getCurrentDeviceProperties()->multiProcessorCount;
+  return std::min<int64_t>(blocks, max_blocks);
+}
+
+template <typename scalar_t, typename index_t, typename offset_t>
+__global__ void scatter_arg_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    const scalar_t *weight_data, const scalar_t *out_data,
+    index_t *arg_out_data, offset_t E, offset_t K, offset_t N,
+    offset_t numel) {
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t e = (thread_idx / K) % E;
+  offset_t k = thread_idx % K;
 
   if (thread_idx < numel) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        thread_idx, index_info);
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
     int64_t idx = index_info.data[offset];
 
-    if (src_data[thread_idx] == out_data[b * N * K + idx * K + k]) {
-      arg_out_data[b * N * K + idx * K + k] = e;
+    if (weigh(src_data[thread_idx], weight_data, e) ==
+        out_data[b * N * K + idx * K + k]) {
+      arg_out_data[b * N * K + idx * K + k] = (index_t)e;
     }
   }
 }
 
+template <typename scalar_t, ReductionType REDUCE, typename index_t,
+          typename offset_t>
+__global__ void scatter_arg_key_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    const scalar_t *weight_data, uint64_t *key_data, offset_t E, offset_t K,
+    offset_t N, offset_t numel) {
+
+  // Reduces values and their arguments at once via packed 64-bit keys.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t e = (thread_idx / K) % E;
+  offset_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    ArgKey<scalar_t, REDUCE>::atomic_write(
+        key_data + b * N * K + idx * K + k,
+        ArgKey<scalar_t, REDUCE>::pack(
+            weigh(src_data[thread_idx], weight_data, e), e));
+  }
+}
+
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 scatter_cuda(torch::Tensor src, torch::Tensor index, int64_t dim,
              torch::optional<torch::Tensor> optional_out,
-             torch::optional<int64_t> dim_size, std::string reduce) {
+             torch::optional<int64_t> dim_size, std::string reduce,
+             torch::optional<torch::Tensor> optional_weight) {
   CHECK_CUDA(src);
   CHECK_CUDA(index);
   if (optional_out.has_value())
     CHECK_CUDA(optional_out.value());
-  cudaSetDevice(src.get_device());
+  if (optional_weight.has_value())
+    CHECK_CUDA(optional_weight.value());
+  const c10::cuda::CUDAGuard device_guard(src.device());
+  WorkspaceScope workspace_scope(SCATTER_WORKSPACE);
 
   CHECK_INPUT(src.dim() == index.dim());
   for (auto i = 0; i < index.dim() - 1; i++)
@@ -71,6 +205,15 @@ scatter_cuda(torch::Tensor src, torch::Tensor index, int64_t dim,
 
   src = src.contiguous();
 
+  torch::Tensor weight;
+  if (optional_weight.has_value()) {
+    AT_ASSERTM(supports_weight(reduce), "Reduction type \"", reduce,
+               "\" does not support weights");
+    weight = optional_weight.value().contiguous();
+    CHECK_INPUT(weight.dim() == 1 && weight.numel() == src.size(dim));
+    CHECK_INPUT(weight.scalar_type() == src.scalar_type());
+  }
+
   torch::Tensor out;
   if (optional_out.has_value()) {
     out = optional_out.value().contiguous();
@@ -84,55 +227,447 @@ scatter_cuda(torch::Tensor src, torch::Tensor index, int64_t dim,
     else if (index.numel() == 0)
       sizes[dim] = 0;
     else {
-      sizes[dim] = 1 + index.max().cpu().data_ptr<int64_t>()[0];
+      auto size = sync_item(index, SCATTER_SIZE, [&] { return index.max(); });
+      AT_ASSERTM(size.has_value(), "Inferring the output size of scatter ",
+                 "requires a host-device sync. Please pass `dim_size` ",
+                 "explicitly instead.");
+      sizes[dim] = 1 + size.value();
     }
     out = torch::empty(sizes, src.options());
   }
 
+  int64_t B = 1;
+  for (auto i = 0; i < dim; i++)
+    B *= src.size(i);
+  auto E = src.size(dim);
+  auto K = src.numel() / std::max<int64_t>(B * E, 1);
+  auto N = out.size(dim);
+
+  // For MEAN, `arg_out` holds the number of entries scattered to each output.
+  // In case `index` is broadcasted along all trailing dimensions, a single
+  // count per (b, idx) suffices (`CK == 1`) instead of one count per
+  // (b, idx, k) (`CK == K`).
+  int64_t CK = K;
   torch::optional<torch::Tensor> arg_out = torch::nullopt;
-  int64_t *arg_out_data = nullptr;
-  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX) {
-    arg_out = torch::full_like(out, src.size(dim), index.options());
-    arg_out_data = arg_out.value().data_ptr<int64_t>();
+  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
+    arg_out = torch::empty(out.sizes(), index.options());
+  else if (reduce2REDUCE.at(reduce) == MEAN) {
+    auto sizes = out.sizes().vec();
+    if (index_is_broadcasted(index, dim)) {
+      CK = 1;
+      for (auto i = dim + 1; i < out.dim(); i++)
+        sizes[i] = 1;
+    }
+    arg_out = torch::empty(sizes, src.options());
   }
 
   if (src.numel() == 0) {
     if (!optional_out.has_value())
       out.fill_(0);
+    if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
+      arg_out.value().fill_(src.size(dim));
+    else if (reduce2REDUCE.at(reduce) == MEAN)
+      arg_out.value().fill_(1);
     return std::make_tuple(out, arg_out);
   }
 
-  auto B = 1;
+  auto use_64bit = use_64bit_offsets({src, index, out});
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *weight_data = nullptr;
+    if (optional_weight.has_value())
+      weight_data = weight.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        index_t *arg_out_data = nullptr;
+        scalar_t *count_data = nullptr;
+        if (REDUCE == MIN || REDUCE == MAX)
+          arg_out_data = arg_out.value().data_ptr<index_t>();
+        if (REDUCE == MEAN)
+          count_data = arg_out.value().data_ptr<scalar_t>();
+
+        if ((REDUCE == MIN || REDUCE == MAX) && use_arg_key<scalar_t>(E)) {
+          // Computes `out` and `arg_out` within a single pass over `src`.
+          RECORD_KERNEL("scatter_cuda", E, K, N, "arg_key");
+          auto key =
+              workspace_empty(out.sizes(), out.options().dtype(at::kLong));
+          auto key_data = (uint64_t *)key.data_ptr<int64_t>();
+
+          arg_key_init_kernel<scalar_t, REDUCE>
+              <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                  optional_out.has_value() ? out_data : nullptr, key_data, E,
+                  out.numel());
+
+          AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+            auto index_info =
+                at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
+            scatter_arg_key_kernel<scalar_t, REDUCE, index_t, offset_t>
+                <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
+                    src_data, index_info, weight_data, key_data, E, K, N,
+                    src.numel());
+          });
+
+          arg_key_finalize_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                  key_data, out_data, arg_out_data, E, out.numel());
+          return;
+        }
+
+        if (use_sorted_reduce<scalar_t, REDUCE>() &&
+            index.sizes() == src.sizes()) {
+          // Stably sorts `index` along `dim`, such that each output reduces
+          // its entries in the order in which they appear in `src`.
+          RECORD_KERNEL("scatter_cuda", E, K, N, "sorted");
+          auto SK = index_is_broadcasted(index, dim) ? 1 : K;
+          auto tmp = index;
+          if (SK == 1)
+            for (auto i = dim + 1; i < index.dim(); i++)
+              tmp = tmp.narrow(i, 0, 1);
+          auto sort = tmp.reshape({B, E, SK}).sort(/*stable=*/true, 1, false);
+          auto sorted_index = std::get<0>(sort).contiguous();
+          auto perm = std::get<1>(sort).contiguous();
+
+          sorted_reduce_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                  src_data, sorted_index.data_ptr<index_t>(),
+                  perm.data_ptr<int64_t>(), weight_data, out_data, count_data,
+                  optional_out.has_value(), E, K, SK, N, out.numel());
+          return;
+        }
+        if (use_sorted_reduce<scalar_t, REDUCE>())
+          at::globalContext().alertNotDeterministic("scatter_cuda");
+
+        // Initializes `out` and `arg_out` (or `count`) within a single launch.
+        auto out_numel = optional_out.has_value() ? 0 : out.numel();
+        auto arg_numel = arg_out.has_value() ? arg_out.value().numel() : 0;
+        auto count_numel = REDUCE == MEAN ? arg_numel : 0;
+        auto blocks = scatter_shared_blocks<scalar_t, REDUCE>(
+            src.numel(), out.numel(), count_numel);
+        RECORD_KERNEL("scatter_cuda", E, K, N, blocks > 0 ? "shared" : "atomic",
+                      use_64bit ? ",64bit" : "");
+        if (out_numel > 0 || arg_numel > 0) {
+          if (REDUCE == MEAN)
+            reducer_init_kernel<scalar_t, REDUCE, scalar_t>
+                <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                    out_data, out_numel, count_data, (scalar_t)0, arg_numel);
+          else
+            reducer_init_kernel<scalar_t, REDUCE, index_t>
+                <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                    out_data, out_numel, arg_out_data, (index_t)E, arg_numel);
+        }
+
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto index_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
+
+          if (blocks > 0) {
+            auto shared = (out.numel() + count_numel) *
+                          sizeof(typename AccType<scalar_t>::type);
+            scatter_shared_kernel<scalar_t, REDUCE, index_t, offset_t>
+                <<<blocks, THREADS, shared, stream>>>(
+                    src_data, index_info, weight_data, out_data, count_data, E,
+                    K, CK, N, src.numel(), out.numel(), count_numel);
+          } else
+            scatter_kernel<scalar_t, REDUCE, index_t, offset_t>
+                <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
+                    src_data, index_info, weight_data, out_data, count_data, E,
+                    K, CK, N, src.numel());
+
+          // Resets empty entries for MIN/MAX and divides by `count` for MEAN.
+          if ((!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX)) ||
+              REDUCE == MEAN)
+            reducer_finalize_kernel<scalar_t, REDUCE>
+                <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                    out_data, count_data, K / CK, out.numel());
+
+          if (REDUCE == MIN || REDUCE == MAX)
+            scatter_arg_kernel<scalar_t, index_t, offset_t>
+                <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
+                    src_data, index_info, weight_data, out_data, arg_out_data,
+                    E, K, N, src.numel());
+        });
+      });
+    });
+  });
+
+  return std::make_tuple(out, arg_out);
+}
+
+template <typename scalar_t, typename index_t, typename offset_t>
+__global__ void scatter_softmax_max_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    typename AccType<scalar_t>::type *max_data, offset_t E, offset_t K,
+    offset_t N, offset_t numel) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    Reducer<acc_t, MAX>::atomic_write(max_data + b * N * K + idx * K + k,
+                                      (acc_t)src_data[thread_idx]);
+  }
+}
+
+template <typename scalar_t, typename index_t, typename offset_t>
+__global__ void scatter_softmax_sum_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    const typename AccType<scalar_t>::type *max_data,
+    typename AccType<scalar_t>::type *sum_data, offset_t E, offset_t K,
+    offset_t N, offset_t numel) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    offset = b * N * K + idx * K + k;
+    acc_t val = (acc_t)src_data[thread_idx] - max_data[offset];
+    Reducer<acc_t, SUM>::atomic_write(sum_data + offset, ::exp(val));
+  }
+}
+
+template <typename scalar_t, bool LOG, typename index_t, typename offset_t>
+__global__ void scatter_softmax_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    const typename AccType<scalar_t>::type *max_data,
+    const typename AccType<scalar_t>::type *sum_data, scalar_t *out_data,
+    offset_t E, offset_t K, offset_t N, offset_t numel) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    offset = b * N * K + idx * K + k;
+    acc_t val = (acc_t)src_data[thread_idx] - max_data[offset];
+    out_data[thread_idx] = (scalar_t)(LOG ? val - ::log(sum_data[offset])
+                                          : ::exp(val) / sum_data[offset]);
+  }
+}
+
+torch::Tensor scatter_softmax_cuda(torch::Tensor src, torch::Tensor index,
+                                   int64_t dim, int64_t dim_size, bool log) {
+  CHECK_CUDA(src);
+  CHECK_CUDA(index);
+  const c10::cuda::CUDAGuard device_guard(src.device());
+  WorkspaceScope workspace_scope(SCATTER_WORKSPACE);
+
+  CHECK_INPUT(src.sizes() == index.sizes());
+
+  src = src.contiguous();
+  auto out = torch::empty_like(src);
+  if (src.numel() == 0)
+    return out;
+
+  if (at::globalContext().deterministicAlgorithms())
+    at::globalContext().alertNotDeterministic("scatter_softmax_cuda");
+
+  int64_t B = 1;
   for (auto i = 0; i < dim; i++)
     B *= src.size(i);
   auto E = src.size(dim);
   auto K = src.numel() / (B * E);
-  auto N = out.size(dim);
+  auto N = dim_size;
 
-  auto index_info = at::cuda::detail::getTensorInfo<int64_t, int>(index);
+  auto use_64bit = use_64bit_offsets({src, index}) ||
+                   B * N * K > std::numeric_limits<int>::max();
   auto stream = at::cuda::getCurrentCUDAStream();
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
+    using acc_t = typename AccType<scalar_t>::type;
+
+    // Holds the maximum and the sum of exponentials of each output, such that
+    // `src` gets read three times while `out` only gets written once.
+    auto acc_options =
+        src.options().dtype(c10::CppTypeToScalarType<acc_t>::value);
+    auto max = workspace_empty({B, N, K}, acc_options)
+                   .fill_(-std::numeric_limits<double>::infinity());
+    auto sum = workspace_empty({B, N, K}, acc_options).zero_();
+    auto max_data = max.data_ptr<acc_t>();
+    auto sum_data = sum.data_ptr<acc_t>();
+
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      AT_DISPATCH_SOFTMAX_LOG(log, [&] {
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto index_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
 
-    AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
-      if (!optional_out.has_value())
-        out.fill_(Reducer<scalar_t, REDUCE>::init());
+          scatter_softmax_max_kernel<scalar_t, index_t, offset_t>
+              <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
+                  src_data, index_info, max_data, E, K, N, src.numel());
+          scatter_softmax_sum_kernel<scalar_t, index_t, offset_t>
+              <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
+                  src_data, index_info, max_data, sum_data, E, K, N,
+                  src.numel());
+          scatter_softmax_kernel<scalar_t, LOG, index_t, offset_t>
+              <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
+                  src_data, index_info, max_data, sum_data, out_data, E, K, N,
+                  src.numel());
+        });
+      });
+    });
+  });
+
+  return out;
+}
 
-      scatter_kernel<scalar_t, REDUCE>
-          <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
-              src_data, index_info, out_data, E, K, N, src.numel());
+template <typename scalar_t, bool LOG, typename index_t, typename offset_t>
+__global__ void scatter_softmax_backward_dot_kernel(
+    const scalar_t *out_data, const scalar_t *grad_out_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    typename AccType<scalar_t>::type *dot_data, offset_t E, offset_t K,
+    offset_t N, offset_t numel) {
 
-      if (!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX))
-        out.masked_fill_(out == Reducer<scalar_t, REDUCE>::init(), (scalar_t)0);
+  using acc_t = typename AccType<scalar_t>::type;
 
-      if (REDUCE == MIN || REDUCE == MAX)
-        scatter_arg_kernel<scalar_t>
-            <<<BLOCKS(src.numel()), THREADS, 0, stream>>>(
-                src_data, index_info, out_data, arg_out_data, E, K, N,
-                src.numel());
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    acc_t grad = (acc_t)grad_out_data[thread_idx];
+    Reducer<acc_t, SUM>::atomic_write(
+        dot_data + b * N * K + idx * K + k,
+        LOG ? grad : grad * (acc_t)out_data[thread_idx]);
+  }
+}
+
+template <typename scalar_t, bool LOG, typename index_t, typename offset_t>
+__global__ void scatter_softmax_backward_kernel(
+    const scalar_t *out_data, const scalar_t *grad_out_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    const typename AccType<scalar_t>::type *dot_data, scalar_t *grad_in_data,
+    offset_t E, offset_t K, offset_t N, offset_t numel) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // The gradient of softmax `y` is given by `y * (grad - sum(grad * y))`, and
+  // the one of log-softmax `y` by `grad - exp(y) * sum(grad)`.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  offset_t b = thread_idx / (E * K);
+  offset_t k = thread_idx % K;
+
+  if (thread_idx < numel) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            thread_idx, index_info);
+    int64_t idx = index_info.data[offset];
+
+    acc_t dot = dot_data[b * N * K + idx * K + k];
+    acc_t y = (acc_t)out_data[thread_idx];
+    acc_t grad = (acc_t)grad_out_data[thread_idx];
+    grad_in_data[thread_idx] =
+        (scalar_t)(LOG ? grad - ::exp(y) * dot : y * (grad - dot));
+  }
+}
+
+torch::Tensor scatter_softmax_backward_cuda(torch::Tensor out,
+                                            torch::Tensor grad_out,
+                                            torch::Tensor index, int64_t dim,
+                                            int64_t dim_size, bool log) {
+  CHECK_CUDA(out);
+  CHECK_CUDA(grad_out);
+  CHECK_CUDA(index);
+  const c10::cuda::CUDAGuard device_guard(out.device());
+  WorkspaceScope workspace_scope(SCATTER_WORKSPACE);
+
+  CHECK_INPUT(out.sizes() == index.sizes());
+  CHECK_INPUT(out.sizes() == grad_out.sizes());
+
+  out = out.contiguous();
+  grad_out = grad_out.contiguous();
+  auto grad_in = torch::empty_like(out);
+  if (out.numel() == 0)
+    return grad_in;
+
+  if (at::globalContext().deterministicAlgorithms())
+    at::globalContext().alertNotDeterministic("scatter_softmax_backward_cuda");
+
+  int64_t B = 1;
+  for (auto i = 0; i < dim; i++)
+    B *= out.size(i);
+  auto E = out.size(dim);
+  auto K = out.numel() / (B * E);
+  auto N = dim_size;
+
+  auto use_64bit = use_64bit_offsets({out, index}) ||
+                   B * N * K > std::numeric_limits<int>::max();
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(out.scalar_type(), "_", [&] {
+    auto out_data = out.data_ptr<scalar_t>();
+    auto grad_out_data = grad_out.data_ptr<scalar_t>();
+    auto grad_in_data = grad_in.data_ptr<scalar_t>();
+    using acc_t = typename AccType<scalar_t>::type;
+
+    auto acc_options =
+        out.options().dtype(c10::CppTypeToScalarType<acc_t>::value);
+    auto dot = workspace_empty({B, N, K}, acc_options).zero_();
+    auto dot_data = dot.data_ptr<acc_t>();
+
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      AT_DISPATCH_SOFTMAX_LOG(log, [&] {
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto index_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
+
+          scatter_softmax_backward_dot_kernel<scalar_t, LOG, index_t, offset_t>
+              <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                  out_data, grad_out_data, index_info, dot_data, E, K, N,
+                  out.numel());
+          scatter_softmax_backward_kernel<scalar_t, LOG, index_t, offset_t>
+              <<<BLOCKS(out.numel()), THREADS, 0, stream>>>(
+                  out_data, grad_out_data, index_info, dot_data, grad_in_data,
+                  E, K, N, out.numel());
+        });
+      });
     });
   });
 
-  return std::make_tuple(out, arg_out);
+  return grad_in;
+}
+
+torch::Tensor scatter_arg_backward_cuda(torch::Tensor grad_out,
+                                        torch::Tensor arg_out, int64_t dim,
+                                        std::vector<int64_t> src_sizes) {
+  return arg_backward_cuda(grad_out, arg_out, dim, src_sizes, THREADS);
 }
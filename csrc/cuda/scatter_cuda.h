@@ -5,4 +5,17 @@
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 scatter_cuda(torch::Tensor src, torch::Tensor index, int64_t dim,
              torch::optional<torch::Tensor> optional_out,
-             torch::optional<int64_t> dim_size, std::string reduce);
+             torch::optional<int64_t> dim_size, std::string reduce,
+             torch::optional<torch::Tensor> optional_weight = torch::nullopt);
+
+torch::Tensor scatter_softmax_cuda(torch::Tensor src, torch::Tensor index,
+                                   int64_t dim, int64_t dim_size, bool log);
+
+torch::Tensor scatter_softmax_backward_cuda(torch::Tensor out,
+                                            torch::Tensor grad_out,
+                                            torch::Tensor index, int64_t dim,
+                                            int64_t dim_size, bool log);
+
+torch::Tensor scatter_arg_backward_cuda(torch::Tensor grad_out,
+                                        torch::Tensor arg_out, int64_t dim,
+                                        std::vector<int64_t> src_sizes);
@@ -3,7 +3,13 @@
 #include <ATen/cuda/CUDAContext.h>
 #include <ATen/cuda/detail/IndexUtils.cuh>
 #include <ATen/cuda/detail/TensorInfo.cuh>
+#include <c10/cuda/CUDAGuard.h>
 
+#include "../profiler.h"
+#include "../workspace.h"
+#include "autotune.h"
+#include "host_sync.h"
+#include "index_info.cuh"
 #include "reducer.cuh"
 #include "utils.cuh"
 
@@ -11,95 +17,124 @@
 #define BLOCKS(TB, N) (TB * N + THREADS - 1) / THREADS
 #define FULL_MASK 0xffffffff
 
-template <typename scalar_t, ReductionType REDUCE, bool HAS_VAL>
-__global__ void
-segment_coo_kernel(const scalar_t *src_data,
-                   const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-                   scalar_t *out_data, size_t E, size_t N) {
+template <typename scalar_t, ReductionType REDUCE, typename index_t,
+          typename offset_t>
+__global__ void segment_coo_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    scalar_t *out_data, scalar_t *count_data, offset_t E, offset_t N) {
 
   // Each thread processes exactly one entry. Within a warp, we perform a
   // parallel reduction across equal indices, and write the intermediate
-  // result via atomics.
+  // result via atomics. For MEAN, the number of entries per index is reduced
+  // alongside, so that no separate counting pass is required.
+
+  using acc_t = typename AccType<scalar_t>::type;
 
-  int row_idx = blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
   int lane_idx = row_idx & (32 - 1);
-  int D = index_info.sizes[index_info.dims - 1];
+  offset_t D = index_info.sizes[index_info.dims - 1];
 
   if (row_idx < E) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        row_idx, index_info);
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            row_idx, index_info);
     int64_t idx = index_info.data[offset], next_idx;
-    int out_idx = (row_idx / D) * N + idx;
+    offset_t out_idx = (row_idx / D) * N + idx;
 
-    scalar_t val = HAS_VAL ? src_data[row_idx] : (scalar_t)1, tmp;
+    acc_t val = src_data[row_idx], tmp;
+    int count = 1, count_tmp;
 
 #pragma unroll
     for (int i = 1; i < 32; i *= 2) {
       // Parallel reduction inside a single warp.
       tmp = __shfl_up_sync(FULL_MASK, val, i);
       next_idx = __shfl_up_sync(FULL_MASK, idx, i);
+      if (REDUCE == MEAN)
+        count_tmp = __shfl_up_sync(FULL_MASK, count, i);
       if (lane_idx >= i && row_idx / D == (row_idx - i) / D) {
         assert(idx >= next_idx);
-        if (idx == next_idx)
-          Reducer<scalar_t, REDUCE>::update(&val, tmp);
+        if (idx == next_idx) {
+          Reducer<acc_t, REDUCE>::update(&val, tmp);
+          if (REDUCE == MEAN)
+            count += count_tmp;
+        }
       }
     }
 
     next_idx = __shfl_down_sync(FULL_MASK, idx, 1);
     if (lane_idx == 32 - 1 || row_idx / D != (row_idx + 1) / D ||
-        idx != next_idx)
-      Reducer<scalar_t, REDUCE>::atomic_write(out_data + out_idx, val);
+        idx != next_idx) {
+      Reducer<scalar_t, REDUCE>::atomic_write(out_data + out_idx,
+                                              (scalar_t)val);
+      if (REDUCE == MEAN)
+        Reducer<scalar_t, SUM>::atomic_write(count_data + out_idx,
+                                             (scalar_t)count);
+    }
   }
 }
 
-template <typename scalar_t>
+template <typename scalar_t, typename index_t, typename offset_t>
 __global__ void segment_coo_arg_kernel(
     const scalar_t *src_data,
-    const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-    scalar_t *out_data, int64_t *arg_out_data, size_t E, size_t N) {
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    scalar_t *out_data, index_t *arg_out_data, offset_t E, offset_t N) {
 
-  int row_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int D = index_info.sizes[index_info.dims - 1];
+  offset_t row_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t D = index_info.sizes[index_info.dims - 1];
 
   if (row_idx < E) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        row_idx, index_info);
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            row_idx, index_info);
     int64_t idx = index_info.data[offset];
-    int out_idx = (row_idx / D) * N + idx;
+    offset_t out_idx = (row_idx / D) * N + idx;
 
     scalar_t val = __ldg(out_data + out_idx);
     if (src_data[row_idx] == val)
-      arg_out_data[out_idx] = row_idx % D;
+      arg_out_data[out_idx] = (index_t)(row_idx % D);
   }
 }
 
-template <typename scalar_t, ReductionType REDUCE, int TB>
+template <typename scalar_t, ReductionType REDUCE, int TB, int VEC,
+          typename index_t, typename offset_t>
 __global__ void segment_coo_broadcast_kernel(
     const scalar_t *src_data,
-    const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-    scalar_t *out_data, size_t E, size_t K, size_t N) {
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    scalar_t *out_data, scalar_t *count_data, offset_t E, offset_t K,
+    offset_t N) {
+
+  // Each thread processes `VEC` consecutive columns and `TB` index entries.
+  // Coalesced read and write is performed in column-major order. The
+  // intermediate results are written via atomics. For MEAN, threads of the
+  // first column additionally write the number of entries per index.
 
-  // Each thread processes a single column and `TB` index entries. Coalesced
-  // read and write is performed in column-major order. The intermediate
-  // results are written via atomics.
+  using acc_t = typename AccType<scalar_t>::type;
 
-  int D = index_info.sizes[index_info.dims - 1];
-  int E_1 = E / D;
-  int E_2 = (D - 1) + TB - ((D - 1) % TB);
+  offset_t D = index_info.sizes[index_info.dims - 1];
+  offset_t E_1 = E / D;
+  offset_t E_2 = (D - 1) + TB - ((D - 1) % TB);
 
-  int row_idx = blockIdx.x * blockDim.y + threadIdx.y;
-  int col_idx = blockIdx.y * blockDim.x + threadIdx.x;
+  offset_t row_idx = (offset_t)blockIdx.x * blockDim.y + threadIdx.y;
+  offset_t col_idx = ((offset_t)blockIdx.y * blockDim.x + threadIdx.x) * VEC;
 
-  int dim_start = (row_idx * TB) / E_2;
-  int row_start = (row_idx * TB) % E_2;
+  offset_t dim_start = (row_idx * TB) / E_2;
+  offset_t row_start = (row_idx * TB) % E_2;
 
   if (dim_start < E_1 && col_idx < K) {
 
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        dim_start * D + row_start, index_info);
-    int idx1 = __ldg(index_info.data + offset), idx2;
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            dim_start * D + row_start, index_info);
+    int64_t idx1 = __ldg(index_info.data + offset), idx2;
 
-    scalar_t val = src_data[K * (dim_start * D + row_start) + col_idx];
+    auto vec = load_vec<scalar_t, VEC>(
+        src_data + K * (dim_start * D + row_start) + col_idx);
+    acc_t val[VEC];
+#pragma unroll
+    for (int v = 0; v < VEC; v++)
+      val[v] = vec.val[v];
+    int count = 1;
 
 #pragma unroll
     for (int i = 1; i < TB; i++) {
@@ -109,46 +144,185 @@ __global__ void segment_coo_broadcast_kernel(
       idx2 = __ldg(index_info.data + offset +
                    i * index_info.strides[index_info.dims - 1]);
       assert(idx1 <= idx2);
+      vec = load_vec<scalar_t, VEC>(
+          src_data + K * (dim_start * D + row_start + i) + col_idx);
       if (idx1 == idx2) {
-        Reducer<scalar_t, REDUCE>::update(
-            &val, src_data[K * (dim_start * D + row_start + i) + col_idx]);
+#pragma unroll
+        for (int v = 0; v < VEC; v++)
+          Reducer<acc_t, REDUCE>::update(&val[v], vec.val[v]);
+        count++;
       } else {
-        Reducer<scalar_t, REDUCE>::atomic_write(
-            out_data + (dim_start * N + idx1) * K + col_idx, val);
-        val = src_data[K * (dim_start * D + row_start + i) + col_idx];
+#pragma unroll
+        for (int v = 0; v < VEC; v++) {
+          Reducer<scalar_t, REDUCE>::atomic_write(
+              out_data + (dim_start * N + idx1) * K + col_idx + v,
+              (scalar_t)val[v]);
+          val[v] = vec.val[v];
+        }
+        if (REDUCE == MEAN && col_idx == 0)
+          Reducer<scalar_t, SUM>::atomic_write(
+              count_data + dim_start * N + idx1, (scalar_t)count);
+        count = 1;
       }
 
       idx1 = idx2;
     }
 
-    Reducer<scalar_t, REDUCE>::atomic_write(
-        out_data + (dim_start * N + idx1) * K + col_idx, val);
+#pragma unroll
+    for (int v = 0; v < VEC; v++)
+      Reducer<scalar_t, REDUCE>::atomic_write(
+          out_data + (dim_start * N + idx1) * K + col_idx + v,
+          (scalar_t)val[v]);
+    if (REDUCE == MEAN && col_idx == 0)
+      Reducer<scalar_t, SUM>::atomic_write(count_data + dim_start * N + idx1,
+                                           (scalar_t)count);
   }
 }
 
-template <typename scalar_t>
+template <typename scalar_t, typename index_t, typename offset_t>
 __global__ void segment_coo_arg_broadcast_kernel(
     const scalar_t *src_data,
-    const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-    scalar_t *out_data, int64_t *arg_out_data, size_t E, size_t K, size_t N) {
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    scalar_t *out_data, index_t *arg_out_data, offset_t E, offset_t K,
+    offset_t N) {
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int row_idx = thread_idx / K;
-  int col_idx = thread_idx % K;
-  int D = index_info.sizes[index_info.dims - 1];
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / K;
+  offset_t col_idx = thread_idx % K;
+  offset_t D = index_info.sizes[index_info.dims - 1];
 
   if (row_idx < E && col_idx < K) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        row_idx, index_info);
-    int idx = __ldg(index_info.data + offset);
-    int out_idx = ((row_idx / D) * N + idx) * K + col_idx;
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            row_idx, index_info);
+    int64_t idx = __ldg(index_info.data + offset);
+    offset_t out_idx = ((row_idx / D) * N + idx) * K + col_idx;
 
     scalar_t val = __ldg(out_data + out_idx);
     if (src_data[thread_idx] == val)
-      arg_out_data[out_idx] = row_idx % D;
+      arg_out_data[out_idx] = (index_t)(row_idx % D);
+  }
+}
+
+template <typename scalar_t, ReductionType REDUCE, typename index_t,
+          typename offset_t>
+__global__ void segment_coo_arg_key_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    uint64_t *key_data, offset_t E, offset_t N) {
+
+  // Same as `segment_coo_kernel`, but reduces values and their arguments at
+  // once via packed 64-bit keys.
+
+  offset_t row_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  int lane_idx = row_idx & (32 - 1);
+  offset_t D = index_info.sizes[index_info.dims - 1];
+
+  if (row_idx < E) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            row_idx, index_info);
+    int64_t idx = index_info.data[offset], next_idx;
+    offset_t out_idx = (row_idx / D) * N + idx;
+
+    uint64_t key = ArgKey<scalar_t, REDUCE>::pack(src_data[row_idx],
+                                                  row_idx % D),
+             tmp;
+
+#pragma unroll
+    for (int i = 1; i < 32; i *= 2) {
+      // Parallel reduction inside a single warp.
+      tmp = __shfl_up_sync(FULL_MASK, key, i);
+      next_idx = __shfl_up_sync(FULL_MASK, idx, i);
+      if (lane_idx >= i && row_idx / D == (row_idx - i) / D) {
+        assert(idx >= next_idx);
+        if (idx == next_idx)
+          ArgKey<scalar_t, REDUCE>::update(&key, tmp);
+      }
+    }
+
+    next_idx = __shfl_down_sync(FULL_MASK, idx, 1);
+    if (lane_idx == 32 - 1 || row_idx / D != (row_idx + 1) / D ||
+        idx != next_idx)
+      ArgKey<scalar_t, REDUCE>::atomic_write(key_data + out_idx, key);
   }
 }
 
+template <typename scalar_t, ReductionType REDUCE, int TB, typename index_t,
+          typename offset_t>
+__global__ void segment_coo_arg_key_broadcast_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    uint64_t *key_data, offset_t E, offset_t K, offset_t N) {
+
+  // Same as `segment_coo_broadcast_kernel`, but reduces values and their
+  // arguments at once via packed 64-bit keys.
+
+  offset_t D = index_info.sizes[index_info.dims - 1];
+  offset_t E_1 = E / D;
+  offset_t E_2 = (D - 1) + TB - ((D - 1) % TB);
+
+  offset_t row_idx = (offset_t)blockIdx.x * blockDim.y + threadIdx.y;
+  offset_t col_idx = (offset_t)blockIdx.y * blockDim.x + threadIdx.x;
+
+  offset_t dim_start = (row_idx * TB) / E_2;
+  offset_t row_start = (row_idx * TB) % E_2;
+
+  if (dim_start < E_1 && col_idx < K) {
+
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            dim_start * D + row_start, index_info);
+    int64_t idx1 = __ldg(index_info.data + offset), idx2;
+
+    uint64_t key = ArgKey<scalar_t, REDUCE>::pack(
+        src_data[K * (dim_start * D + row_start) + col_idx], row_start);
+
+#pragma unroll
+    for (int i = 1; i < TB; i++) {
+      if (row_start + i >= D)
+        break;
+
+      idx2 = __ldg(index_info.data + offset +
+                   i * index_info.strides[index_info.dims - 1]);
+      assert(idx1 <= idx2);
+      uint64_t new_key = ArgKey<scalar_t, REDUCE>::pack(
+          src_data[K * (dim_start * D + row_start + i) + col_idx],
+          row_start + i);
+      if (idx1 == idx2) {
+        ArgKey<scalar_t, REDUCE>::update(&key, new_key);
+      } else {
+        ArgKey<scalar_t, REDUCE>::atomic_write(
+            key_data + (dim_start * N + idx1) * K + col_idx, key);
+        key = new_key;
+      }
+
+      idx1 = idx2;
+    }
+
+    ArgKey<scalar_t, REDUCE>::atomic_write(
+        key_data + (dim_start * N + idx1) * K + col_idx, key);
+  }
+}
+
+int64_t segment_coo_dim_size_cuda(torch::Tensor index) {
+  CHECK_CUDA(index);
+  if (index.numel() == 0)
+    return 0;
+  const c10::cuda::CUDAGuard device_guard(index.device());
+
+  // Since `index` is sorted, its maximum is found in its last column.
+  auto dim = index.dim() - 1;
+  auto size = sync_item(index, SEGMENT_COO_SIZE, [&] {
+    auto tmp = index.select(dim, index.size(dim) - 1);
+    return tmp.numel() > 1 ? tmp.max() : tmp;
+  });
+  AT_ASSERTM(size.has_value(), "Inferring the output size of segment_coo ",
+             "requires a host-device sync. Please pass `dim_size` ",
+             "explicitly instead.");
+  return 1 + size.value();
+}
+
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_coo_cuda(torch::Tensor src, torch::Tensor index,
                  torch::optional<torch::Tensor> optional_out,
@@ -157,7 +331,8 @@ segment_coo_cuda(torch::Tensor src, torch::Tensor index,
   CHECK_CUDA(index);
   if (optional_out.has_value())
     CHECK_CUDA(optional_out.value());
-  cudaSetDevice(src.get_device());
+  const c10::cuda::CUDAGuard device_guard(src.device());
+  WorkspaceScope workspace_scope(SEGMENT_COO_WORKSPACE);
 
   CHECK_INPUT(src.dim() >= index.dim());
 
@@ -181,29 +356,30 @@ segment_coo_cuda(torch::Tensor src, torch::Tensor index,
     sizes = src.sizes().vec();
     if (dim_size.has_value())
       sizes[dim] = dim_size.value();
-    else if (index.numel() == 0)
-      sizes[dim] = 0;
-    else {
-      auto tmp = index.select(dim, index.size(dim) - 1);
-      tmp = tmp.numel() > 1 ? tmp.max() : tmp;
-      sizes[dim] = 1 + tmp.cpu().data_ptr<int64_t>()[0];
-    }
-    out = torch::zeros(sizes, src.options());
+    else
+      sizes[dim] = segment_coo_dim_size_cuda(index);
+    out = torch::empty(sizes, src.options());
   }
 
+  // Both `out` and `arg_out` get initialized by the reduction launch below.
   torch::optional<torch::Tensor> arg_out = torch::nullopt;
-  int64_t *arg_out_data = nullptr;
   if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX) {
-    arg_out = torch::full_like(out, src.size(dim), index.options());
-    arg_out_data = arg_out.value().data_ptr<int64_t>();
+    arg_out = torch::empty(out.sizes(), index.options());
   } else if (reduce2REDUCE.at(reduce) == MEAN) {
     auto sizes = index.sizes().vec();
     sizes[dim] = out.size(dim);
-    arg_out = torch::zeros(sizes, out.options());
+    arg_out = torch::empty(sizes, out.options());
   }
 
-  if (index.numel() == 0)
+  if (index.numel() == 0) {
+    if (!optional_out.has_value())
+      out.fill_(0);
+    if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
+      arg_out.value().fill_(src.size(dim));
+    else if (reduce2REDUCE.at(reduce) == MEAN)
+      arg_out.value().fill_(0);
     return std::make_tuple(out, arg_out);
+  }
 
   auto E = index.numel();
   auto E_2 = index.size(dim);
@@ -211,89 +387,211 @@ segment_coo_cuda(torch::Tensor src, torch::Tensor index,
   auto K = src.numel() / E;
   auto N = out.size(dim);
   auto avg_len = (float)E_2 / (float)N;
+  // The number of entries each lane pre-reduces in the broadcast kernels,
+  // unless autotuned.
+  int TB = avg_len <= 8 ? 4 : (avg_len <= 16 ? 8 : (avg_len <= 32 ? 16 : 32));
 
-  auto index_info = at::cuda::detail::getTensorInfo<int64_t, int>(index);
+  auto use_64bit = use_64bit_offsets({src, index, out});
   auto stream = at::cuda::getCurrentCUDAStream();
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
 
-    AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
-      if (!optional_out.has_value())
-        out.fill_(Reducer<scalar_t, REDUCE>::init());
-
-      if (K == 1)
-        segment_coo_kernel<scalar_t, REDUCE, true>
-            <<<BLOCKS(1, E), THREADS, 0, stream>>>(src_data, index_info,
-                                                   out_data, E, N);
-      else if (avg_len <= 8)
-        segment_coo_broadcast_kernel<scalar_t, REDUCE, 4>
-            <<<dim3((E_1 * ((E_2 + 3) / 4) + 7) / 8, (K + 31) / 32),
-               dim3(32, 8), 0, stream>>>(src_data, index_info, out_data, E, K,
-                                         N);
-      else if (avg_len <= 16)
-        segment_coo_broadcast_kernel<scalar_t, REDUCE, 8>
-            <<<dim3((E_1 * ((E_2 + 7) / 8) + 7) / 8, (K + 31) / 32),
-               dim3(32, 8), 0, stream>>>(src_data, index_info, out_data, E, K,
-                                         N);
-      else if (avg_len <= 32)
-        segment_coo_broadcast_kernel<scalar_t, REDUCE, 16>
-            <<<dim3((E_1 * ((E_2 + 15) / 16) + 7) / 8, (K + 31) / 32),
-               dim3(32, 8), 0, stream>>>(src_data, index_info, out_data, E, K,
-                                         N);
-      else
-        segment_coo_broadcast_kernel<scalar_t, REDUCE, 32>
-            <<<dim3((E_1 * ((E_2 + 31) / 32) + 7) / 8, (K + 31) / 32),
-               dim3(32, 8), 0, stream>>>(src_data, index_info, out_data, E, K,
-                                         N);
-
-      if (!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX))
-        out.masked_fill_(out == Reducer<scalar_t, REDUCE>::init(), (scalar_t)0);
-
-      if (REDUCE == MIN || REDUCE == MAX) {
-        if (K == 1)
-          segment_coo_arg_kernel<scalar_t>
-              <<<BLOCKS(1, E), THREADS, 0, stream>>>(
-                  src_data, index_info, out_data, arg_out_data, E, N);
-        else
-          segment_coo_arg_broadcast_kernel<scalar_t>
-              <<<BLOCKS(1, E * K), THREADS, 0, stream>>>(
-                  src_data, index_info, out_data, arg_out_data, E, K, N);
-      }
-
-      if (REDUCE == MEAN) {
-        auto count_data = arg_out.value().data_ptr<scalar_t>();
-        segment_coo_kernel<scalar_t, SUM, false>
-            <<<BLOCKS(1, E), THREADS, 0, stream>>>(nullptr, index_info,
-                                                   count_data, E, N);
-        arg_out.value().masked_fill_(arg_out.value() < (scalar_t)1,
-                                     (scalar_t)1);
-        auto count = arg_out.value();
-        for (int i = dim + 1; i < out.dim(); i++)
-          count = count.unsqueeze(-1);
-        if (out.is_floating_point())
-          out.true_divide_(count);
-        else
-          out.div_(count, "floor");
-      }
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        index_t *arg_out_data = nullptr;
+        scalar_t *count_data = nullptr;
+        if (REDUCE == MIN || REDUCE == MAX)
+          arg_out_data = arg_out.value().data_ptr<index_t>();
+        if (REDUCE == MEAN)
+          count_data = arg_out.value().data_ptr<scalar_t>();
+
+        if ((REDUCE == MIN || REDUCE == MAX) &&
+            use_arg_key<scalar_t>(src.size(dim))) {
+          // Computes `out` and `arg_out` within a single pass over `src`.
+          RECORD_KERNEL("segment_coo_cuda", E, K, N, "arg_key,TB=", TB);
+          auto key =
+              workspace_empty(out.sizes(), out.options().dtype(at::kLong));
+          auto key_data = (uint64_t *)key.data_ptr<int64_t>();
+
+          arg_key_init_kernel<scalar_t, REDUCE>
+              <<<BLOCKS(1, out.numel()), THREADS, 0, stream>>>(
+                  optional_out.has_value() ? out_data : nullptr, key_data,
+                  src.size(dim), out.numel());
+
+          AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+            auto index_info =
+                at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
+
+            if (K == 1)
+              segment_coo_arg_key_kernel<scalar_t, REDUCE, index_t, offset_t>
+                  <<<BLOCKS(1, E), THREADS, 0, stream>>>(src_data, index_info,
+                                                         key_data, E, N);
+            else if (avg_len <= 8)
+              segment_coo_arg_key_broadcast_kernel<scalar_t, REDUCE, 4,
+                                                   index_t, offset_t>
+                  <<<dim3((E_1 * ((E_2 + 3) / 4) + 7) / 8, (K + 31) / 32),
+                     dim3(32, 8), 0, stream>>>(src_data, index_info, key_data,
+                                               E, K, N);
+            else if (avg_len <= 16)
+              segment_coo_arg_key_broadcast_kernel<scalar_t, REDUCE, 8,
+                                                   index_t, offset_t>
+                  <<<dim3((E_1 * ((E_2 + 7) / 8) + 7) / 8, (K + 31) / 32),
+                     dim3(32, 8), 0, stream>>>(src_data, index_info, key_data,
+                                               E, K, N);
+            else if (avg_len <= 32)
+              segment_coo_arg_key_broadcast_kernel<scalar_t, REDUCE, 16,
+                                                   index_t, offset_t>
+                  <<<dim3((E_1 * ((E_2 + 15) / 16) + 7) / 8, (K + 31) / 32),
+                     dim3(32, 8), 0, stream>>>(src_data, index_info, key_data,
+                                               E, K, N);
+            else
+              segment_coo_arg_key_broadcast_kernel<scalar_t, REDUCE, 32,
+                                                   index_t, offset_t>
+                  <<<dim3((E_1 * ((E_2 + 31) / 32) + 7) / 8, (K + 31) / 32),
+                     dim3(32, 8), 0, stream>>>(src_data, index_info, key_data,
+                                               E, K, N);
+          });
+
+          arg_key_finalize_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(1, out.numel()), THREADS, 0, stream>>>(
+                  key_data, out_data, arg_out_data, src.size(dim),
+                  out.numel());
+          return;
+        }
+
+        if (use_sorted_reduce<scalar_t, REDUCE>()) {
+          // `index` is already sorted, so that each output can reduce its
+          // entries sequentially instead of pre-reducing them per warp.
+          RECORD_KERNEL("segment_coo_cuda", E, K, N, "sorted");
+          auto sorted_index = index.reshape({E_1, E_2}).contiguous();
+          sorted_reduce_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(1, out.numel()), THREADS, 0, stream>>>(
+                  src_data, sorted_index.data_ptr<index_t>(), nullptr,
+                  nullptr, out_data, count_data, optional_out.has_value(),
+                  E_2, K, 1, N, out.numel());
+          return;
+        }
+
+        RECORD_KERNEL("segment_coo_cuda", E, K, N, "atomic",
+                      use_64bit ? ",64bit" : "");
+
+        // Initializes `out` and `arg_out` (or `count`) within a single launch.
+        auto out_numel = optional_out.has_value() ? 0 : out.numel();
+        auto arg_numel = arg_out.has_value() ? arg_out.value().numel() : 0;
+        if (out_numel > 0 || arg_numel > 0) {
+          if (REDUCE == MEAN)
+            reducer_init_kernel<scalar_t, REDUCE, scalar_t>
+                <<<BLOCKS(1, out.numel()), THREADS, 0, stream>>>(
+                    out_data, out_numel, count_data, (scalar_t)0, arg_numel);
+          else
+            reducer_init_kernel<scalar_t, REDUCE, index_t>
+                <<<BLOCKS(1, out.numel()), THREADS, 0, stream>>>(
+                    out_data, out_numel, arg_out_data,
+                    (index_t)src.size(dim), arg_numel);
+        }
+
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto index_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
+
+          if (K == 1)
+            segment_coo_kernel<scalar_t, REDUCE, index_t, offset_t>
+                <<<BLOCKS(1, E), THREADS, 0, stream>>>(
+                    src_data, index_info, out_data, count_data, E, N);
+          else {
+            // Values are only loaded in packs, since they are written via
+            // scalar atomics.
+            auto vec = vec_size<scalar_t>(K, {src_data});
+            auto launch = [&](int TB, scalar_t *out_ptr, scalar_t *count_ptr) {
+              AT_DISPATCH_VEC_SIZES(scalar_t, vec, [&] {
+                auto blocks = dim3((E_1 * ((E_2 + TB - 1) / TB) + 7) / 8,
+                                   (K / VEC + 31) / 32);
+                if (TB == 4)
+                  segment_coo_broadcast_kernel<scalar_t, REDUCE, 4, VEC,
+                                               index_t, offset_t>
+                      <<<blocks, dim3(32, 8), 0, stream>>>(
+                          src_data, index_info, out_ptr, count_ptr, E, K, N);
+                else if (TB == 8)
+                  segment_coo_broadcast_kernel<scalar_t, REDUCE, 8, VEC,
+                                               index_t, offset_t>
+                      <<<blocks, dim3(32, 8), 0, stream>>>(
+                          src_data, index_info, out_ptr, count_ptr, E, K, N);
+                else if (TB == 16)
+                  segment_coo_broadcast_kernel<scalar_t, REDUCE, 16, VEC,
+                                               index_t, offset_t>
+                      <<<blocks, dim3(32, 8), 0, stream>>>(
+                          src_data, index_info, out_ptr, count_ptr, E, K, N);
+                else
+                  segment_coo_broadcast_kernel<scalar_t, REDUCE, 32, VEC,
+                                               index_t, offset_t>
+                      <<<blocks, dim3(32, 8), 0, stream>>>(
+                          src_data, index_info, out_ptr, count_ptr, E, K, N);
+              });
+            };
+
+            // Candidates are timed on scratch outputs, whose values do not
+            // matter.
+            torch::Tensor scratch, scratch_count;
+            auto key = [&] {
+              return autotune_key("segment_coo_" + reduce, src, K, avg_len);
+            };
+            auto run = [&](int TB) {
+              if (!scratch.defined()) {
+                scratch = torch::zeros_like(out);
+                if (REDUCE == MEAN)
+                  scratch_count = torch::zeros_like(arg_out.value());
+              }
+              launch(TB, scratch.data_ptr<scalar_t>(),
+                     REDUCE == MEAN ? scratch_count.data_ptr<scalar_t>()
+                                    : nullptr);
+            };
+            auto tuned_TB =
+                autotune(SEGMENT_COO_AUTOTUNE, key, {4, 8, 16, 32}, TB, run);
+
+            RECORD_KERNEL("segment_coo_cuda", E, K, N, "broadcast,TB=",
+                          tuned_TB);
+            launch(tuned_TB, out_data, count_data);
+          }
+
+          // Resets empty entries for MIN/MAX and divides by `count` for MEAN.
+          if ((!optional_out.has_value() && (REDUCE == MIN || REDUCE == MAX)) ||
+              REDUCE == MEAN)
+            reducer_finalize_kernel<scalar_t, REDUCE>
+                <<<BLOCKS(1, out.numel()), THREADS, 0, stream>>>(
+                    out_data, count_data, K, out.numel());
+
+          if (REDUCE == MIN || REDUCE == MAX) {
+            if (K == 1)
+              segment_coo_arg_kernel<scalar_t, index_t, offset_t>
+                  <<<BLOCKS(1, E), THREADS, 0, stream>>>(
+                      src_data, index_info, out_data, arg_out_data, E, N);
+            else
+              segment_coo_arg_broadcast_kernel<scalar_t, index_t, offset_t>
+                  <<<BLOCKS(1, E * K), THREADS, 0, stream>>>(
+                      src_data, index_info, out_data, arg_out_data, E, K, N);
+          }
+        });
+      });
     });
   });
 
   return std::make_tuple(out, arg_out);
 }
 
-template <typename scalar_t>
-__global__ void
-gather_coo_kernel(const scalar_t *src_data,
-                  const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-                  scalar_t *out_data, size_t E, size_t N) {
+template <typename scalar_t, typename index_t, typename offset_t>
+__global__ void gather_coo_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    scalar_t *out_data, offset_t E, offset_t N) {
 
-  int row_idx = blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
 
   if (row_idx < E) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        row_idx, index_info);
-    int row = index_info.data[offset];
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            row_idx, index_info);
+    int64_t row = index_info.data[offset];
 
     offset = (row_idx / index_info.sizes[index_info.dims - 1]) * N;
     scalar_t val = __ldg(src_data + offset + row);
@@ -302,25 +600,28 @@ gather_coo_kernel(const scalar_t *src_data,
   }
 }
 
-template <typename scalar_t>
+template <typename scalar_t, int VEC, typename index_t, typename offset_t>
 __global__ void gather_coo_broadcast_kernel(
     const scalar_t *src_data,
-    const at::cuda::detail::TensorInfo<int64_t, int> index_info,
-    scalar_t *out_data, size_t E, size_t K, size_t N) {
+    const at::cuda::detail::TensorInfo<index_t, offset_t> index_info,
+    scalar_t *out_data, offset_t E, offset_t K, offset_t N) {
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int row_idx = thread_idx / K;
-  int col_idx = thread_idx % K;
+  // Each thread copies `VEC` consecutive columns of a single entry.
 
-  if (thread_idx < E * K) {
-    int offset = at::cuda::detail::IndexToOffset<int64_t, int, -1>::get(
-        row_idx, index_info);
-    int row = index_info.data[offset];
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (K / VEC);
+  offset_t col_idx = (thread_idx % (K / VEC)) * VEC;
+
+  if (thread_idx < E * (K / VEC)) {
+    offset_t offset =
+        at::cuda::detail::IndexToOffset<index_t, offset_t, -1>::get(
+            row_idx, index_info);
+    int64_t row = index_info.data[offset];
 
     offset = (row_idx / index_info.sizes[index_info.dims - 1]) * N * K;
-    scalar_t val = __ldg(src_data + offset + K * row + col_idx);
+    auto val = load_vec<scalar_t, VEC>(src_data + offset + K * row + col_idx);
 
-    out_data[thread_idx] = val;
+    store_vec<scalar_t, VEC>(out_data + thread_idx * VEC, val);
   }
 }
 
@@ -330,7 +631,7 @@ torch::Tensor gather_coo_cuda(torch::Tensor src, torch::Tensor index,
   CHECK_CUDA(index);
   if (optional_out.has_value())
     CHECK_CUDA(optional_out.value());
-  cudaSetDevice(src.get_device());
+  const c10::cuda::CUDAGuard device_guard(src.device());
 
   CHECK_INPUT(src.dim() >= index.dim());
 
@@ -363,20 +664,38 @@ torch::Tensor gather_coo_cuda(torch::Tensor src, torch::Tensor index,
   auto K = out.numel() / E;
   auto N = src.size(dim);
 
-  auto index_info = at::cuda::detail::getTensorInfo<int64_t, int>(index);
+  auto use_64bit = use_64bit_offsets({src, index, out});
   auto stream = at::cuda::getCurrentCUDAStream();
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
 
-    if (K == 1)
-      gather_coo_kernel<scalar_t><<<BLOCKS(1, E), THREADS, 0, stream>>>(
-          src_data, index_info, out_data, E, N);
-    else
-      gather_coo_broadcast_kernel<scalar_t>
-          <<<BLOCKS(1, E * K), THREADS, 0, stream>>>(src_data, index_info,
-                                                     out_data, E, K, N);
+    AT_DISPATCH_INDEX_TYPES(index.scalar_type(), "_", [&] {
+      AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+        auto index_info =
+            at::cuda::detail::getTensorInfo<index_t, offset_t>(index);
+
+        if (K == 1)
+          gather_coo_kernel<scalar_t, index_t, offset_t>
+              <<<BLOCKS(1, E), THREADS, 0, stream>>>(src_data, index_info,
+                                                     out_data, E, N);
+        else {
+          auto vec = vec_size<scalar_t>(K, {src_data, out_data});
+          AT_DISPATCH_VEC_SIZES(scalar_t, vec, [&] {
+            gather_coo_broadcast_kernel<scalar_t, VEC, index_t, offset_t>
+                <<<BLOCKS(1, E * (K / VEC)), THREADS, 0, stream>>>(
+                    src_data, index_info, out_data, E, K, N);
+          });
+        }
+      });
+    });
   });
 
   return out;
 }
+
+torch::Tensor segment_coo_arg_backward_cuda(torch::Tensor grad_out,
+                                            torch::Tensor arg_out, int64_t dim,
+                                            std::vector<int64_t> src_sizes) {
+  return arg_backward_cuda(grad_out, arg_out, dim, src_sizes, THREADS);
+}
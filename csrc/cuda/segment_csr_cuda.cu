@@ -3,7 +3,12 @@
 #include <ATen/cuda/CUDAContext.h>
 #include <ATen/cuda/detail/IndexUtils.cuh>
 #include <ATen/cuda/detail/TensorInfo.cuh>
+#include <c10/cuda/CUDAGuard.h>
 
+#include "../profiler.h"
+#include "../workspace.h"
+#include "autotune.h"
+#include "host_sync.h"
 #include "index_info.cuh"
 #include "reducer.cuh"
 #include "utils.cuh"
@@ -12,34 +17,53 @@
 #define BLOCKS(TB, N) (TB * N + THREADS - 1) / THREADS
 #define FULL_MASK 0xffffffff
 
-template <typename scalar_t, ReductionType REDUCE, int TB>
-__global__ void
-segment_csr_kernel(const scalar_t *src_data,
-                   const at::cuda::detail::TensorInfo<int64_t, int> indptr_info,
-                   scalar_t *out_data, int64_t *arg_out_data, size_t N,
-                   size_t E) {
+// Number of merge path items (rows and non-zero entries) per partition.
+#define MERGE_PATH_ITEMS 32
+// We switch to the merge path kernel once the standard deviation of row
+// lengths exceeds their mean by this factor.
+#define MERGE_PATH_CV 2.0f
+#define MERGE_PATH_MIN_ROWS 4096
+
+// Unless decided on the host, both the row-based kernels and the merge path
+// kernels get launched, and `merge_path_data` points to the on-device decision
+// of which of them should do the actual work.
+
+template <typename scalar_t, ReductionType REDUCE, int TB, typename index_t,
+          typename offset_t>
+__global__ void segment_csr_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    const scalar_t *weight_data, scalar_t *out_data, index_t *arg_out_data,
+    offset_t N, offset_t E, const bool *merge_path_data) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  if (merge_path_data != nullptr && *merge_path_data)
+    return;
 
   // Each warp processes exactly `32/TB` rows and aggregates all row values
   // via a parallel reduction.
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int row_idx = thread_idx / TB;
-  int lane_idx = thread_idx & (TB - 1);
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / TB;
+  offset_t lane_idx = thread_idx & (TB - 1);
 
   if (row_idx < N) {
-    int offset = IndexPtrToOffset<int64_t>::get(row_idx, indptr_info);
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
     int64_t row_start = __ldg(indptr_info.data + offset);
     int64_t row_end = __ldg(indptr_info.data + offset +
                             indptr_info.strides[indptr_info.dims - 1]);
 
-    scalar_t val = Reducer<scalar_t, REDUCE>::init();
-    int64_t arg, arg_tmp;
+    acc_t val = Reducer<acc_t, REDUCE>::init();
+    int64_t arg = E, arg_tmp;
 
     offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E;
     for (int64_t src_idx = row_start + lane_idx; src_idx < row_end;
          src_idx += TB) {
-      Reducer<scalar_t, REDUCE>::update(&val, src_data[offset + src_idx], &arg,
-                                        src_idx);
+      Reducer<acc_t, REDUCE>::update(
+          &val, weigh(src_data[offset + src_idx], weight_data, src_idx), &arg,
+          src_idx);
     }
 
 #pragma unroll
@@ -47,62 +71,244 @@ segment_csr_kernel(const scalar_t *src_data,
       // Parallel reduction inside a single warp.
       if (REDUCE == MIN || REDUCE == MAX)
         arg_tmp = __shfl_down_sync(FULL_MASK, arg, i);
-      Reducer<scalar_t, REDUCE>::update(
+      Reducer<acc_t, REDUCE>::update(
           &val, __shfl_down_sync(FULL_MASK, val, i), &arg, arg_tmp);
     }
 
     if (lane_idx == 0) {
-      Reducer<scalar_t, REDUCE>::write(out_data + row_idx, val,
-                                       arg_out_data + row_idx, arg,
-                                       row_end - row_start);
+      Reducer<acc_t, REDUCE>::write(out_data + row_idx, val,
+                                    arg_out_data + row_idx, arg,
+                                    row_end - row_start);
     }
   }
 }
 
-template <typename scalar_t, ReductionType REDUCE>
+template <typename scalar_t, ReductionType REDUCE, int VEC, typename index_t,
+          typename offset_t>
 __global__ void segment_csr_broadcast_kernel(
     const scalar_t *src_data,
-    const at::cuda::detail::TensorInfo<int64_t, int> indptr_info,
-    scalar_t *out_data, int64_t *arg_out_data, size_t N, size_t K, size_t E) {
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    const scalar_t *weight_data, scalar_t *out_data, index_t *arg_out_data,
+    offset_t N, offset_t K, offset_t E, const bool *merge_path_data) {
 
-  // Each thread processes exactly one row. It turned out that is more
-  // efficient than using shared memory due to avoiding synchronization
-  // barriers.
+  using acc_t = typename AccType<scalar_t>::type;
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int row_idx = thread_idx / K;
-  int lane_idx = thread_idx % K;
+  if (merge_path_data != nullptr && *merge_path_data)
+    return;
 
-  if (thread_idx < N * K) {
-    int offset = IndexPtrToOffset<int64_t>::get(row_idx, indptr_info);
+  // Each thread processes exactly one row of `VEC` consecutive columns. It
+  // turned out that is more efficient than using shared memory due to
+  // avoiding synchronization barriers.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (K / VEC);
+  offset_t lane_idx = (thread_idx % (K / VEC)) * VEC;
+
+  if (thread_idx < N * (K / VEC)) {
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
     int64_t row_start = __ldg(indptr_info.data + offset);
     int64_t row_end = __ldg(indptr_info.data + offset +
                             indptr_info.strides[indptr_info.dims - 1]);
 
-    scalar_t val = Reducer<scalar_t, REDUCE>::init();
-    int64_t arg;
+    acc_t val[VEC];
+    int64_t arg[VEC];
+#pragma unroll
+    for (int v = 0; v < VEC; v++) {
+      val[v] = Reducer<acc_t, REDUCE>::init();
+      arg[v] = E;
+    }
 
     offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E * K;
     for (int64_t src_idx = row_start; src_idx < row_end; src_idx++) {
-      Reducer<scalar_t, REDUCE>::update(
-          &val, src_data[offset + K * src_idx + lane_idx], &arg, src_idx);
+      auto vec = load_vec<scalar_t, VEC>(src_data + offset + K * src_idx +
+                                         lane_idx);
+#pragma unroll
+      for (int v = 0; v < VEC; v++)
+        Reducer<acc_t, REDUCE>::update(
+            &val[v], weigh(vec.val[v], weight_data, src_idx), &arg[v],
+            src_idx);
     }
 
-    Reducer<scalar_t, REDUCE>::write(out_data + thread_idx, val,
-                                     arg_out_data + thread_idx, arg,
-                                     row_end - row_start);
+    Vec<scalar_t, VEC> out;
+#pragma unroll
+    for (int v = 0; v < VEC; v++)
+      Reducer<acc_t, REDUCE>::write(&out.val[v], val[v],
+                                    arg_out_data + thread_idx * VEC + v,
+                                    arg[v], row_end - row_start);
+    store_vec<scalar_t, VEC>(out_data + thread_idx * VEC, out);
+  }
+}
+
+// Finds the starting coordinate `(row, nz)` of the merge path on diagonal
+// `diag`, where the first list holds the (relative) end offsets of all rows
+// and the second list holds the positions of all non-zero entries.
+template <typename index_t>
+__device__ __inline__ void merge_path_search(int64_t diag,
+                                             const index_t *indptr_data,
+                                             int64_t stride, int64_t base,
+                                             int64_t N, int64_t nnz,
+                                             int64_t *row, int64_t *nz) {
+  int64_t x_min = max(diag - nnz, (int64_t)0);
+  int64_t x_max = min(diag, N);
+  while (x_min < x_max) {
+    int64_t pivot = (x_min + x_max) >> 1;
+    if (__ldg(indptr_data + (pivot + 1) * stride) - base <= diag - pivot - 1)
+      x_min = pivot + 1;
+    else
+      x_max = pivot;
+  }
+  *row = x_min;
+  *nz = diag - x_min;
+}
+
+template <typename scalar_t, ReductionType REDUCE, typename index_t>
+__global__ void segment_csr_merge_path_kernel(
+    const scalar_t *src_data, const index_t *indptr_data, int64_t stride,
+    scalar_t *out_data, index_t *arg_out_data, int64_t *head_row_data,
+    typename AccType<scalar_t>::type *head_data, int64_t *head_arg_data,
+    int64_t *tail_row_data, typename AccType<scalar_t>::type *tail_data,
+    int64_t *tail_arg_data, int64_t N, int64_t K, int64_t E, int64_t P,
+    const bool *merge_path_data) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  if (merge_path_data != nullptr && !*merge_path_data)
+    return;
+
+  // Each thread consumes exactly `MERGE_PATH_ITEMS` items of the merge path
+  // between row end offsets and non-zero entries of a single column, so that
+  // work is split evenly regardless of row lengths. Rows which are fully
+  // contained in a partition are written directly. The first row of a
+  // partition that started in a previous partition ("head") and the last row
+  // that does not finish in this partition ("tail") are written to temporary
+  // buffers instead, and get combined by `segment_csr_merge_path_fixup_kernel`.
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+  int64_t part_idx = thread_idx / K;
+  int64_t lane_idx = thread_idx % K;
+
+  if (part_idx < P) {
+    int64_t base = __ldg(indptr_data);
+    int64_t nnz = __ldg(indptr_data + N * stride) - base;
+    int64_t diag = min(part_idx * MERGE_PATH_ITEMS, N + nnz);
+    int64_t diag_end = min(diag + MERGE_PATH_ITEMS, N + nnz);
+
+    int64_t row, nz;
+    merge_path_search(diag, indptr_data, stride, base, N, nnz, &row, &nz);
+
+    int64_t row_start = row < N ? __ldg(indptr_data + row * stride) - base : 0;
+    int64_t row_end, head_row = -1, tail_row = -1;
+    bool is_head = row < N && row_start < nz, touched = false;
+
+    acc_t val = Reducer<acc_t, REDUCE>::init();
+    int64_t arg = E;
+
+    for (; diag < diag_end; diag++) {
+      row_end = __ldg(indptr_data + (row + 1) * stride) - base;
+      if (nz < row_end) {
+        Reducer<acc_t, REDUCE>::update(
+            &val, src_data[(base + nz) * K + lane_idx], &arg, base + nz);
+        touched = true;
+        nz++;
+      } else {
+        if (is_head) {
+          head_row = row;
+          head_data[thread_idx] = val;
+          if (REDUCE == MIN || REDUCE == MAX)
+            head_arg_data[thread_idx] = arg;
+          is_head = false;
+        } else {
+          Reducer<acc_t, REDUCE>::write(
+              out_data + row * K + lane_idx, val,
+              arg_out_data + row * K + lane_idx, arg, row_end - row_start);
+        }
+        val = Reducer<acc_t, REDUCE>::init();
+        arg = E;
+        row_start = row_end;
+        touched = false;
+        row++;
+      }
+    }
+
+    if (touched) {
+      tail_row = row;
+      tail_data[thread_idx] = val;
+      if (REDUCE == MIN || REDUCE == MAX)
+        tail_arg_data[thread_idx] = arg;
+    }
+
+    if (lane_idx == 0) {
+      head_row_data[part_idx] = head_row;
+      tail_row_data[part_idx] = tail_row;
+    }
+  }
+}
+
+template <typename scalar_t, ReductionType REDUCE, typename index_t>
+__global__ void segment_csr_merge_path_fixup_kernel(
+    const index_t *indptr_data, int64_t stride, scalar_t *out_data,
+    index_t *arg_out_data, const int64_t *head_row_data,
+    const typename AccType<scalar_t>::type *head_data,
+    const int64_t *head_arg_data, const int64_t *tail_row_data,
+    const typename AccType<scalar_t>::type *tail_data,
+    const int64_t *tail_arg_data, int64_t K, int64_t P,
+    const bool *merge_path_data) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  if (merge_path_data != nullptr && !*merge_path_data)
+    return;
+
+  // Each partition that finishes a row spanning multiple partitions combines
+  // all tails of that row in order, followed by its own head. This performs
+  // the carry-out fix-up deterministically and without atomics.
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+  int64_t part_idx = thread_idx / K;
+  int64_t lane_idx = thread_idx % K;
+
+  if (part_idx < P) {
+    int64_t row = head_row_data[part_idx];
+    if (row < 0)
+      return;
+
+    int64_t first = part_idx;
+    while (first > 0 && tail_row_data[first - 1] == row)
+      first--;
+
+    acc_t val = Reducer<acc_t, REDUCE>::init();
+    int64_t arg = -1;
+    for (int64_t p = first; p < part_idx; p++)
+      Reducer<acc_t, REDUCE>::update(
+          &val, tail_data[p * K + lane_idx], &arg,
+          (REDUCE == MIN || REDUCE == MAX) ? tail_arg_data[p * K + lane_idx]
+                                           : -1);
+    Reducer<acc_t, REDUCE>::update(
+        &val, head_data[thread_idx], &arg,
+        (REDUCE == MIN || REDUCE == MAX) ? head_arg_data[thread_idx] : -1);
+
+    int64_t count = __ldg(indptr_data + (row + 1) * stride) -
+                    __ldg(indptr_data + row * stride);
+    Reducer<acc_t, REDUCE>::write(out_data + row * K + lane_idx, val,
+                                  arg_out_data + row * K + lane_idx, arg,
+                                  count);
   }
 }
 
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_csr_cuda(torch::Tensor src, torch::Tensor indptr,
                  torch::optional<torch::Tensor> optional_out,
-                 std::string reduce) {
+                 std::string reduce,
+                 torch::optional<torch::Tensor> optional_weight) {
   CHECK_CUDA(src);
   CHECK_CUDA(indptr);
   if (optional_out.has_value())
     CHECK_CUDA(optional_out.value());
-  cudaSetDevice(src.get_device());
+  if (optional_weight.has_value())
+    CHECK_CUDA(optional_weight.value());
+  const c10::cuda::CUDAGuard device_guard(src.device());
+  WorkspaceScope workspace_scope(SEGMENT_CSR_WORKSPACE);
 
   CHECK_INPUT(src.dim() >= indptr.dim());
 
@@ -115,6 +321,15 @@ segment_csr_cuda(torch::Tensor src, torch::Tensor indptr,
 
   src = src.contiguous();
 
+  torch::Tensor weight;
+  if (optional_weight.has_value()) {
+    AT_ASSERTM(supports_weight(reduce), "Reduction type \"", reduce,
+               "\" does not support weights");
+    weight = optional_weight.value().contiguous();
+    CHECK_INPUT(weight.dim() == 1 && weight.numel() == src.size(dim));
+    CHECK_INPUT(weight.scalar_type() == src.scalar_type());
+  }
+
   torch::Tensor out;
   if (optional_out.has_value()) {
     out = optional_out.value().contiguous();
@@ -129,15 +344,14 @@ segment_csr_cuda(torch::Tensor src, torch::Tensor indptr,
   }
 
   torch::optional<torch::Tensor> arg_out = torch::nullopt;
-  int64_t *arg_out_data = nullptr;
-  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX) {
-    arg_out = torch::full(out.sizes(), src.size(dim), indptr.options());
-    arg_out_data = arg_out.value().data_ptr<int64_t>();
-  }
+  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
+    arg_out = torch::empty(out.sizes(), indptr.options());
 
   if (src.numel() == 0) {
     if (!optional_out.has_value())
       out.fill_(0);
+    if (arg_out.has_value())
+      arg_out.value().fill_(src.size(dim));
     return std::make_tuple(out, arg_out);
   }
 
@@ -145,73 +359,203 @@ segment_csr_cuda(torch::Tensor src, torch::Tensor indptr,
   auto K = out.numel() / N;
   auto E = src.size(dim);
 
-  auto indptr_info = at::cuda::detail::getTensorInfo<int64_t, int>(indptr);
+  // Row lengths of power-law graphs vary heavily, such that a few warps
+  // processing hub rows dominate the runtime when assigning a fixed number of
+  // rows per warp. In that case, we split work by an equal number of rows and
+  // non-zero entries via merge path instead.
+  // Detecting imbalance on the host requires reading back `indptr`, which is
+  // only done in "cache" sync mode (once per `indptr`). Otherwise, imbalance
+  // is detected on the device, such that plain calls never sync.
+  bool use_row = true, use_merge_path = false;
+  torch::Tensor merge_path;
+  if (indptr.dim() == 1 && N >= MERGE_PATH_MIN_ROWS &&
+      reduce2REDUCE.at(reduce) != DIV && !optional_weight.has_value()) {
+    auto imbalanced = [&] {
+      auto deg = (indptr.narrow(0, 1, N) - indptr.narrow(0, 0, N))
+                     .to(torch::kFloat);
+      return deg.std(false) > MERGE_PATH_CV * deg.mean();
+    };
+    torch::optional<int64_t> value = torch::nullopt;
+    if (sync_mode() != SYNC_DEFAULT)
+      value = sync_item(indptr, MERGE_PATH, imbalanced);
+    if (value.has_value()) {
+      use_merge_path = value.value() != 0;
+      use_row = !use_merge_path;
+    } else {
+      merge_path = imbalanced();
+      use_merge_path = true;
+    }
+  }
+  const bool *merge_path_data =
+      merge_path.defined() ? merge_path.data_ptr<bool>() : nullptr;
+
+  auto use_64bit = use_64bit_offsets({src, indptr, out});
+  RECORD_KERNEL("segment_csr_cuda", E, K, N,
+                merge_path.defined() ? "device"
+                : use_merge_path     ? "merge_path"
+                : K == 1             ? "row"
+                                     : "broadcast",
+                use_64bit ? ",64bit" : "");
   auto stream = at::cuda::getCurrentCUDAStream();
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *weight_data = nullptr;
+    if (optional_weight.has_value())
+      weight_data = weight.data_ptr<scalar_t>();
 
-    AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
-      if (K == 1) {
-        segment_csr_kernel<scalar_t, REDUCE, 1>
-            <<<BLOCKS(32, N), THREADS, 0, stream>>>(
-                src_data, indptr_info, out_data, arg_out_data, N, E);
-      } else {
-        segment_csr_broadcast_kernel<scalar_t, REDUCE>
-            <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(
-                src_data, indptr_info, out_data, arg_out_data, N, K, E);
-      }
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      index_t *arg_out_data = nullptr;
+      if (arg_out.has_value())
+        arg_out_data = arg_out.value().data_ptr<index_t>();
+
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        if (use_merge_path) {
+          auto P = (N + E + MERGE_PATH_ITEMS - 1) / MERGE_PATH_ITEMS;
+          auto options = indptr.options().dtype(torch::kLong);
+          auto head_row = workspace_empty({P}, options);
+          auto tail_row = workspace_empty({P}, options);
+          // Partial results are kept in the accumulation type.
+          using acc_t = typename AccType<scalar_t>::type;
+          auto acc_options =
+              src.options().dtype(c10::CppTypeToScalarType<acc_t>::value);
+          auto head = workspace_empty({P, K}, acc_options);
+          auto tail = workspace_empty({P, K}, acc_options);
+          int64_t *head_arg_data = nullptr, *tail_arg_data = nullptr;
+          torch::Tensor head_arg, tail_arg;
+          if (REDUCE == MIN || REDUCE == MAX) {
+            head_arg = workspace_empty({P, K}, options);
+            tail_arg = workspace_empty({P, K}, options);
+            head_arg_data = head_arg.data_ptr<int64_t>();
+            tail_arg_data = tail_arg.data_ptr<int64_t>();
+          }
+
+          auto indptr_data = indptr.data_ptr<index_t>();
+          auto stride = indptr.stride(0);
+          segment_csr_merge_path_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(1, P * K), THREADS, 0, stream>>>(
+                  src_data, indptr_data, stride, out_data, arg_out_data,
+                  head_row.data_ptr<int64_t>(), head.data_ptr<acc_t>(),
+                  head_arg_data, tail_row.data_ptr<int64_t>(),
+                  tail.data_ptr<acc_t>(), tail_arg_data, N, K, E, P,
+                  merge_path_data);
+          segment_csr_merge_path_fixup_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(1, P * K), THREADS, 0, stream>>>(
+                  indptr_data, stride, out_data, arg_out_data,
+                  head_row.data_ptr<int64_t>(), head.data_ptr<acc_t>(),
+                  head_arg_data, tail_row.data_ptr<int64_t>(),
+                  tail.data_ptr<acc_t>(), tail_arg_data, K, P, merge_path_data);
+        }
+        if (use_row) {
+          AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+            auto indptr_info =
+                at::cuda::detail::getTensorInfo<index_t, offset_t>(indptr);
+            if (K == 1) {
+              // Processes each row by a single thread or by a full warp.
+              auto launch = [&](int TB, scalar_t *out_ptr,
+                                index_t *arg_out_ptr,
+                                const bool *merge_path_ptr) {
+                if (TB == 1)
+                  segment_csr_kernel<scalar_t, REDUCE, 1, index_t, offset_t>
+                      <<<BLOCKS(32, N), THREADS, 0, stream>>>(
+                          src_data, indptr_info, weight_data, out_ptr,
+                          arg_out_ptr, N, E, merge_path_ptr);
+                else
+                  segment_csr_kernel<scalar_t, REDUCE, 32, index_t, offset_t>
+                      <<<BLOCKS(32, N), THREADS, 0, stream>>>(
+                          src_data, indptr_info, weight_data, out_ptr,
+                          arg_out_ptr, N, E, merge_path_ptr);
+              };
+
+              torch::Tensor scratch, scratch_arg;
+              auto key = [&] {
+                return autotune_key("segment_csr_" + reduce, src, K,
+                                    (double)E / std::max<int64_t>(N, 1));
+              };
+              auto run = [&](int TB) {
+                if (!scratch.defined()) {
+                  scratch = torch::empty_like(out);
+                  if (arg_out.has_value())
+                    scratch_arg = torch::empty_like(arg_out.value());
+                }
+                launch(TB, scratch.data_ptr<scalar_t>(),
+                       arg_out.has_value() ? scratch_arg.data_ptr<index_t>()
+                                           : nullptr,
+                       nullptr);
+              };
+              auto TB = autotune(SEGMENT_CSR_AUTOTUNE, key, {1, 32}, 1, run);
+              launch(TB, out_data, arg_out_data, merge_path_data);
+            } else {
+              auto vec = vec_size<scalar_t>(K, {src_data, out_data});
+              AT_DISPATCH_VEC_SIZES(scalar_t, vec, [&] {
+                segment_csr_broadcast_kernel<scalar_t, REDUCE, VEC, index_t,
+                                             offset_t>
+                    <<<BLOCKS(1, N * (K / VEC)), THREADS, 0, stream>>>(
+                        src_data, indptr_info, weight_data, out_data,
+                        arg_out_data, N, K, E, merge_path_data);
+              });
+            }
+          });
+        }
+      });
     });
   });
 
   return std::make_tuple(out, arg_out);
 }
 
-template <typename scalar_t, int TB>
-__global__ void
-gather_csr_kernel(const scalar_t *src_data,
-                  const at::cuda::detail::TensorInfo<int64_t, int> indptr_info,
-                  scalar_t *out_data, size_t N, size_t E) {
+template <typename scalar_t, int TB, typename index_t, typename offset_t>
+__global__ void gather_csr_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    scalar_t *out_data, offset_t N, offset_t E) {
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int row_idx = thread_idx / TB;
-  int lane_idx = thread_idx % TB;
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / TB;
+  offset_t lane_idx = thread_idx % TB;
 
   if (row_idx < N) {
-    int offset = IndexPtrToOffset<int64_t>::get(row_idx, indptr_info);
-    int row_start = __ldg(indptr_info.data + offset);
-    int row_end = __ldg(indptr_info.data + offset +
-                        indptr_info.strides[indptr_info.dims - 1]);
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
+    int64_t row_start = __ldg(indptr_info.data + offset);
+    int64_t row_end = __ldg(indptr_info.data + offset +
+                            indptr_info.strides[indptr_info.dims - 1]);
     scalar_t val = __ldg(src_data + row_idx);
 
     offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E;
-    for (int out_idx = row_start + lane_idx; out_idx < row_end; out_idx += TB) {
+    for (int64_t out_idx = row_start + lane_idx; out_idx < row_end;
+         out_idx += TB) {
       out_data[offset + out_idx] = val; // "Mostly" coalesced.
     }
   }
 }
 
-template <typename scalar_t>
+template <typename scalar_t, int VEC, typename index_t, typename offset_t>
 __global__ void gather_csr_broadcast_kernel(
     const scalar_t *src_data,
-    const at::cuda::detail::TensorInfo<int64_t, int> indptr_info,
-    scalar_t *out_data, size_t N, size_t K, size_t E) {
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    scalar_t *out_data, offset_t N, offset_t K, offset_t E) {
 
-  int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-  int row_idx = thread_idx / K;
-  int lane_idx = thread_idx % K;
+  // Each thread copies `VEC` consecutive columns of a single row.
 
-  if (thread_idx < N * K) {
-    int offset = IndexPtrToOffset<int64_t>::get(row_idx, indptr_info);
-    int row_start = __ldg(indptr_info.data + offset);
-    int row_end = __ldg(indptr_info.data + offset +
-                        indptr_info.strides[indptr_info.dims - 1]);
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (K / VEC);
+  offset_t lane_idx = (thread_idx % (K / VEC)) * VEC;
+
+  if (thread_idx < N * (K / VEC)) {
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
+    int64_t row_start = __ldg(indptr_info.data + offset);
+    int64_t row_end = __ldg(indptr_info.data + offset +
+                            indptr_info.strides[indptr_info.dims - 1]);
 
-    scalar_t val = src_data[thread_idx]; // Coalesced.
+    auto val = load_vec<scalar_t, VEC>(src_data + thread_idx * VEC);
 
     offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E * K;
-    for (int out_idx = row_start; out_idx < row_end; out_idx++) {
-      out_data[offset + K * out_idx + lane_idx] = val; // "Mostly" coalesced.
+    for (int64_t out_idx = row_start; out_idx < row_end; out_idx++) {
+      // "Mostly" coalesced.
+      store_vec<scalar_t, VEC>(out_data + offset + K * out_idx + lane_idx,
+                               val);
     }
   }
 }
@@ -222,7 +566,7 @@ torch::Tensor gather_csr_cuda(torch::Tensor src, torch::Tensor indptr,
   CHECK_CUDA(indptr);
   if (optional_out.has_value())
     CHECK_CUDA(optional_out.value());
-  cudaSetDevice(src.get_device());
+  const c10::cuda::CUDAGuard device_guard(src.device());
 
   CHECK_INPUT(src.dim() >= indptr.dim());
 
@@ -245,7 +589,12 @@ torch::Tensor gather_csr_cuda(torch::Tensor src, torch::Tensor indptr,
   } else {
     auto sizes = src.sizes().vec();
     if (src.numel() > 0) {
-      sizes[dim] = indptr.flatten()[-1].cpu().data_ptr<int64_t>()[0];
+      auto size = sync_item(indptr, GATHER_CSR_SIZE,
+                            [&] { return indptr.flatten()[-1]; });
+      AT_ASSERTM(size.has_value(), "Inferring the output size of gather_csr ",
+                 "requires a host-device sync. Please pass `out` explicitly ",
+                 "instead.");
+      sizes[dim] = size.value();
     } else {
       sizes[dim] = 0;
     }
@@ -262,20 +611,927 @@ torch::Tensor gather_csr_cuda(torch::Tensor src, torch::Tensor indptr,
   auto K = src.numel() / N;
   auto E = out.size(dim);
 
-  auto indptr_info = at::cuda::detail::getTensorInfo<int64_t, int>(indptr);
+  auto use_64bit = use_64bit_offsets({src, indptr, out});
   auto stream = at::cuda::getCurrentCUDAStream();
-  AT_DISPATCH_ALL_TYPES_AND(at::ScalarType::Half, src.scalar_type(), "_", [&] {
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
     auto src_data = src.data_ptr<scalar_t>();
     auto out_data = out.data_ptr<scalar_t>();
 
-    if (K == 1)
-      gather_csr_kernel<scalar_t, 4><<<BLOCKS(1, 4 * N), THREADS, 0, stream>>>(
-          src_data, indptr_info, out_data, N, E);
-    else
-      gather_csr_broadcast_kernel<scalar_t>
-          <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(src_data, indptr_info,
-                                                     out_data, N, K, E);
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+        auto indptr_info =
+            at::cuda::detail::getTensorInfo<index_t, offset_t>(indptr);
+
+        if (K == 1)
+          gather_csr_kernel<scalar_t, 4, index_t, offset_t>
+              <<<BLOCKS(1, 4 * N), THREADS, 0, stream>>>(
+                  src_data, indptr_info, out_data, N, E);
+        else {
+          auto vec = vec_size<scalar_t>(K, {src_data, out_data});
+          AT_DISPATCH_VEC_SIZES(scalar_t, vec, [&] {
+            gather_csr_broadcast_kernel<scalar_t, VEC, index_t, offset_t>
+                <<<BLOCKS(1, N * (K / VEC)), THREADS, 0, stream>>>(
+                    src_data, indptr_info, out_data, N, K, E);
+          });
+        }
+      });
+    });
   });
 
   return out;
 }
+
+template <typename scalar_t, ReductionType REDUCE, int TB, typename index_t>
+__global__ void segment_csr_gather_kernel(
+    const scalar_t *src_data, const index_t *indptr_data,
+    const index_t *col_data, const scalar_t *weight_data, scalar_t *out_data,
+    index_t *arg_out_data, int64_t N, int64_t E) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each row is processed by `TB` lanes, which read the source entries of
+  // their edges directly via `col` and aggregate them via a parallel
+  // reduction.
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+  int64_t row_idx = thread_idx / TB;
+  int64_t lane_idx = thread_idx & (TB - 1);
+
+  if (row_idx < N) {
+    int64_t row_start = __ldg(indptr_data + row_idx);
+    int64_t row_end = __ldg(indptr_data + row_idx + 1);
+
+    acc_t val = Reducer<acc_t, REDUCE>::init(), tmp;
+    int64_t arg = E, arg_tmp;
+
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB) {
+      tmp = src_data[__ldg(col_data + e)];
+      if (weight_data != nullptr)
+        tmp = (acc_t)weight_data[e] * tmp;
+      Reducer<acc_t, REDUCE>::update(&val, tmp, &arg, e);
+    }
+
+#pragma unroll
+    for (int i = TB / 2; i > 0; i /= 2) {
+      // Parallel reduction inside a single warp.
+      if (REDUCE == MIN || REDUCE == MAX)
+        arg_tmp = __shfl_down_sync(FULL_MASK, arg, i);
+      Reducer<acc_t, REDUCE>::update(
+          &val, __shfl_down_sync(FULL_MASK, val, i), &arg, arg_tmp);
+    }
+
+    if (lane_idx == 0) {
+      Reducer<acc_t, REDUCE>::write(out_data + row_idx, val,
+                                    arg_out_data + row_idx, arg,
+                                    row_end - row_start);
+    }
+  }
+}
+
+template <typename scalar_t, ReductionType REDUCE, typename index_t>
+__global__ void segment_csr_gather_broadcast_kernel(
+    const scalar_t *src_data, const index_t *indptr_data,
+    const index_t *col_data, const scalar_t *weight_data, scalar_t *out_data,
+    index_t *arg_out_data, int64_t N, int64_t K, int64_t E) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each thread processes exactly one column of a row, such that reading
+  // the gathered source rows is coalesced.
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+  int64_t row_idx = thread_idx / K;
+  int64_t lane_idx = thread_idx % K;
+
+  if (thread_idx < N * K) {
+    int64_t row_start = __ldg(indptr_data + row_idx);
+    int64_t row_end = __ldg(indptr_data + row_idx + 1);
+
+    acc_t val = Reducer<acc_t, REDUCE>::init(), tmp;
+    int64_t arg = E;
+
+    for (int64_t e = row_start; e < row_end; e++) {
+      tmp = src_data[K * __ldg(col_data + e) + lane_idx];
+      if (weight_data != nullptr)
+        tmp = (acc_t)weight_data[e] * tmp;
+      Reducer<acc_t, REDUCE>::update(&val, tmp, &arg, e);
+    }
+
+    Reducer<acc_t, REDUCE>::write(out_data + thread_idx, val,
+                                  arg_out_data + thread_idx, arg,
+                                  row_end - row_start);
+  }
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_csr_gather_cuda(torch::Tensor src, torch::Tensor indptr,
+                        torch::Tensor col,
+                        torch::optional<torch::Tensor> optional_weight,
+                        std::string reduce) {
+  CHECK_CUDA(src);
+  CHECK_CUDA(indptr);
+  CHECK_CUDA(col);
+  if (optional_weight.has_value())
+    CHECK_CUDA(optional_weight.value());
+  const c10::cuda::CUDAGuard device_guard(src.device());
+
+  CHECK_INPUT(src.dim() >= 1);
+  CHECK_INPUT(indptr.dim() == 1);
+  CHECK_INPUT(col.dim() == 1);
+  CHECK_INPUT(indptr.scalar_type() == col.scalar_type());
+  if (optional_weight.has_value()) {
+    CHECK_INPUT(optional_weight.value().dim() == 1);
+    CHECK_INPUT(optional_weight.value().numel() == col.numel());
+    CHECK_INPUT(optional_weight.value().scalar_type() == src.scalar_type());
+  }
+
+  src = src.contiguous();
+  indptr = indptr.contiguous();
+  col = col.contiguous();
+
+  auto sizes = src.sizes().vec();
+  sizes[0] = std::max<int64_t>(indptr.numel() - 1, 0);
+  auto out = torch::empty(sizes, src.options());
+
+  torch::optional<torch::Tensor> arg_out = torch::nullopt;
+  if (reduce2REDUCE.at(reduce) == MIN || reduce2REDUCE.at(reduce) == MAX)
+    arg_out = torch::empty(out.sizes(), col.options());
+
+  if (out.numel() == 0)
+    return std::make_tuple(out, arg_out);
+
+  if (col.numel() == 0) {
+    out.fill_(0);
+    if (arg_out.has_value())
+      arg_out.value().fill_(0);
+    return std::make_tuple(out, arg_out);
+  }
+
+  auto N = out.size(0);
+  auto K = out.numel() / N;
+  auto E = col.numel();
+
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+
+    torch::Tensor weight;
+    scalar_t *weight_data = nullptr;
+    if (optional_weight.has_value()) {
+      weight = optional_weight.value().contiguous();
+      weight_data = weight.data_ptr<scalar_t>();
+    }
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      auto indptr_data = indptr.data_ptr<index_t>();
+      auto col_data = col.data_ptr<index_t>();
+      index_t *arg_out_data = nullptr;
+      if (arg_out.has_value())
+        arg_out_data = arg_out.value().data_ptr<index_t>();
+
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        if (K == 1)
+          segment_csr_gather_kernel<scalar_t, REDUCE, 4, index_t>
+              <<<BLOCKS(4, N), THREADS, 0, stream>>>(
+                  src_data, indptr_data, col_data, weight_data, out_data,
+                  arg_out_data, N, E);
+        else
+          segment_csr_gather_broadcast_kernel<scalar_t, REDUCE, index_t>
+              <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(
+                  src_data, indptr_data, col_data, weight_data, out_data,
+                  arg_out_data, N, K, E);
+      });
+    });
+  });
+
+  return std::make_tuple(out, arg_out);
+}
+
+template <typename scalar_t, typename index_t>
+__global__ void sddmm_csr_kernel(const scalar_t *a_data,
+                                 const index_t *indptr_data,
+                                 const index_t *col_data,
+                                 const scalar_t *b_data, scalar_t *out_data,
+                                 int64_t N, int64_t E, int64_t K) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each warp computes the dot product of a single edge. The row of an edge
+  // is found via binary search, which avoids materializing it.
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+  int64_t e = thread_idx / 32;
+  int64_t lane_idx = thread_idx & (32 - 1);
+
+  if (e < E) {
+    int64_t lo = 0, hi = N, mid;
+    while (lo < hi) {
+      mid = (lo + hi) >> 1;
+      if (__ldg(indptr_data + mid + 1) <= e)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    int64_t c = __ldg(col_data + e);
+
+    acc_t val = (acc_t)0;
+    for (int64_t k = lane_idx; k < K; k += 32)
+      val += (acc_t)a_data[lo * K + k] * (acc_t)b_data[c * K + k];
+
+#pragma unroll
+    for (int i = 32 / 2; i > 0; i /= 2)
+      val += __shfl_down_sync(FULL_MASK, val, i);
+
+    if (lane_idx == 0)
+      out_data[e] = (scalar_t)val;
+  }
+}
+
+torch::Tensor sddmm_csr_cuda(torch::Tensor a, torch::Tensor indptr,
+                             torch::Tensor col, torch::Tensor b) {
+  CHECK_CUDA(a);
+  CHECK_CUDA(indptr);
+  CHECK_CUDA(col);
+  CHECK_CUDA(b);
+  const c10::cuda::CUDAGuard device_guard(a.device());
+
+  CHECK_INPUT(indptr.dim() == 1 && col.dim() == 1);
+  CHECK_INPUT(indptr.scalar_type() == col.scalar_type());
+  CHECK_INPUT(a.size(0) == indptr.numel() - 1);
+  CHECK_INPUT(a.numel() / std::max<int64_t>(a.size(0), 1) ==
+              b.numel() / std::max<int64_t>(b.size(0), 1));
+
+  a = a.contiguous();
+  b = b.contiguous();
+  indptr = indptr.contiguous();
+  col = col.contiguous();
+
+  auto out = torch::empty({col.numel()}, a.options());
+  if (col.numel() == 0 || a.numel() == 0)
+    return out.fill_(0);
+
+  auto N = a.size(0);
+  auto E = col.numel();
+  auto K = a.numel() / N;
+
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_TYPES(a.scalar_type(), "_", [&] {
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      sddmm_csr_kernel<scalar_t, index_t>
+          <<<BLOCKS(32, E), THREADS, 0, stream>>>(
+              a.data_ptr<scalar_t>(), indptr.data_ptr<index_t>(),
+              col.data_ptr<index_t>(), b.data_ptr<scalar_t>(),
+              out.data_ptr<scalar_t>(), N, E, K);
+    });
+  });
+
+  return out;
+}
+
+template <typename scalar_t, bool LOG, int TB, typename index_t,
+          typename offset_t>
+__global__ void segment_softmax_csr_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    scalar_t *out_data, offset_t N, offset_t K, offset_t E) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each group of `TB` threads processes one (row, k) pair. The maximum and
+  // the sum of exponentials are tracked online in registers and merged across
+  // the group via warp shuffles, such that `out` only gets written once.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (TB * K);
+  offset_t k = (thread_idx / TB) % K;
+  offset_t lane_idx = thread_idx & (TB - 1);
+
+  if (row_idx < N) {
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
+    int64_t row_start = __ldg(indptr_info.data + offset);
+    int64_t row_end = __ldg(indptr_info.data + offset +
+                            indptr_info.strides[indptr_info.dims - 1]);
+
+    offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E * K;
+    offset += k;
+
+    acc_t max = -std::numeric_limits<acc_t>::infinity(), sum = (acc_t)0;
+    acc_t val, tmp_max, tmp_sum;
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB) {
+      val = (acc_t)src_data[offset + e * K];
+      if (val > max) {
+        sum = sum * ::exp(max - val) + (acc_t)1;
+        max = val;
+      } else
+        sum += ::exp(val - max);
+    }
+
+#pragma unroll
+    for (int i = TB / 2; i > 0; i /= 2) {
+      // Parallel reduction of (max, sum) pairs inside a single warp.
+      tmp_max = __shfl_down_sync(FULL_MASK, max, i);
+      tmp_sum = __shfl_down_sync(FULL_MASK, sum, i);
+      if (tmp_max > max) {
+        sum = sum * ::exp(max - tmp_max) + tmp_sum;
+        max = tmp_max;
+      } else if (tmp_sum > (acc_t)0)
+        sum += tmp_sum * ::exp(tmp_max - max);
+    }
+    if (TB > 1) {
+      max = __shfl_sync(FULL_MASK, max, 0, TB);
+      sum = __shfl_sync(FULL_MASK, sum, 0, TB);
+    }
+
+    if (LOG)
+      max += ::log(sum);
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB) {
+      val = (acc_t)src_data[offset + e * K] - max;
+      out_data[offset + e * K] = (scalar_t)(LOG ? val : ::exp(val) / sum);
+    }
+  }
+}
+
+template <typename scalar_t, bool LOG, int TB, typename index_t,
+          typename offset_t>
+__global__ void segment_softmax_csr_backward_kernel(
+    const scalar_t *out_data, const scalar_t *grad_out_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    scalar_t *grad_in_data, offset_t N, offset_t K, offset_t E) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // The gradient of softmax `y` is given by `y * (grad - sum(grad * y))`, and
+  // the one of log-softmax `y` by `grad - exp(y) * sum(grad)`.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (TB * K);
+  offset_t k = (thread_idx / TB) % K;
+  offset_t lane_idx = thread_idx & (TB - 1);
+
+  if (row_idx < N) {
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
+    int64_t row_start = __ldg(indptr_info.data + offset);
+    int64_t row_end = __ldg(indptr_info.data + offset +
+                            indptr_info.strides[indptr_info.dims - 1]);
+
+    offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E * K;
+    offset += k;
+
+    acc_t dot = (acc_t)0, grad, y;
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB) {
+      grad = (acc_t)grad_out_data[offset + e * K];
+      dot += LOG ? grad : grad * (acc_t)out_data[offset + e * K];
+    }
+
+#pragma unroll
+    for (int i = TB / 2; i > 0; i /= 2)
+      dot += __shfl_down_sync(FULL_MASK, dot, i);
+    if (TB > 1)
+      dot = __shfl_sync(FULL_MASK, dot, 0, TB);
+
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB) {
+      y = (acc_t)out_data[offset + e * K];
+      grad = (acc_t)grad_out_data[offset + e * K];
+      grad_in_data[offset + e * K] =
+          (scalar_t)(LOG ? grad - ::exp(y) * dot : y * (grad - dot));
+    }
+  }
+}
+
+torch::Tensor segment_softmax_csr_cuda(torch::Tensor src, torch::Tensor indptr,
+                                       bool log) {
+  CHECK_CUDA(src);
+  CHECK_CUDA(indptr);
+  const c10::cuda::CUDAGuard device_guard(src.device());
+
+  CHECK_INPUT(src.dim() >= indptr.dim());
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = src.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  src = src.contiguous();
+
+  // Every entry of `src` is expected to belong to exactly one segment, such
+  // that `out` gets fully written without any prior initialization.
+  auto out = torch::empty_like(src);
+  if (src.numel() == 0 || indptr.size(dim) <= 1)
+    return out;
+
+  auto N = (indptr.size(dim) - 1) * (indptr.numel() / indptr.size(-1));
+  auto E = src.size(dim);
+  auto K = src.numel() / (E * (indptr.numel() / indptr.size(-1)));
+
+  auto use_64bit = use_64bit_offsets({src, indptr});
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      AT_DISPATCH_SOFTMAX_LOG(log, [&] {
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto indptr_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(indptr);
+          if (K == 1)
+            segment_softmax_csr_kernel<scalar_t, LOG, 32, index_t, offset_t>
+                <<<BLOCKS(32, N), THREADS, 0, stream>>>(
+                    src_data, indptr_info, out_data, N, K, E);
+          else
+            segment_softmax_csr_kernel<scalar_t, LOG, 1, index_t, offset_t>
+                <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(
+                    src_data, indptr_info, out_data, N, K, E);
+        });
+      });
+    });
+  });
+
+  return out;
+}
+
+torch::Tensor segment_softmax_csr_backward_cuda(torch::Tensor out,
+                                                torch::Tensor grad_out,
+                                                torch::Tensor indptr,
+                                                bool log) {
+  CHECK_CUDA(out);
+  CHECK_CUDA(grad_out);
+  CHECK_CUDA(indptr);
+  const c10::cuda::CUDAGuard device_guard(out.device());
+
+  CHECK_INPUT(out.sizes() == grad_out.sizes());
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = out.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  out = out.contiguous();
+  grad_out = grad_out.contiguous();
+
+  auto grad_in = torch::empty_like(out);
+  if (out.numel() == 0 || indptr.size(dim) <= 1)
+    return grad_in;
+
+  auto N = (indptr.size(dim) - 1) * (indptr.numel() / indptr.size(-1));
+  auto E = out.size(dim);
+  auto K = out.numel() / (E * (indptr.numel() / indptr.size(-1)));
+
+  auto use_64bit = use_64bit_offsets({out, indptr});
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(out.scalar_type(), "_", [&] {
+    auto out_data = out.data_ptr<scalar_t>();
+    auto grad_out_data = grad_out.data_ptr<scalar_t>();
+    auto grad_in_data = grad_in.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      AT_DISPATCH_SOFTMAX_LOG(log, [&] {
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto indptr_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(indptr);
+          if (K == 1)
+            segment_softmax_csr_backward_kernel<scalar_t, LOG, 32, index_t,
+                                                offset_t>
+                <<<BLOCKS(32, N), THREADS, 0, stream>>>(
+                    out_data, grad_out_data, indptr_info, grad_in_data, N, K,
+                    E);
+          else
+            segment_softmax_csr_backward_kernel<scalar_t, LOG, 1, index_t,
+                                                offset_t>
+                <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(
+                    out_data, grad_out_data, indptr_info, grad_in_data, N, K,
+                    E);
+        });
+      });
+    });
+  });
+
+  return grad_in;
+}
+
+template <typename scalar_t, ReductionType REDUCE, int TB, typename index_t,
+          typename offset_t>
+__global__ void segment_stat_csr_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    scalar_t *out_data, scalar_t *mean_data, bool unbiased, offset_t N,
+    offset_t K, offset_t E) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each group of `TB` threads reduces one (row, k) pair in a single pass by
+  // keeping a `Welford` (for VAR/STD) or a `LogSumExp` (for LOGSUMEXP) state,
+  // which are merged across the group via warp shuffles.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (TB * K);
+  offset_t k = (thread_idx / TB) % K;
+  offset_t lane_idx = thread_idx & (TB - 1);
+
+  if (row_idx < N) {
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
+    int64_t row_start = __ldg(indptr_info.data + offset);
+    int64_t row_end = __ldg(indptr_info.data + offset +
+                            indptr_info.strides[indptr_info.dims - 1]);
+
+    offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E * K;
+    offset += k;
+
+    Welford<acc_t> welford;
+    LogSumExp<acc_t> lse;
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB) {
+      if (REDUCE == LOGSUMEXP)
+        lse.update((acc_t)src_data[offset + e * K]);
+      else
+        welford.update((acc_t)src_data[offset + e * K]);
+    }
+
+#pragma unroll
+    for (int i = TB / 2; i > 0; i /= 2) {
+      // Parallel reduction of partial states inside a single warp.
+      if (REDUCE == LOGSUMEXP)
+        lse.merge(__shfl_down_sync(FULL_MASK, lse.max, i),
+                  __shfl_down_sync(FULL_MASK, lse.sum, i));
+      else
+        welford.merge(__shfl_down_sync(FULL_MASK, welford.count, i),
+                      __shfl_down_sync(FULL_MASK, welford.mean, i),
+                      __shfl_down_sync(FULL_MASK, welford.m2, i));
+    }
+
+    if (lane_idx == 0) {
+      offset_t out_idx = row_idx * K + k;
+      if (REDUCE == LOGSUMEXP)
+        out_data[out_idx] = (scalar_t)lse.value();
+      else {
+        acc_t var = welford.var(unbiased);
+        out_data[out_idx] = (scalar_t)(REDUCE == STD ? ::sqrt(var) : var);
+        mean_data[out_idx] = (scalar_t)welford.mean;
+      }
+    }
+  }
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_stat_csr_cuda(torch::Tensor src, torch::Tensor indptr,
+                      std::string reduce, bool unbiased) {
+  CHECK_CUDA(src);
+  CHECK_CUDA(indptr);
+  const c10::cuda::CUDAGuard device_guard(src.device());
+
+  CHECK_INPUT(src.dim() >= indptr.dim());
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = src.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  src = src.contiguous();
+
+  sizes = src.sizes().vec();
+  sizes[dim] = std::max<int64_t>(indptr.size(dim) - 1, 0);
+  auto out = torch::empty(sizes, src.options());
+
+  // For VAR and STD, `mean` holds the mean of each segment for backward.
+  torch::optional<torch::Tensor> mean = torch::nullopt;
+  if (stat2REDUCE.at(reduce) != LOGSUMEXP)
+    mean = torch::empty(sizes, src.options());
+
+  if (src.numel() == 0 || out.numel() == 0) {
+    if (stat2REDUCE.at(reduce) == LOGSUMEXP)
+      out.fill_(-std::numeric_limits<double>::infinity());
+    else {
+      out.fill_(0);
+      mean.value().fill_(0);
+    }
+    return std::make_tuple(out, mean);
+  }
+
+  auto N = out.size(dim) * (indptr.numel() / indptr.size(-1));
+  auto K = out.numel() / N;
+  auto E = src.size(dim);
+
+  auto use_64bit = use_64bit_offsets({src, indptr, out});
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *mean_data = nullptr;
+    if (mean.has_value())
+      mean_data = mean.value().data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      AT_DISPATCH_STAT_TYPES(reduce, [&] {
+        AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+          auto indptr_info =
+              at::cuda::detail::getTensorInfo<index_t, offset_t>(indptr);
+          if (K == 1)
+            segment_stat_csr_kernel<scalar_t, REDUCE, 32, index_t, offset_t>
+                <<<BLOCKS(32, N), THREADS, 0, stream>>>(
+                    src_data, indptr_info, out_data, mean_data, unbiased, N,
+                    K, E);
+          else
+            segment_stat_csr_kernel<scalar_t, REDUCE, 1, index_t, offset_t>
+                <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(
+                    src_data, indptr_info, out_data, mean_data, unbiased, N,
+                    K, E);
+        });
+      });
+    });
+  });
+
+  return std::make_tuple(out, mean);
+}
+
+template <typename scalar_t, int TB, typename index_t, typename offset_t>
+__global__ void segment_csr_multi_kernel(
+    const scalar_t *src_data,
+    const at::cuda::detail::TensorInfo<index_t, offset_t> indptr_info,
+    scalar_t *out_data, scalar_t *mean_data, index_t *arg_out_data,
+    const MultiReduce multi, bool unbiased, offset_t N, offset_t K,
+    offset_t E) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each group of `TB` threads reduces one (row, k) pair by keeping the state
+  // of all requested reductions, such that `src` is only read once.
+
+  offset_t thread_idx = (offset_t)blockIdx.x * blockDim.x + threadIdx.x;
+  offset_t row_idx = thread_idx / (TB * K);
+  offset_t k = (thread_idx / TB) % K;
+  offset_t lane_idx = thread_idx & (TB - 1);
+
+  if (row_idx < N) {
+    offset_t offset =
+        IndexPtrToOffset<index_t, offset_t>::get(row_idx, indptr_info);
+    int64_t row_start = __ldg(indptr_info.data + offset);
+    int64_t row_end = __ldg(indptr_info.data + offset +
+                            indptr_info.strides[indptr_info.dims - 1]);
+
+    offset = (row_idx / (indptr_info.sizes[indptr_info.dims - 1] - 1)) * E * K;
+    offset += k;
+
+    MultiReducer<acc_t> val(E);
+    for (int64_t e = row_start + lane_idx; e < row_end; e += TB)
+      val.update((acc_t)src_data[offset + e * K], e);
+
+#pragma unroll
+    for (int i = TB / 2; i > 0; i /= 2) {
+      // Parallel reduction of partial states inside a single warp.
+      val.merge(__shfl_down_sync(FULL_MASK, val.sum, i),
+                __shfl_down_sync(FULL_MASK, val.min, i),
+                __shfl_down_sync(FULL_MASK, val.arg_min, i),
+                __shfl_down_sync(FULL_MASK, val.max, i),
+                __shfl_down_sync(FULL_MASK, val.arg_max, i),
+                __shfl_down_sync(FULL_MASK, val.welford.count, i),
+                __shfl_down_sync(FULL_MASK, val.welford.mean, i),
+                __shfl_down_sync(FULL_MASK, val.welford.m2, i));
+    }
+
+    if (lane_idx == 0) {
+      offset_t out_idx = row_idx * K + k;
+      for (int r = 0; r < multi.num; r++) {
+        auto reduce = multi.reduces[r];
+        out_data[r * N * K + out_idx] = (scalar_t)val.value(reduce, unbiased);
+        if (row_end > row_start && (reduce == MIN || reduce == MAX))
+          arg_out_data[r * N * K + out_idx] =
+              (index_t)(reduce == MIN ? val.arg_min : val.arg_max);
+      }
+      if (mean_data != nullptr)
+        mean_data[out_idx] = (scalar_t)val.welford.mean;
+    }
+  }
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>,
+           torch::optional<torch::Tensor>>
+segment_csr_multi_cuda(torch::Tensor src, torch::Tensor indptr,
+                       std::vector<std::string> reduces, bool unbiased) {
+  CHECK_CUDA(src);
+  CHECK_CUDA(indptr);
+  const c10::cuda::CUDAGuard device_guard(src.device());
+
+  CHECK_INPUT(src.dim() >= indptr.dim());
+
+  auto multi = getMultiReduce(reduces);
+
+  auto sizes = indptr.sizes().vec();
+  for (auto i = 0; i < indptr.dim() - 1; i++)
+    sizes[i] = src.size(i);
+  indptr = indptr.expand(sizes);
+
+  auto dim = indptr.dim() - 1;
+
+  src = src.contiguous();
+
+  // All outputs are stacked along a new leading dimension in the order given
+  // by `reduces`.
+  sizes = src.sizes().vec();
+  sizes[dim] = std::max<int64_t>(indptr.size(dim) - 1, 0);
+  sizes.insert(sizes.begin(), multi.num);
+  auto out = torch::empty(sizes, src.options());
+
+  // For VAR and STD, `mean` holds the mean of each segment for backward.
+  torch::optional<torch::Tensor> mean = torch::nullopt;
+  if (multi.has(VAR) || multi.has(STD))
+    mean = torch::zeros(out[0].sizes(), src.options());
+
+  // Arguments are only written for MIN and MAX, and point to `src.size(dim)`
+  // otherwise.
+  torch::optional<torch::Tensor> arg_out = torch::nullopt;
+  if (multi.has(MIN) || multi.has(MAX))
+    arg_out = torch::full(out.sizes(), src.size(dim), indptr.options());
+
+  if (src.numel() == 0 || out.numel() == 0) {
+    out.fill_(0);
+    return std::make_tuple(out, mean, arg_out);
+  }
+
+  auto N = out.size(dim + 1) * (indptr.numel() / indptr.size(-1));
+  auto K = out[0].numel() / N;
+  auto E = src.size(dim);
+
+  auto use_64bit = use_64bit_offsets({src, indptr, out});
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_FLOATING_TYPES(src.scalar_type(), "_", [&] {
+    auto src_data = src.data_ptr<scalar_t>();
+    auto out_data = out.data_ptr<scalar_t>();
+    scalar_t *mean_data = nullptr;
+    if (mean.has_value())
+      mean_data = mean.value().data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(indptr.scalar_type(), "_", [&] {
+      index_t *arg_out_data = nullptr;
+      if (arg_out.has_value())
+        arg_out_data = arg_out.value().data_ptr<index_t>();
+
+      AT_DISPATCH_OFFSET_TYPES(use_64bit, [&] {
+        auto indptr_info =
+            at::cuda::detail::getTensorInfo<index_t, offset_t>(indptr);
+        if (K == 1)
+          segment_csr_multi_kernel<scalar_t, 32, index_t, offset_t>
+              <<<BLOCKS(32, N), THREADS, 0, stream>>>(
+                  src_data, indptr_info, out_data, mean_data, arg_out_data,
+                  multi, unbiased, N, K, E);
+        else
+          segment_csr_multi_kernel<scalar_t, 1, index_t, offset_t>
+              <<<BLOCKS(1, N * K), THREADS, 0, stream>>>(
+                  src_data, indptr_info, out_data, mean_data, arg_out_data,
+                  multi, unbiased, N, K, E);
+      });
+    });
+  });
+
+  return std::make_tuple(out, mean, arg_out);
+}
+
+// Describes a single problem of `segment_csr_batched`, which reduces the
+// `[E, K]` entries of `src` into the `N * K` values of the shared output
+// starting at `offset`.
+template <typename scalar_t, typename index_t> struct BatchedCSRProblem {
+  const scalar_t *src_data;
+  const index_t *indptr_data;
+  int64_t offset, N, K, E;
+};
+
+template <typename scalar_t, ReductionType REDUCE, typename index_t>
+__global__ void segment_csr_batched_kernel(
+    const BatchedCSRProblem<scalar_t, index_t> *problems, int64_t P,
+    scalar_t *out_data, int64_t numel) {
+
+  using acc_t = typename AccType<scalar_t>::type;
+
+  // Each thread processes a single column of a single row, and finds its
+  // problem via binary search over the (ascending) output offsets. Arguments
+  // of MIN and MAX are not written, since only values get returned.
+
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  if (thread_idx < numel) {
+    int64_t lo = 0, hi = P - 1, mid;
+    while (lo < hi) {
+      mid = (lo + hi + 1) / 2;
+      if (problems[mid].offset <= thread_idx)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    const auto problem = problems[lo];
+
+    auto K = problem.K;
+    int64_t row_idx = (thread_idx - problem.offset) / K;
+    int64_t lane_idx = (thread_idx - problem.offset) % K;
+    int64_t row_start = __ldg(problem.indptr_data + row_idx);
+    int64_t row_end = __ldg(problem.indptr_data + row_idx + 1);
+
+    acc_t val = Reducer<acc_t, REDUCE>::init();
+    int64_t arg = problem.E;
+    for (int64_t src_idx = row_start; src_idx < row_end; src_idx++) {
+      Reducer<acc_t, REDUCE>::update(
+          &val, problem.src_data[K * src_idx + lane_idx], &arg, src_idx);
+    }
+
+    Reducer<acc_t, REDUCE>::write(out_data + thread_idx, val,
+                                  (index_t *)nullptr, arg,
+                                  row_end - row_start);
+  }
+}
+
+std::vector<torch::Tensor>
+segment_csr_batched_cuda(std::vector<torch::Tensor> srcs,
+                         std::vector<torch::Tensor> indptrs,
+                         std::string reduce) {
+  CHECK_INPUT(srcs.size() == indptrs.size());
+  if (srcs.size() == 0)
+    return {};
+  const c10::cuda::CUDAGuard device_guard(srcs[0].device());
+
+  // All outputs are views into a single allocation, in problem order.
+  std::vector<std::vector<int64_t>> sizes;
+  std::vector<int64_t> offsets = {0};
+  int64_t numel = 0;
+  for (size_t i = 0; i < srcs.size(); i++) {
+    CHECK_CUDA(srcs[i]);
+    CHECK_CUDA(indptrs[i]);
+    CHECK_INPUT(srcs[i].dim() >= 1 && indptrs[i].dim() == 1);
+    CHECK_INPUT(srcs[i].device() == srcs[0].device());
+    CHECK_INPUT(indptrs[i].device() == srcs[0].device());
+    CHECK_INPUT(srcs[i].scalar_type() == srcs[0].scalar_type());
+    CHECK_INPUT(indptrs[i].scalar_type() == indptrs[0].scalar_type());
+    srcs[i] = srcs[i].contiguous();
+    indptrs[i] = indptrs[i].contiguous();
+
+    auto size = srcs[i].sizes().vec();
+    size[0] = std::max<int64_t>(indptrs[i].numel() - 1, 0);
+    int64_t size_numel = 1;
+    for (auto s : size)
+      size_numel *= s;
+    sizes.push_back(size);
+    numel += size_numel;
+    offsets.push_back(numel);
+  }
+
+  auto out = torch::empty({numel}, srcs[0].options());
+  std::vector<torch::Tensor> outs;
+  for (size_t i = 0; i < srcs.size(); i++)
+    outs.push_back(out.narrow(0, offsets[i], offsets[i + 1] - offsets[i])
+                       .view(sizes[i]));
+
+  if (numel == 0)
+    return outs;
+
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_TYPES(out.scalar_type(), "_", [&] {
+    AT_DISPATCH_INDEX_TYPES(indptrs[0].scalar_type(), "_", [&] {
+      using problem_t = BatchedCSRProblem<scalar_t, index_t>;
+
+      // Problems without any output are skipped, such that each thread
+      // belongs to exactly one problem.
+      std::vector<problem_t> problems;
+      for (size_t i = 0; i < srcs.size(); i++) {
+        if (outs[i].numel() == 0)
+          continue;
+        problem_t problem;
+        problem.src_data = srcs[i].data_ptr<scalar_t>();
+        problem.indptr_data = indptrs[i].data_ptr<index_t>();
+        problem.offset = offsets[i];
+        problem.N = sizes[i][0];
+        problem.K = outs[i].numel() / sizes[i][0];
+        problem.E = srcs[i].size(0);
+        problems.push_back(problem);
+      }
+
+      // Descriptors are staged in pinned memory, whose caching allocator
+      // keeps the buffer alive until the asynchronous copy has finished.
+      int64_t bytes = problems.size() * sizeof(problem_t);
+      auto staging = torch::empty(
+          {bytes}, torch::dtype(torch::kUInt8).pinned_memory(true));
+      std::memcpy(staging.data_ptr(), problems.data(), bytes);
+      auto descriptors = staging.to(out.device(), /*non_blocking=*/true);
+
+      AT_DISPATCH_REDUCTION_TYPES(reduce, [&] {
+        segment_csr_batched_kernel<scalar_t, REDUCE, index_t>
+            <<<BLOCKS(1, numel), THREADS, 0, stream>>>(
+                (const problem_t *)descriptors.data_ptr(), problems.size(),
+                out.data_ptr<scalar_t>(), numel);
+      });
+    });
+  });
+
+  return outs;
+}
+
+torch::Tensor segment_csr_arg_backward_cuda(torch::Tensor grad_out,
+                                            torch::Tensor arg_out, int64_t dim,
+                                            std::vector<int64_t> src_sizes) {
+  return arg_backward_cuda(grad_out, arg_out, dim, src_sizes, THREADS);
+}
@@ -1,11 +1,100 @@
 #pragma once
 
+#include <ATen/cuda/CUDAContext.h>
+#include <c10/cuda/CUDAGuard.h>
 #include <torch/extension.h>
 
 #define CHECK_CUDA(x)                                                          \
   AT_ASSERTM(x.device().is_cuda(), #x " must be CUDA tensor")
 #define CHECK_INPUT(x) AT_ASSERTM(x, "Input mismatch")
 
+// Dispatches over all data types supported by our kernels.
+#define AT_DISPATCH_SCATTER_TYPES(TYPE, NAME, ...)                             \
+  AT_DISPATCH_ALL_TYPES_AND2(at::ScalarType::Half, at::ScalarType::BFloat16,   \
+                             TYPE, NAME, __VA_ARGS__)
+
+// Dispatches over all floating-point data types supported by our kernels.
+#define AT_DISPATCH_SCATTER_FLOATING_TYPES(TYPE, NAME, ...)                    \
+  AT_DISPATCH_FLOATING_TYPES_AND2(at::ScalarType::Half,                        \
+                                  at::ScalarType::BFloat16, TYPE, NAME,        \
+                                  __VA_ARGS__)
+
+// Dispatches between softmax (`LOG == false`) and log-softmax (`LOG == true`).
+#define AT_DISPATCH_SOFTMAX_LOG(log, ...)                                      \
+  [&] {                                                                        \
+    if (log) {                                                                 \
+      const bool LOG = true;                                                   \
+      return __VA_ARGS__();                                                    \
+    } else {                                                                   \
+      const bool LOG = false;                                                  \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+  }()
+
+// A pack of `VEC` consecutive values, which is loaded and stored via a
+// single memory transaction of up to 128 bits.
+template <typename scalar_t, int VEC>
+struct alignas(sizeof(scalar_t) * VEC) Vec {
+  scalar_t val[VEC];
+};
+
+template <typename scalar_t, int VEC>
+__device__ __inline__ Vec<scalar_t, VEC> load_vec(const scalar_t *ptr) {
+  return *reinterpret_cast<const Vec<scalar_t, VEC> *>(ptr);
+}
+
+template <typename scalar_t, int VEC>
+__device__ __inline__ void store_vec(scalar_t *ptr,
+                                     const Vec<scalar_t, VEC> &vec) {
+  *reinterpret_cast<Vec<scalar_t, VEC> *>(ptr) = vec;
+}
+
+// The largest number of consecutive columns broadcast kernels process per
+// thread for `scalar_t`, such that packs span at most 128 bits.
+#define MAX_VEC(scalar_t)                                                      \
+  ((int)(16 / sizeof(scalar_t) < 8 ? 16 / sizeof(scalar_t) : 8))
+
+// Returns the number of consecutive columns of rows of size `K` each thread
+// of a broadcast kernel can process, i.e., the largest pack size dividing `K`
+// for which all base pointers `ptrs` are aligned. Since all rows start at
+// multiples of `K`, rows are then aligned as well. `nullptr` is aligned.
+template <typename scalar_t>
+inline int vec_size(int64_t K, const std::vector<const void *> &ptrs) {
+  int vec = MAX_VEC(scalar_t);
+  for (; vec > 1; vec /= 2) {
+    bool aligned = K % vec == 0;
+    for (auto ptr : ptrs)
+      aligned &= (uintptr_t)ptr % (vec * sizeof(scalar_t)) == 0;
+    if (aligned)
+      break;
+  }
+  return vec;
+}
+
+// Dispatches over the pack sizes returned by `vec_size`. Pack sizes exceeding
+// `MAX_VEC(scalar_t)` are never returned and therefore not instantiated.
+#define AT_DISPATCH_VEC_SIZES(scalar_t, vec, ...)                              \
+  [&] {                                                                        \
+    switch (vec) {                                                             \
+    case 8: {                                                                  \
+      const int VEC = MAX_VEC(scalar_t) >= 8 ? 8 : 1;                          \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    case 4: {                                                                  \
+      const int VEC = MAX_VEC(scalar_t) >= 4 ? 4 : 1;                          \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    case 2: {                                                                  \
+      const int VEC = MAX_VEC(scalar_t) >= 2 ? 2 : 1;                          \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    default: {                                                                 \
+      const int VEC = 1;                                                       \
+      return __VA_ARGS__();                                                    \
+    }                                                                          \
+    }                                                                          \
+  }()
+
 __device__ __inline__ at::Half __shfl_up_sync(const unsigned mask,
                                               const at::Half var,
                                               const unsigned int delta) {
@@ -17,3 +106,58 @@ __device__ __inline__ at::Half __shfl_down_sync(const unsigned mask,
                                                 const unsigned int delta) {
   return __shfl_down_sync(mask, var.operator __half(), delta);
 }
+
+template <typename scalar_t, typename index_t>
+__global__ void arg_backward_kernel(const scalar_t *grad_out_data,
+                                    const index_t *arg_out_data,
+                                    scalar_t *grad_in_data, int64_t N,
+                                    int64_t K, int64_t E, int64_t numel) {
+  int64_t thread_idx = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+
+  if (thread_idx < numel) {
+    int64_t arg = arg_out_data[thread_idx];
+    if (arg >= 0 && arg < E) {
+      int64_t offset = (thread_idx / (N * K)) * E * K + thread_idx % K;
+      grad_in_data[offset + arg * K] = grad_out_data[thread_idx];
+    }
+  }
+}
+
+// Routes `grad_out` to the positions `arg_out` along `dim` of a zero-filled
+// gradient of size `src_sizes`, which is the backward pass of MIN and MAX.
+// Arguments equal to `src_sizes[dim]` mark outputs which did not receive any
+// value and are skipped. Since every source entry is the argument of at most
+// one output, no atomic operations are needed.
+// Since this header is included before the `THREADS` of each file is defined,
+// callers pass it in explicitly.
+inline torch::Tensor arg_backward_cuda(torch::Tensor grad_out,
+                                       torch::Tensor arg_out, int64_t dim,
+                                       std::vector<int64_t> src_sizes,
+                                       int64_t threads) {
+  const c10::cuda::CUDAGuard device_guard(grad_out.device());
+  grad_out = grad_out.contiguous();
+  arg_out = arg_out.contiguous();
+  auto grad_in = torch::zeros(src_sizes, grad_out.options());
+  if (grad_out.numel() == 0 || grad_in.numel() == 0)
+    return grad_in;
+
+  auto E = grad_in.size(dim);
+  auto N = grad_out.size(dim);
+  auto K = grad_out.stride(dim);
+  auto numel = grad_out.numel();
+
+  auto stream = at::cuda::getCurrentCUDAStream();
+  AT_DISPATCH_SCATTER_TYPES(grad_out.scalar_type(), "_", [&] {
+    auto grad_out_data = grad_out.data_ptr<scalar_t>();
+    auto grad_in_data = grad_in.data_ptr<scalar_t>();
+
+    AT_DISPATCH_INDEX_TYPES(arg_out.scalar_type(), "_", [&] {
+      arg_backward_kernel<scalar_t, index_t>
+          <<<(numel + threads - 1) / threads, threads, 0, stream>>>(
+              grad_out_data, arg_out.data_ptr<index_t>(), grad_in_data, N, K,
+              E, numel);
+    });
+  });
+
+  return grad_in;
+}
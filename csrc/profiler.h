@@ -0,0 +1,53 @@
+#pragma once
+
+#include <ATen/record_function.h>
+#include <torch/extension.h>
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Opens a profiler range for the remainder of the current scope, named
+// `torch_scatter::<name>[<variant>](E=..., K=..., N=...)`, to tell apart the
+// kernel variants picked by heuristics in traces of `torch.profiler`. Ranges
+// are emitted as NVTX ranges under `torch.autograd.profiler.emit_nvtx()`.
+// The name is only built in case a profiler is active.
+#define RECORD_KERNEL(name, E, K, N, ...)                                      \
+  RECORD_FUNCTION(c10::str("torch_scatter::", name, "[", __VA_ARGS__,          \
+                           "](E=", E, ", K=", K, ", N=", N, ")"),              \
+                  std::vector<c10::IValue>())
+
+// The number of user-facing forward calls of each operator implemented by an
+// extension, and the number of bytes they read from and wrote to their
+// tensors, keyed by operator name. Each extension defines its own counter
+// with internal linkage, such that counters are never shared across
+// extensions.
+struct OpCounter {
+  void count(const std::string &op, const std::vector<torch::Tensor> &tensors) {
+    int64_t numel_bytes = 0;
+    for (const auto &tensor : tensors)
+      if (tensor.defined())
+        numel_bytes += tensor.numel() * tensor.element_size();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &count = counts[op];
+    count[0]++;
+    count[1] += numel_bytes;
+  }
+
+  // Returns the number of calls and bytes moved so far of each operator.
+  c10::Dict<std::string, std::vector<int64_t>> get(bool reset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    c10::Dict<std::string, std::vector<int64_t>> out;
+    for (const auto &count : counts)
+      out.insert(count.first,
+                 std::vector<int64_t>{count.second[0], count.second[1]});
+    if (reset)
+      counts.clear();
+    return out;
+  }
+
+  std::mutex mutex;
+  std::map<std::string, std::array<int64_t, 2>> counts;
+};
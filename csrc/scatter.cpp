@@ -2,9 +2,12 @@
 #include <torch/script.h>
 
 #include "cpu/scatter_cpu.h"
+#include "profiler.h"
 #include "utils.h"
+#include "workspace.h"
 
 #ifdef WITH_CUDA
+#include "cuda/host_sync.h"
 #include "cuda/scatter_cuda.h"
 #endif
 
@@ -16,6 +19,9 @@ PyMODINIT_FUNC PyInit__scatter_cpu(void) { return NULL; }
 #endif
 #endif
 
+// Counts the user-facing calls of the operators of this extension only.
+static OpCounter op_counter;
+
 torch::Tensor broadcast(torch::Tensor src, torch::Tensor other, int64_t dim) {
   if (src.dim() == 1)
     for (auto i = 0; i < dim; i++)
@@ -29,15 +35,83 @@ torch::Tensor broadcast(torch::Tensor src, torch::Tensor other, int64_t dim) {
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 scatter_fw(torch::Tensor src, torch::Tensor index, int64_t dim,
            torch::optional<torch::Tensor> optional_out,
-           torch::optional<int64_t> dim_size, std::string reduce) {
+           torch::optional<int64_t> dim_size, std::string reduce,
+           torch::optional<torch::Tensor> optional_weight = torch::nullopt) {
+  RECORD_FUNCTION("torch_scatter::scatter_" + reduce,
+                  std::vector<c10::IValue>({src, index}));
+  std::tuple<torch::Tensor, torch::optional<torch::Tensor>> result;
+  if (src.device().is_cuda()) {
+#ifdef WITH_CUDA
+    result = scatter_cuda(src, index, dim, optional_out, dim_size, reduce,
+                          optional_weight);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    result = scatter_cpu(src, index, dim, optional_out, dim_size, reduce,
+                         optional_weight);
+  }
+  return result;
+}
+
+torch::Tensor scatter_softmax_fw(torch::Tensor src, torch::Tensor index,
+                                 int64_t dim, int64_t dim_size, bool log) {
   if (src.device().is_cuda()) {
 #ifdef WITH_CUDA
-    return scatter_cuda(src, index, dim, optional_out, dim_size, reduce);
+    return scatter_softmax_cuda(src, index, dim, dim_size, log);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return scatter_softmax_cpu(src, index, dim, dim_size, log);
+  }
+}
+
+torch::Tensor scatter_softmax_bw(torch::Tensor out, torch::Tensor grad_out,
+                                 torch::Tensor index, int64_t dim,
+                                 int64_t dim_size, bool log) {
+  if (out.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return scatter_softmax_backward_cuda(out, grad_out, index, dim, dim_size,
+                                         log);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return scatter_softmax_backward_cpu(out, grad_out, index, dim, dim_size,
+                                        log);
+  }
+}
+
+// Returns `dim_size` if given, and infers it as `index.max() + 1` otherwise.
+int64_t scatter_dim_size(torch::Tensor index,
+                         torch::optional<int64_t> dim_size) {
+  if (dim_size.has_value())
+    return dim_size.value();
+  if (index.numel() == 0)
+    return 0;
+#ifdef WITH_CUDA
+  if (index.device().is_cuda()) {
+    auto size = sync_item(index, SCATTER_SIZE, [&] { return index.max(); });
+    AT_ASSERTM(size.has_value(), "Inferring the output size of scatter ",
+               "requires a host-device sync. Please pass `dim_size` ",
+               "explicitly instead.");
+    return 1 + size.value();
+  }
+#endif
+  return 1 + index.max().item<int64_t>();
+}
+
+torch::Tensor scatter_arg_bw(torch::Tensor grad_out, torch::Tensor arg_out,
+                             int64_t dim, std::vector<int64_t> src_sizes) {
+  if (grad_out.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return scatter_arg_backward_cuda(grad_out, arg_out, dim, src_sizes);
 #else
     AT_ERROR("Not compiled with CUDA support");
 #endif
   } else {
-    return scatter_cpu(src, index, dim, optional_out, dim_size, reduce);
+    return scatter_arg_backward_cpu(grad_out, arg_out, dim, src_sizes);
   }
 }
 
@@ -66,7 +140,7 @@ public:
   static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
     auto grad_out = grad_outs[0];
     auto saved = ctx->get_saved_variables();
-    auto index = saved[0];
+    auto index = saved[0].to(torch::kLong);
     auto dim = ctx->saved_data["dim"].toInt();
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
     auto grad_in = torch::gather(grad_out, dim, index, false);
@@ -96,7 +170,7 @@ public:
     auto grad_out = grad_outs[0];
     auto saved = ctx->get_saved_variables();
     auto src = saved[0];
-    auto index = saved[1];
+    auto index = saved[1].to(torch::kLong);
     auto out = saved[2];
     auto dim = ctx->saved_data["dim"].toInt();
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
@@ -116,24 +190,10 @@ public:
     ctx->saved_data["dim"] = dim;
     ctx->saved_data["src_shape"] = src.sizes();
 
-    auto old_index = index;
-
     index = broadcast(index, src, dim);
-    auto result = scatter_fw(src, index, dim, optional_out, dim_size, "sum");
+    auto result = scatter_fw(src, index, dim, optional_out, dim_size, "mean");
     auto out = std::get<0>(result);
-
-    auto ones = torch::ones(old_index.sizes(), src.options());
-    result = scatter_fw(ones, old_index,
-                        old_index.dim() <= dim ? old_index.dim() - 1 : dim,
-                        torch::nullopt, out.size(dim), "sum");
-    auto count = std::get<0>(result);
-    count.masked_fill_(count < 1, 1);
-    count = broadcast(count, out, dim);
-    if (out.is_floating_point())
-      out.true_divide_(count);
-    else
-      out.div_(count, "floor");
-
+    auto count = std::get<1>(result).value();
     ctx->save_for_backward({index, count});
     if (optional_out.has_value())
       ctx->mark_dirty({optional_out.value()});
@@ -143,11 +203,11 @@ public:
   static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
     auto grad_out = grad_outs[0];
     auto saved = ctx->get_saved_variables();
-    auto index = saved[0];
+    auto index = saved[0].to(torch::kLong);
     auto count = saved[1];
     auto dim = ctx->saved_data["dim"].toInt();
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    count = torch::gather(count, dim, index, false);
+    count = torch::gather(count.expand(grad_out.sizes()), dim, index, false);
     auto grad_in = torch::gather(grad_out, dim, index, false);
     grad_in.true_divide_(count);
     return {grad_in, Variable(), Variable(), Variable(), Variable()};
@@ -182,10 +242,7 @@ public:
     auto arg_out = saved[1];
     auto dim = ctx->saved_data["dim"].toInt();
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    src_shape[dim] += 1;
-    auto grad_in = torch::zeros(src_shape, grad_out.options());
-    grad_in.scatter_(dim, arg_out, grad_out);
-    grad_in = grad_in.narrow(dim, 0, src_shape[dim] - 1);
+    auto grad_in = scatter_arg_bw(grad_out, arg_out, dim, src_shape);
     return {grad_in, Variable(), Variable(), Variable(), Variable()};
   }
 };
@@ -218,10 +275,90 @@ public:
     auto arg_out = saved[1];
     auto dim = ctx->saved_data["dim"].toInt();
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    src_shape[dim] += 1;
-    auto grad_in = torch::zeros(src_shape, grad_out.options());
-    grad_in.scatter_(dim, arg_out, grad_out);
-    grad_in = grad_in.narrow(dim, 0, src_shape[dim] - 1);
+    auto grad_in = scatter_arg_bw(grad_out, arg_out, dim, src_shape);
+    return {grad_in, Variable(), Variable(), Variable(), Variable()};
+  }
+};
+
+class ScatterWeighted : public torch::autograd::Function<ScatterWeighted> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable index, Variable weight, int64_t dim,
+                               torch::optional<int64_t> dim_size,
+                               std::string reduce) {
+    dim = dim < 0 ? src.dim() + dim : dim;
+    ctx->saved_data["dim"] = dim;
+    ctx->saved_data["reduce"] = reduce;
+    index = broadcast(index, src, dim);
+    auto result =
+        scatter_fw(src, index, dim, torch::nullopt, dim_size, reduce, weight);
+    auto out = std::get<0>(result);
+    // Holds the arguments for MIN/MAX and the counts for MEAN.
+    auto arg_out = std::get<1>(result).has_value()
+                       ? std::get<1>(result).value()
+                       : Variable();
+    ctx->save_for_backward({src, index, weight, arg_out});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0];
+    auto saved = ctx->get_saved_variables();
+    auto src = saved[0];
+    auto index = saved[1];
+    auto weight = saved[2];
+    auto arg_out = saved[3];
+    auto dim = ctx->saved_data["dim"].toInt();
+    auto reduce = ctx->saved_data["reduce"].toStringRef();
+
+    // `grad` holds the gradient with respect to the weighted entries, which
+    // is turned into the one of `src` in-place after deriving `grad_weight`.
+    torch::Tensor grad;
+    if (reduce == "min" || reduce == "max")
+      grad = scatter_arg_bw(grad_out, arg_out, dim, src.sizes().vec());
+    else {
+      grad = torch::gather(grad_out, dim, index.to(torch::kLong), false);
+      if (reduce == "mean") {
+        auto count = torch::gather(arg_out.expand(grad_out.sizes()), dim,
+                                   index.to(torch::kLong), false);
+        grad.true_divide_(count);
+      }
+    }
+
+    Variable grad_weight;
+    if (ctx->needs_input_grad(2))
+      grad_weight = weight_grad(grad, src, dim);
+    grad.mul_(weight_view(weight, dim, src.dim()));
+
+    return {grad, Variable(), grad_weight, Variable(), Variable(), Variable()};
+  }
+};
+
+class ScatterSoftmax : public torch::autograd::Function<ScatterSoftmax> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable index, int64_t dim,
+                               torch::optional<int64_t> dim_size, bool log) {
+    dim = dim < 0 ? src.dim() + dim : dim;
+    index = broadcast(index, src, dim);
+    auto N = scatter_dim_size(index, dim_size);
+    ctx->saved_data["dim"] = dim;
+    ctx->saved_data["dim_size"] = N;
+    ctx->saved_data["log"] = log;
+    auto out = scatter_softmax_fw(src, index, dim, N, log);
+    ctx->save_for_backward({index, out});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0];
+    auto saved = ctx->get_saved_variables();
+    auto index = saved[0];
+    auto out = saved[1];
+    auto dim = ctx->saved_data["dim"].toInt();
+    auto N = ctx->saved_data["dim_size"].toInt();
+    auto log = ctx->saved_data["log"].toBool();
+    auto grad_in = scatter_softmax_bw(out, grad_out, index, dim, N, log);
     return {grad_in, Variable(), Variable(), Variable(), Variable()};
   }
 };
@@ -229,19 +366,25 @@ public:
 torch::Tensor scatter_sum(torch::Tensor src, torch::Tensor index, int64_t dim,
                           torch::optional<torch::Tensor> optional_out,
                           torch::optional<int64_t> dim_size) {
-  return ScatterSum::apply(src, index, dim, optional_out, dim_size)[0];
+  auto out = ScatterSum::apply(src, index, dim, optional_out, dim_size)[0];
+  op_counter.count("scatter_sum", {src, index, out});
+  return out;
 }
 
 torch::Tensor scatter_mul(torch::Tensor src, torch::Tensor index, int64_t dim,
                           torch::optional<torch::Tensor> optional_out,
                           torch::optional<int64_t> dim_size) {
-  return ScatterMul::apply(src, index, dim, optional_out, dim_size)[0];
+  auto out = ScatterMul::apply(src, index, dim, optional_out, dim_size)[0];
+  op_counter.count("scatter_mul", {src, index, out});
+  return out;
 }
 
 torch::Tensor scatter_mean(torch::Tensor src, torch::Tensor index, int64_t dim,
                            torch::optional<torch::Tensor> optional_out,
                            torch::optional<int64_t> dim_size) {
-  return ScatterMean::apply(src, index, dim, optional_out, dim_size)[0];
+  auto out = ScatterMean::apply(src, index, dim, optional_out, dim_size)[0];
+  op_counter.count("scatter_mean", {src, index, out});
+  return out;
 }
 
 std::tuple<torch::Tensor, torch::Tensor>
@@ -249,6 +392,7 @@ scatter_min(torch::Tensor src, torch::Tensor index, int64_t dim,
             torch::optional<torch::Tensor> optional_out,
             torch::optional<int64_t> dim_size) {
   auto result = ScatterMin::apply(src, index, dim, optional_out, dim_size);
+  op_counter.count("scatter_min", {src, index, result[0]});
   return std::make_tuple(result[0], result[1]);
 }
 
@@ -257,5 +401,58 @@ scatter_max(torch::Tensor src, torch::Tensor index, int64_t dim,
             torch::optional<torch::Tensor> optional_out,
             torch::optional<int64_t> dim_size) {
   auto result = ScatterMax::apply(src, index, dim, optional_out, dim_size);
+  op_counter.count("scatter_max", {src, index, result[0]});
   return std::make_tuple(result[0], result[1]);
 }
+
+torch::Tensor scatter_weighted(torch::Tensor src, torch::Tensor index,
+                               torch::Tensor weight, int64_t dim,
+                               torch::optional<int64_t> dim_size,
+                               std::string reduce) {
+  auto out =
+      ScatterWeighted::apply(src, index, weight, dim, dim_size, reduce)[0];
+  op_counter.count("scatter_weighted", {src, index, out});
+  return out;
+}
+
+torch::Tensor scatter_softmax(torch::Tensor src, torch::Tensor index,
+                              int64_t dim, torch::optional<int64_t> dim_size) {
+  auto out = ScatterSoftmax::apply(src, index, dim, dim_size, false)[0];
+  op_counter.count("scatter_softmax", {src, index, out});
+  return out;
+}
+
+torch::Tensor scatter_log_softmax(torch::Tensor src, torch::Tensor index,
+                                  int64_t dim,
+                                  torch::optional<int64_t> dim_size) {
+  auto out = ScatterSoftmax::apply(src, index, dim, dim_size, true)[0];
+  op_counter.count("scatter_log_softmax", {src, index, out});
+  return out;
+}
+
+// Counts operators that are implemented in Python for this extension, such as
+// `scatter_sum` on CPU.
+void scatter_count_op(std::string op, std::vector<torch::Tensor> tensors) {
+  op_counter.count(op, tensors);
+}
+
+c10::Dict<std::string, std::vector<int64_t>> scatter_op_count(bool reset) {
+  return op_counter.get(reset);
+}
+
+torch::optional<torch::Tensor>
+scatter_bind_workspace(torch::optional<torch::Tensor> buffer) {
+  return bind_workspace(buffer);
+}
+
+std::vector<int64_t> scatter_workspace_stats(bool reset) {
+  return workspace_stats(SCATTER_WORKSPACE, reset);
+}
+
+int64_t scatter_host_syncs(bool reset) {
+#ifdef WITH_CUDA
+  return host_sync_count({SCATTER_SIZE}, reset);
+#else
+  return 0;
+#endif
+}
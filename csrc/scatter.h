@@ -38,6 +38,18 @@ scatter_max(torch::Tensor src, torch::Tensor index, int64_t dim,
             torch::optional<torch::Tensor> optional_out,
             torch::optional<int64_t> dim_size);
 
+torch::Tensor scatter_weighted(torch::Tensor src, torch::Tensor index,
+                               torch::Tensor weight, int64_t dim,
+                               torch::optional<int64_t> dim_size,
+                               std::string reduce);
+
+torch::Tensor scatter_softmax(torch::Tensor src, torch::Tensor index,
+                              int64_t dim, torch::optional<int64_t> dim_size);
+
+torch::Tensor scatter_log_softmax(torch::Tensor src, torch::Tensor index,
+                                  int64_t dim,
+                                  torch::optional<int64_t> dim_size);
+
 torch::Tensor segment_sum_coo(torch::Tensor src, torch::Tensor index,
                               torch::optional<torch::Tensor> optional_out,
                               torch::optional<int64_t> dim_size);
@@ -75,3 +87,62 @@ segment_max_csr(torch::Tensor src, torch::Tensor indptr,
 
 torch::Tensor gather_csr(torch::Tensor src, torch::Tensor indptr,
                          torch::optional<torch::Tensor> optional_out);
+
+torch::Tensor segment_csr_gather(torch::Tensor src, torch::Tensor indptr,
+                                 torch::Tensor col,
+                                 torch::optional<torch::Tensor> optional_weight,
+                                 std::string reduce);
+
+torch::Tensor segment_var_csr(torch::Tensor src, torch::Tensor indptr,
+                              bool unbiased);
+
+torch::Tensor segment_std_csr(torch::Tensor src, torch::Tensor indptr,
+                              bool unbiased);
+
+torch::Tensor segment_logsumexp_csr(torch::Tensor src, torch::Tensor indptr);
+
+torch::Tensor segment_csr_multi(torch::Tensor src, torch::Tensor indptr,
+                                std::vector<std::string> reduces,
+                                bool unbiased);
+
+torch::Tensor segment_weighted_csr(torch::Tensor src, torch::Tensor indptr,
+                                   torch::Tensor weight, std::string reduce);
+
+std::vector<torch::Tensor>
+segment_csr_batched(std::vector<torch::Tensor> srcs,
+                    std::vector<torch::Tensor> indptrs, std::string reduce);
+
+torch::Tensor segment_softmax_csr(torch::Tensor src, torch::Tensor indptr);
+
+torch::Tensor segment_log_softmax_csr(torch::Tensor src, torch::Tensor indptr);
+
+int64_t segment_coo_dim_size(torch::Tensor index);
+
+int64_t scatter_host_syncs(bool reset);
+
+int64_t segment_coo_host_syncs(bool reset);
+
+int64_t segment_csr_host_syncs(bool reset);
+
+void scatter_count_op(std::string op, std::vector<torch::Tensor> tensors);
+
+c10::Dict<std::string, std::vector<int64_t>> scatter_op_count(bool reset);
+
+c10::Dict<std::string, std::vector<int64_t>> segment_coo_op_count(bool reset);
+
+c10::Dict<std::string, std::vector<int64_t>> segment_csr_op_count(bool reset);
+
+torch::optional<torch::Tensor>
+scatter_bind_workspace(torch::optional<torch::Tensor> buffer);
+
+std::vector<int64_t> scatter_workspace_stats(bool reset);
+
+torch::optional<torch::Tensor>
+segment_coo_bind_workspace(torch::optional<torch::Tensor> buffer);
+
+std::vector<int64_t> segment_coo_workspace_stats(bool reset);
+
+torch::optional<torch::Tensor>
+segment_csr_bind_workspace(torch::optional<torch::Tensor> buffer);
+
+std::vector<int64_t> segment_csr_workspace_stats(bool reset);
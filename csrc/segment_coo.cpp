@@ -2,9 +2,12 @@
 #include <torch/script.h>
 
 #include "cpu/segment_coo_cpu.h"
+#include "profiler.h"
 #include "utils.h"
+#include "workspace.h"
 
 #ifdef WITH_CUDA
+#include "cuda/host_sync.h"
 #include "cuda/segment_coo_cuda.h"
 #endif
 
@@ -16,19 +19,26 @@ PyMODINIT_FUNC PyInit__segment_coo_cpu(void) { return NULL; }
 #endif
 #endif
 
+// Counts the user-facing calls of the operators of this extension only.
+static OpCounter op_counter;
+
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_coo_fw(torch::Tensor src, torch::Tensor index,
                torch::optional<torch::Tensor> optional_out,
                torch::optional<int64_t> dim_size, std::string reduce) {
+  RECORD_FUNCTION("torch_scatter::segment_" + reduce + "_coo",
+                  std::vector<c10::IValue>({src, index}));
+  std::tuple<torch::Tensor, torch::optional<torch::Tensor>> result;
   if (src.device().is_cuda()) {
 #ifdef WITH_CUDA
-    return segment_coo_cuda(src, index, optional_out, dim_size, reduce);
+    result = segment_coo_cuda(src, index, optional_out, dim_size, reduce);
 #else
     AT_ERROR("Not compiled with CUDA support");
 #endif
   } else {
-    return segment_coo_cpu(src, index, optional_out, dim_size, reduce);
+    result = segment_coo_cpu(src, index, optional_out, dim_size, reduce);
   }
+  return result;
 }
 
 torch::Tensor gather_coo_fw(torch::Tensor src, torch::Tensor index,
@@ -44,6 +54,19 @@ torch::Tensor gather_coo_fw(torch::Tensor src, torch::Tensor index,
   }
 }
 
+torch::Tensor segment_coo_arg_bw(torch::Tensor grad_out, torch::Tensor arg_out,
+                                 int64_t dim, std::vector<int64_t> src_sizes) {
+  if (grad_out.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_coo_arg_backward_cuda(grad_out, arg_out, dim, src_sizes);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_coo_arg_backward_cpu(grad_out, arg_out, dim, src_sizes);
+  }
+}
+
 using torch::autograd::AutogradContext;
 using torch::autograd::Variable;
 using torch::autograd::variable_list;
@@ -129,11 +152,8 @@ public:
     auto index = saved[0];
     auto arg_out = saved[1];
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    src_shape[index.dim() - 1] += 1;
-    auto grad_in = torch::zeros(src_shape, grad_out.options());
-    grad_in.scatter_(index.dim() - 1, arg_out, grad_out);
-    grad_in =
-        grad_in.narrow(index.dim() - 1, 0, src_shape[index.dim() - 1] - 1);
+    auto grad_in =
+        segment_coo_arg_bw(grad_out, arg_out, index.dim() - 1, src_shape);
     return {grad_in, Variable(), Variable(), Variable()};
   }
 };
@@ -161,11 +181,8 @@ public:
     auto index = saved[0];
     auto arg_out = saved[1];
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    src_shape[index.dim() - 1] += 1;
-    auto grad_in = torch::zeros(src_shape, grad_out.options());
-    grad_in.scatter_(index.dim() - 1, arg_out, grad_out);
-    grad_in =
-        grad_in.narrow(index.dim() - 1, 0, src_shape[index.dim() - 1] - 1);
+    auto grad_in =
+        segment_coo_arg_bw(grad_out, arg_out, index.dim() - 1, src_shape);
     return {grad_in, Variable(), Variable(), Variable()};
   }
 };
@@ -198,13 +215,17 @@ public:
 torch::Tensor segment_sum_coo(torch::Tensor src, torch::Tensor index,
                               torch::optional<torch::Tensor> optional_out,
                               torch::optional<int64_t> dim_size) {
-  return SegmentSumCOO::apply(src, index, optional_out, dim_size)[0];
+  auto out = SegmentSumCOO::apply(src, index, optional_out, dim_size)[0];
+  op_counter.count("segment_sum_coo", {src, index, out});
+  return out;
 }
 
 torch::Tensor segment_mean_coo(torch::Tensor src, torch::Tensor index,
                                torch::optional<torch::Tensor> optional_out,
                                torch::optional<int64_t> dim_size) {
-  return SegmentMeanCOO::apply(src, index, optional_out, dim_size)[0];
+  auto out = SegmentMeanCOO::apply(src, index, optional_out, dim_size)[0];
+  op_counter.count("segment_mean_coo", {src, index, out});
+  return out;
 }
 
 std::tuple<torch::Tensor, torch::Tensor>
@@ -212,6 +233,7 @@ segment_min_coo(torch::Tensor src, torch::Tensor index,
                 torch::optional<torch::Tensor> optional_out,
                 torch::optional<int64_t> dim_size) {
   auto result = SegmentMinCOO::apply(src, index, optional_out, dim_size);
+  op_counter.count("segment_min_coo", {src, index, result[0]});
   return std::make_tuple(result[0], result[1]);
 }
 
@@ -220,10 +242,46 @@ segment_max_coo(torch::Tensor src, torch::Tensor index,
                 torch::optional<torch::Tensor> optional_out,
                 torch::optional<int64_t> dim_size) {
   auto result = SegmentMaxCOO::apply(src, index, optional_out, dim_size);
+  op_counter.count("segment_max_coo", {src, index, result[0]});
   return std::make_tuple(result[0], result[1]);
 }
 
 torch::Tensor gather_coo(torch::Tensor src, torch::Tensor index,
                          torch::optional<torch::Tensor> optional_out) {
-  return GatherCOO::apply(src, index, optional_out)[0];
+  auto out = GatherCOO::apply(src, index, optional_out)[0];
+  op_counter.count("gather_coo", {src, index, out});
+  return out;
+}
+
+c10::Dict<std::string, std::vector<int64_t>> segment_coo_op_count(bool reset) {
+  return op_counter.get(reset);
+}
+
+torch::optional<torch::Tensor>
+segment_coo_bind_workspace(torch::optional<torch::Tensor> buffer) {
+  return bind_workspace(buffer);
+}
+
+std::vector<int64_t> segment_coo_workspace_stats(bool reset) {
+  return workspace_stats(SEGMENT_COO_WORKSPACE, reset);
+}
+
+int64_t segment_coo_dim_size(torch::Tensor index) {
+  if (index.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_coo_dim_size_cuda(index);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_coo_dim_size_cpu(index);
+  }
+}
+
+int64_t segment_coo_host_syncs(bool reset) {
+#ifdef WITH_CUDA
+  return host_sync_count({SEGMENT_COO_SIZE, SEGMENT_COO_AUTOTUNE}, reset);
+#else
+  return 0;
+#endif
 }
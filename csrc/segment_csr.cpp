@@ -2,9 +2,12 @@
 #include <torch/script.h>
 
 #include "cpu/segment_csr_cpu.h"
+#include "profiler.h"
 #include "utils.h"
+#include "workspace.h"
 
 #ifdef WITH_CUDA
+#include "cuda/host_sync.h"
 #include "cuda/segment_csr_cuda.h"
 #endif
 
@@ -16,19 +19,51 @@ PyMODINIT_FUNC PyInit__segment_csr_cpu(void) { return NULL; }
 #endif
 #endif
 
+// Counts the user-facing calls of the operators of this extension only.
+static OpCounter op_counter;
+
 std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
 segment_csr_fw(torch::Tensor src, torch::Tensor indptr,
-               torch::optional<torch::Tensor> optional_out,
-               std::string reduce) {
+               torch::optional<torch::Tensor> optional_out, std::string reduce,
+               torch::optional<torch::Tensor> optional_weight =
+                   torch::nullopt) {
+  RECORD_FUNCTION("torch_scatter::segment_" + reduce + "_csr",
+                  std::vector<c10::IValue>({src, indptr}));
+  std::tuple<torch::Tensor, torch::optional<torch::Tensor>> result;
   if (src.device().is_cuda()) {
 #ifdef WITH_CUDA
-    return segment_csr_cuda(src, indptr, optional_out, reduce);
+    result = segment_csr_cuda(src, indptr, optional_out, reduce,
+                              optional_weight);
 #else
     AT_ERROR("Not compiled with CUDA support");
 #endif
   } else {
-    return segment_csr_cpu(src, indptr, optional_out, reduce);
+    result =
+        segment_csr_cpu(src, indptr, optional_out, reduce, optional_weight);
   }
+  return result;
+}
+
+std::vector<torch::Tensor>
+segment_csr_batched_fw(std::vector<torch::Tensor> srcs,
+                       std::vector<torch::Tensor> indptrs, std::string reduce) {
+  RECORD_FUNCTION("torch_scatter::segment_" + reduce + "_csr_batched",
+                  std::vector<c10::IValue>());
+  AT_ASSERTM(srcs.size() == indptrs.size(),
+             "Expected the same number of source and index pointer tensors");
+  if (srcs.size() == 0)
+    return {};
+  std::vector<torch::Tensor> outs;
+  if (srcs[0].device().is_cuda()) {
+#ifdef WITH_CUDA
+    outs = segment_csr_batched_cuda(srcs, indptrs, reduce);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    outs = segment_csr_batched_cpu(srcs, indptrs, reduce);
+  }
+  return outs;
 }
 
 torch::Tensor gather_csr_fw(torch::Tensor src, torch::Tensor indptr,
@@ -44,6 +79,103 @@ torch::Tensor gather_csr_fw(torch::Tensor src, torch::Tensor indptr,
   }
 }
 
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_csr_gather_fw(torch::Tensor src, torch::Tensor indptr,
+                      torch::Tensor col,
+                      torch::optional<torch::Tensor> optional_weight,
+                      std::string reduce) {
+  if (src.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_csr_gather_cuda(src, indptr, col, optional_weight, reduce);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_csr_gather_cpu(src, indptr, col, optional_weight, reduce);
+  }
+}
+
+torch::Tensor sddmm_csr_fw(torch::Tensor a, torch::Tensor indptr,
+                           torch::Tensor col, torch::Tensor b) {
+  if (a.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return sddmm_csr_cuda(a, indptr, col, b);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return sddmm_csr_cpu(a, indptr, col, b);
+  }
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>>
+segment_stat_csr_fw(torch::Tensor src, torch::Tensor indptr,
+                    std::string reduce, bool unbiased) {
+  if (src.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_stat_csr_cuda(src, indptr, reduce, unbiased);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_stat_csr_cpu(src, indptr, reduce, unbiased);
+  }
+}
+
+std::tuple<torch::Tensor, torch::optional<torch::Tensor>,
+           torch::optional<torch::Tensor>>
+segment_csr_multi_fw(torch::Tensor src, torch::Tensor indptr,
+                     std::vector<std::string> reduces, bool unbiased) {
+  if (src.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_csr_multi_cuda(src, indptr, reduces, unbiased);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_csr_multi_cpu(src, indptr, reduces, unbiased);
+  }
+}
+
+torch::Tensor segment_softmax_csr_fw(torch::Tensor src, torch::Tensor indptr,
+                                     bool log) {
+  if (src.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_softmax_csr_cuda(src, indptr, log);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_softmax_csr_cpu(src, indptr, log);
+  }
+}
+
+torch::Tensor segment_softmax_csr_bw(torch::Tensor out, torch::Tensor grad_out,
+                                     torch::Tensor indptr, bool log) {
+  if (out.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_softmax_csr_backward_cuda(out, grad_out, indptr, log);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_softmax_csr_backward_cpu(out, grad_out, indptr, log);
+  }
+}
+
+torch::Tensor segment_csr_arg_bw(torch::Tensor grad_out, torch::Tensor arg_out,
+                                 int64_t dim, std::vector<int64_t> src_sizes) {
+  if (grad_out.device().is_cuda()) {
+#ifdef WITH_CUDA
+    return segment_csr_arg_backward_cuda(grad_out, arg_out, dim, src_sizes);
+#else
+    AT_ERROR("Not compiled with CUDA support");
+#endif
+  } else {
+    return segment_csr_arg_backward_cpu(grad_out, arg_out, dim, src_sizes);
+  }
+}
+
 using torch::autograd::AutogradContext;
 using torch::autograd::Variable;
 using torch::autograd::variable_list;
@@ -127,11 +259,8 @@ public:
     auto indptr = saved[0];
     auto arg_out = saved[1];
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    src_shape[indptr.dim() - 1] += 1;
-    auto grad_in = torch::zeros(src_shape, grad_out.options());
-    grad_in.scatter_(indptr.dim() - 1, arg_out, grad_out);
-    grad_in =
-        grad_in.narrow(indptr.dim() - 1, 0, src_shape[indptr.dim() - 1] - 1);
+    auto grad_in =
+        segment_csr_arg_bw(grad_out, arg_out, indptr.dim() - 1, src_shape);
     return {grad_in, Variable(), Variable()};
   }
 };
@@ -158,11 +287,8 @@ public:
     auto indptr = saved[0];
     auto arg_out = saved[1];
     auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
-    src_shape[indptr.dim() - 1] += 1;
-    auto grad_in = torch::zeros(src_shape, grad_out.options());
-    grad_in.scatter_(indptr.dim() - 1, arg_out, grad_out);
-    grad_in =
-        grad_in.narrow(indptr.dim() - 1, 0, src_shape[indptr.dim() - 1] - 1);
+    auto grad_in =
+        segment_csr_arg_bw(grad_out, arg_out, indptr.dim() - 1, src_shape);
     return {grad_in, Variable(), Variable()};
   }
 };
@@ -192,20 +318,361 @@ public:
   }
 };
 
+class SegmentCSRGather : public torch::autograd::Function<SegmentCSRGather> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable indptr, Variable col,
+                               torch::optional<Variable> optional_weight,
+                               std::string reduce) {
+    ctx->saved_data["src_shape"] = src.sizes();
+    ctx->saved_data["reduce"] = reduce;
+    auto result =
+        segment_csr_gather_fw(src, indptr, col, optional_weight, reduce);
+    auto out = std::get<0>(result);
+    auto weight = optional_weight.has_value() ? optional_weight.value()
+                                              : Variable();
+    auto arg_out = std::get<1>(result).has_value() ? std::get<1>(result).value()
+                                                   : Variable();
+    ctx->save_for_backward({src, indptr, col, weight, arg_out});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0].contiguous();
+    auto saved = ctx->get_saved_variables();
+    auto src = saved[0];
+    auto indptr = saved[1];
+    auto col = saved[2];
+    auto weight = saved[3];
+    auto arg_out = saved[4];
+    auto src_shape = list2vec(ctx->saved_data["src_shape"].toIntList());
+    auto reduce = ctx->saved_data["reduce"].toStringRef();
+
+    auto N = indptr.numel() - 1;
+    auto M = src_shape[0];
+    auto E = col.numel();
+    auto K = src.numel() / std::max<int64_t>(M, 1);
+
+    Variable grad_in, grad_weight;
+    if (N <= 0 || E == 0 || K == 0) {
+      grad_in = torch::zeros(src_shape, grad_out.options());
+      if (weight.defined())
+        grad_weight = torch::zeros_like(weight);
+      return {grad_in, Variable(), Variable(), grad_weight, Variable()};
+    }
+
+    if (reduce == "sum" || reduce == "mean") {
+      // The gradient of `src` is given by the transposed sparse matrix
+      // product, for which we build a CSR representation of the transposed
+      // graph. This only requires temporary storage on the edge level.
+      auto out_int32 = col.scalar_type() == torch::kInt;
+      auto arange = torch::arange(E, col.options());
+      auto row = torch::searchsorted(indptr, arange, out_int32, true) - 1;
+
+      auto value = weight.defined() ? weight
+                                    : torch::ones({E}, grad_out.options());
+      torch::Tensor scale;
+      if (reduce == "mean") {
+        auto deg = indptr.narrow(0, 1, N) - indptr.narrow(0, 0, N);
+        deg = deg.clamp_min(1).to(grad_out.options());
+        scale = deg.index_select(0, row).reciprocal_();
+        value = value * scale;
+      }
+
+      auto sorted = torch::sort(col, true, 0, false);
+      auto perm = std::get<1>(sorted);
+      auto colptr =
+          torch::searchsorted(std::get<0>(sorted),
+                              torch::arange(M + 1, col.options()), out_int32);
+
+      grad_in = std::get<0>(segment_csr_gather_fw(
+          grad_out, colptr, row.index_select(0, perm),
+          value.index_select(0, perm), "sum"));
+
+      if (weight.defined() && ctx->needs_input_grad(3)) {
+        grad_weight = sddmm_csr_fw(grad_out, indptr, col, src);
+        if (reduce == "mean")
+          grad_weight.mul_(scale);
+      }
+    } else {
+      // Only the selected edges receive a gradient. Empty rows point to the
+      // out-of-range edge `E`, which maps to an additional row that gets
+      // dropped afterwards.
+      auto arg = arg_out.reshape({N, K}).to(torch::kLong);
+      auto col_ext = torch::cat({col, col.new_full({1}, M)}).to(torch::kLong);
+      auto index = col_ext.index_select(0, arg.flatten()).view({N, K});
+      auto grad = grad_out.reshape({N, K});
+      if (weight.defined()) {
+        auto weight_ext = torch::cat({weight, weight.new_zeros({1})});
+        grad = grad * weight_ext.index_select(0, arg.flatten()).view({N, K});
+      }
+      grad_in = torch::zeros({M + 1, K}, grad_out.options());
+      grad_in.scatter_add_(0, index, grad);
+      grad_in = grad_in.narrow(0, 0, M).view(src_shape);
+
+      if (weight.defined() && ctx->needs_input_grad(3)) {
+        auto src_ext = torch::cat({src.reshape({M, K}), src.new_zeros({1, K})});
+        auto tmp = grad_out.reshape({N, K}) * src_ext.gather(0, index);
+        grad_weight = torch::zeros({E + 1}, grad_out.options());
+        grad_weight.scatter_add_(0, arg.flatten(), tmp.flatten());
+        grad_weight = grad_weight.narrow(0, 0, E);
+      }
+    }
+
+    return {grad_in, Variable(), Variable(), grad_weight, Variable()};
+  }
+};
+
+class SegmentStatCSR : public torch::autograd::Function<SegmentStatCSR> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable indptr, std::string reduce,
+                               bool unbiased) {
+    ctx->saved_data["reduce"] = reduce;
+    ctx->saved_data["unbiased"] = unbiased;
+    auto result = segment_stat_csr_fw(src, indptr, reduce, unbiased);
+    auto out = std::get<0>(result);
+    auto mean = std::get<1>(result).has_value() ? std::get<1>(result).value()
+                                                : Variable();
+    ctx->save_for_backward({src, indptr, out, mean});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0].contiguous();
+    auto saved = ctx->get_saved_variables();
+    auto src = saved[0];
+    auto indptr = saved[1];
+    auto out = saved[2];
+    auto mean = saved[3];
+    auto reduce = ctx->saved_data["reduce"].toStringRef();
+    auto unbiased = ctx->saved_data["unbiased"].toBool();
+
+    if (src.numel() == 0)
+      return {torch::zeros_like(src), Variable(), Variable(), Variable()};
+
+    // Broadcasts per-segment values back to the entries of each segment.
+    auto gather = [&](torch::Tensor x) {
+      auto y = torch::empty(src.sizes(), x.options());
+      gather_csr_fw(x.contiguous(), indptr, y);
+      return y;
+    };
+
+    torch::Tensor grad_in;
+    if (reduce == "logsumexp") {
+      // The gradient of logsumexp is given by the softmax of each segment.
+      grad_in = (src - gather(out)).exp_().mul_(gather(grad_out));
+    } else {
+      // The gradient of VAR is given by `2 * (src - mean) / (count - 1)`, and
+      // the one of STD by `(src - mean) / ((count - 1) * std)`.
+      auto indptr1 = indptr.narrow(-1, 0, indptr.size(-1) - 1);
+      auto indptr2 = indptr.narrow(-1, 1, indptr.size(-1) - 1);
+      auto denom = (indptr2 - indptr1 - (int64_t)unbiased).clamp_min(1);
+      denom = denom.to(grad_out.options());
+      for (auto i = 0; i < grad_out.dim() - indptr.dim(); i++)
+        denom = denom.unsqueeze(-1);
+      torch::Tensor scale;
+      if (reduce == "var")
+        scale = grad_out.mul(2).div_(denom);
+      else
+        scale = grad_out.div(denom * out).masked_fill_(out == 0, 0);
+      grad_in = (src - gather(mean)).mul_(gather(scale));
+    }
+
+    return {grad_in, Variable(), Variable(), Variable()};
+  }
+};
+
+class SegmentCSRMulti : public torch::autograd::Function<SegmentCSRMulti> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable indptr,
+                               std::vector<std::string> reduces,
+                               bool unbiased) {
+    ctx->saved_data["reduces"] = reduces;
+    ctx->saved_data["unbiased"] = unbiased;
+    auto result = segment_csr_multi_fw(src, indptr, reduces, unbiased);
+    auto out = std::get<0>(result);
+    auto mean = std::get<1>(result).has_value() ? std::get<1>(result).value()
+                                                : Variable();
+    auto arg_out = std::get<2>(result).has_value()
+                       ? std::get<2>(result).value()
+                       : Variable();
+    ctx->save_for_backward({src, indptr, out, mean, arg_out});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0];
+    auto saved = ctx->get_saved_variables();
+    auto src = saved[0];
+    auto indptr = saved[1];
+    auto out = saved[2];
+    auto mean = saved[3];
+    auto arg_out = saved[4];
+    auto reduces = ctx->saved_data["reduces"].to<std::vector<std::string>>();
+    auto unbiased = ctx->saved_data["unbiased"].toBool();
+
+    auto dim = indptr.dim() - 1;
+    if (src.numel() == 0)
+      return {torch::zeros_like(src), Variable(), Variable(), Variable()};
+
+    auto indptr1 = indptr.narrow(-1, 0, indptr.size(-1) - 1);
+    auto indptr2 = indptr.narrow(-1, 1, indptr.size(-1) - 1);
+    auto count = (indptr2 - indptr1).to(grad_out.options());
+    for (auto i = 0; i < grad_out.dim() - 1 - indptr.dim(); i++)
+      count = count.unsqueeze(-1);
+    auto denom = (count - (int64_t)unbiased).clamp_min(1);
+
+    // The gradients of all requested reductions are first folded into two
+    // per-segment coefficients, such that `grad_in` is given by
+    // `coef + (src - mean) * scale` of its segment, plus the gradients routed
+    // to the arguments of MIN and MAX.
+    auto coef = torch::zeros(out[0].sizes(), grad_out.options());
+    auto scale = torch::zeros(out[0].sizes(), grad_out.options());
+    bool has_coef = false, has_scale = false;
+
+    torch::Tensor grad_arg;
+
+    for (size_t r = 0; r < reduces.size(); r++) {
+      std::string reduce = reduces[r] == "add" ? "sum" : reduces[r];
+      auto grad = grad_out[r];
+      if (reduce == "sum") {
+        coef.add_(grad);
+        has_coef = true;
+      } else if (reduce == "mean") {
+        coef.add_(grad / count.clamp_min(1));
+        has_coef = true;
+      } else if (reduce == "var") {
+        scale.add_(grad.mul(2).div_(denom));
+        has_scale = true;
+      } else if (reduce == "std") {
+        scale.add_(grad.div(denom * out[r]).masked_fill_(out[r] == 0, 0));
+        has_scale = true;
+      } else {
+        // MIN and MAX may share arguments, such that gradients are summed up.
+        auto grad_r =
+            segment_csr_arg_bw(grad, arg_out[r], dim, src.sizes().vec());
+        if (grad_arg.defined())
+          grad_arg.add_(grad_r);
+        else
+          grad_arg = grad_r;
+      }
+    }
+
+    // Broadcasts per-segment values back to the entries of each segment.
+    auto gather = [&](torch::Tensor x) {
+      auto y = torch::empty(src.sizes(), x.options());
+      gather_csr_fw(x.contiguous(), indptr, y);
+      return y;
+    };
+
+    auto grad_in = has_coef ? gather(coef) : torch::zeros_like(src);
+    if (has_scale)
+      grad_in.add_((src - gather(mean)).mul_(gather(scale)));
+    if (grad_arg.defined())
+      grad_in.add_(grad_arg);
+
+    return {grad_in, Variable(), Variable(), Variable()};
+  }
+};
+
+class SegmentWeightedCSR
+    : public torch::autograd::Function<SegmentWeightedCSR> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable indptr, Variable weight,
+                               std::string reduce) {
+    ctx->saved_data["reduce"] = reduce;
+    auto result = segment_csr_fw(src, indptr, torch::nullopt, reduce, weight);
+    auto out = std::get<0>(result);
+    auto arg_out = std::get<1>(result).has_value()
+                       ? std::get<1>(result).value()
+                       : Variable();
+    ctx->save_for_backward({src, indptr, weight, arg_out});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0].contiguous();
+    auto saved = ctx->get_saved_variables();
+    auto src = saved[0];
+    auto indptr = saved[1];
+    auto weight = saved[2];
+    auto arg_out = saved[3];
+    auto reduce = ctx->saved_data["reduce"].toStringRef();
+    auto dim = indptr.dim() - 1;
+
+    // `grad` holds the gradient with respect to the weighted entries, which
+    // is turned into the one of `src` in-place after deriving `grad_weight`.
+    torch::Tensor grad;
+    if (reduce == "min" || reduce == "max")
+      grad = segment_csr_arg_bw(grad_out, arg_out, dim, src.sizes().vec());
+    else {
+      grad = torch::empty(src.sizes(), grad_out.options());
+      if (grad.numel() > 0) {
+        gather_csr_fw(grad_out, indptr, grad);
+        if (reduce == "mean") {
+          auto indptr1 = indptr.narrow(-1, 0, indptr.size(-1) - 1);
+          auto indptr2 = indptr.narrow(-1, 1, indptr.size(-1) - 1);
+          auto count = (indptr2 - indptr1).to(grad.options());
+          count = gather_csr_fw(count, indptr, torch::nullopt);
+          for (auto i = 0; i < grad_out.dim() - indptr.dim(); i++)
+            count = count.unsqueeze(-1);
+          grad.true_divide_(count);
+        }
+      }
+    }
+
+    Variable grad_weight;
+    if (ctx->needs_input_grad(2))
+      grad_weight = weight_grad(grad, src, dim);
+    grad.mul_(weight_view(weight, dim, src.dim()));
+
+    return {grad, Variable(), grad_weight, Variable()};
+  }
+};
+
+class SegmentSoftmaxCSR : public torch::autograd::Function<SegmentSoftmaxCSR> {
+public:
+  static variable_list forward(AutogradContext *ctx, Variable src,
+                               Variable indptr, bool log) {
+    ctx->saved_data["log"] = log;
+    auto out = segment_softmax_csr_fw(src, indptr, log);
+    ctx->save_for_backward({indptr, out});
+    return {out};
+  }
+
+  static variable_list backward(AutogradContext *ctx, variable_list grad_outs) {
+    auto grad_out = grad_outs[0];
+    auto saved = ctx->get_saved_variables();
+    auto indptr = saved[0];
+    auto out = saved[1];
+    auto log = ctx->saved_data["log"].toBool();
+    auto grad_in = segment_softmax_csr_bw(out, grad_out, indptr, log);
+    return {grad_in, Variable(), Variable()};
+  }
+};
+
 torch::Tensor segment_sum_csr(torch::Tensor src, torch::Tensor indptr,
                               torch::optional<torch::Tensor> optional_out) {
-  return SegmentSumCSR::apply(src, indptr, optional_out)[0];
+  auto out = SegmentSumCSR::apply(src, indptr, optional_out)[0];
+  op_counter.count("segment_sum_csr", {src, indptr, out});
+  return out;
 }
 
 torch::Tensor segment_mean_csr(torch::Tensor src, torch::Tensor indptr,
                                torch::optional<torch::Tensor> optional_out) {
-  return SegmentMeanCSR::apply(src, indptr, optional_out)[0];
+  auto out = SegmentMeanCSR::apply(src, indptr, optional_out)[0];
+  op_counter.count("segment_mean_csr", {src, indptr, out});
+  return out;
 }
 
 std::tuple<torch::Tensor, torch::Tensor>
 segment_min_csr(torch::Tensor src, torch::Tensor indptr,
                 torch::optional<torch::Tensor> optional_out) {
   auto result = SegmentMinCSR::apply(src, indptr, optional_out);
+  op_counter.count("segment_min_csr", {src, indptr, result[0]});
   return std::make_tuple(result[0], result[1]);
 }
 
@@ -213,10 +680,106 @@ std::tuple<torch::Tensor, torch::Tensor>
 segment_max_csr(torch::Tensor src, torch::Tensor indptr,
                 torch::optional<torch::Tensor> optional_out) {
   auto result = SegmentMaxCSR::apply(src, indptr, optional_out);
+  op_counter.count("segment_max_csr", {src, indptr, result[0]});
   return std::make_tuple(result[0], result[1]);
 }
 
 torch::Tensor gather_csr(torch::Tensor src, torch::Tensor indptr,
                          torch::optional<torch::Tensor> optional_out) {
-  return GatherCSR::apply(src, indptr, optional_out)[0];
+  auto out = GatherCSR::apply(src, indptr, optional_out)[0];
+  op_counter.count("gather_csr", {src, indptr, out});
+  return out;
+}
+
+torch::Tensor segment_csr_gather(torch::Tensor src, torch::Tensor indptr,
+                                 torch::Tensor col,
+                                 torch::optional<torch::Tensor> optional_weight,
+                                 std::string reduce) {
+  auto out =
+      SegmentCSRGather::apply(src, indptr, col, optional_weight, reduce)[0];
+  op_counter.count("segment_csr_gather", {src, indptr, col, out});
+  return out;
+}
+
+torch::Tensor segment_var_csr(torch::Tensor src, torch::Tensor indptr,
+                              bool unbiased) {
+  auto out = SegmentStatCSR::apply(src, indptr, "var", unbiased)[0];
+  op_counter.count("segment_var_csr", {src, indptr, out});
+  return out;
+}
+
+torch::Tensor segment_std_csr(torch::Tensor src, torch::Tensor indptr,
+                              bool unbiased) {
+  auto out = SegmentStatCSR::apply(src, indptr, "std", unbiased)[0];
+  op_counter.count("segment_std_csr", {src, indptr, out});
+  return out;
+}
+
+torch::Tensor segment_logsumexp_csr(torch::Tensor src, torch::Tensor indptr) {
+  auto out = SegmentStatCSR::apply(src, indptr, "logsumexp", false)[0];
+  op_counter.count("segment_logsumexp_csr", {src, indptr, out});
+  return out;
+}
+
+torch::Tensor segment_csr_multi(torch::Tensor src, torch::Tensor indptr,
+                                std::vector<std::string> reduces,
+                                bool unbiased) {
+  auto out = SegmentCSRMulti::apply(src, indptr, reduces, unbiased)[0];
+  op_counter.count("segment_csr_multi", {src, indptr, out});
+  return out;
+}
+
+torch::Tensor segment_weighted_csr(torch::Tensor src, torch::Tensor indptr,
+                                   torch::Tensor weight, std::string reduce) {
+  auto out = SegmentWeightedCSR::apply(src, indptr, weight, reduce)[0];
+  op_counter.count("segment_weighted_csr", {src, indptr, out});
+  return out;
+}
+
+// Outputs are not differentiable, since the op targets inference of many
+// small graphs.
+std::vector<torch::Tensor>
+segment_csr_batched(std::vector<torch::Tensor> srcs,
+                    std::vector<torch::Tensor> indptrs, std::string reduce) {
+  auto outs = segment_csr_batched_fw(srcs, indptrs, reduce);
+  auto tensors = srcs;
+  tensors.insert(tensors.end(), indptrs.begin(), indptrs.end());
+  tensors.insert(tensors.end(), outs.begin(), outs.end());
+  op_counter.count("segment_csr_batched", tensors);
+  return outs;
+}
+
+torch::Tensor segment_softmax_csr(torch::Tensor src, torch::Tensor indptr) {
+  auto out = SegmentSoftmaxCSR::apply(src, indptr, false)[0];
+  op_counter.count("segment_softmax_csr", {src, indptr, out});
+  return out;
+}
+
+torch::Tensor segment_log_softmax_csr(torch::Tensor src,
+                                      torch::Tensor indptr) {
+  auto out = SegmentSoftmaxCSR::apply(src, indptr, true)[0];
+  op_counter.count("segment_log_softmax_csr", {src, indptr, out});
+  return out;
+}
+
+c10::Dict<std::string, std::vector<int64_t>> segment_csr_op_count(bool reset) {
+  return op_counter.get(reset);
+}
+
+torch::optional<torch::Tensor>
+segment_csr_bind_workspace(torch::optional<torch::Tensor> buffer) {
+  return bind_workspace(buffer);
+}
+
+std::vector<int64_t> segment_csr_workspace_stats(bool reset) {
+  return workspace_stats(SEGMENT_CSR_WORKSPACE, reset);
+}
+
+int64_t segment_csr_host_syncs(bool reset) {
+#ifdef WITH_CUDA
+  return host_sync_count({GATHER_CSR_SIZE, MERGE_PATH, SEGMENT_CSR_AUTOTUNE},
+                         reset);
+#else
+  return 0;
+#endif
 }
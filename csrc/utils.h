@@ -10,3 +10,33 @@ inline std::vector<int64_t> list2vec(const c10::List<int64_t> list) {
     result.push_back(list[i]);
   return result;
 }
+
+// Views a one-dimensional `weight` such that it broadcasts along `dim` of a
+// `dims`-dimensional tensor.
+inline torch::Tensor weight_view(torch::Tensor weight, int64_t dim,
+                                 int64_t dims) {
+  std::vector<int64_t> sizes(dims, 1);
+  sizes[dim] = -1;
+  return weight.view(sizes);
+}
+
+// Returns the gradient of per-entry weights along `dim` given the gradient
+// `grad` of weighted entries, i.e., `(grad * src)` summed over all dimensions
+// but `dim`. Without leading dimensions, this is computed as a batch of dot
+// products which does not materialize the product.
+inline torch::Tensor weight_grad(torch::Tensor grad, torch::Tensor src,
+                                 int64_t dim) {
+  auto E = src.size(dim);
+  if (dim == 0 && E > 0) {
+    auto K = src.numel() / E;
+    auto out = grad.reshape({E, 1, K}).bmm(src.reshape({E, K, 1}));
+    return out.view({E});
+  }
+  std::vector<int64_t> dims;
+  for (int64_t i = 0; i < src.dim(); i++)
+    if (i != dim)
+      dims.push_back(i);
+  if (dims.empty())
+    return grad * src;
+  return (grad * src).sum(dims);
+}
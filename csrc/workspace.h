@@ -0,0 +1,129 @@
+#pragma once
+
+#include <torch/extension.h>
+
+#include <algorithm>
+#include <vector>
+
+// Scratch buffers that kernels only need for the duration of a single call
+// (such as packed argument keys or partial results) can be carved out of a
+// pre-allocated byte buffer which is bound to the current thread, instead of
+// going through the caching allocator on every call. Buffers are handed out
+// in order within a call and released on its exit, so that a workspace must
+// only be used by calls on a single stream. Requests which do not fit (or
+// target another device) fall back to regular allocations.
+//
+// Outputs and tensors saved for the backward pass are never taken from the
+// workspace, since they outlive the call.
+
+#define WORKSPACE_ALIGNMENT 256
+
+// The extensions requesting workspace buffers. Depending on the platform, all
+// extensions may share a single workspace, so statistics are kept per
+// extension, and each extension only reports its own.
+enum WorkspaceUser {
+  SCATTER_WORKSPACE,
+  SEGMENT_COO_WORKSPACE,
+  SEGMENT_CSR_WORKSPACE,
+  NUM_WORKSPACE_USERS
+};
+
+struct WorkspaceStats {
+  int64_t hits = 0;   // Requests served from `buffer`.
+  int64_t misses = 0; // Requests which fell back to regular allocations.
+  int64_t peak = 0;   // Maximum number of bytes requested within a call.
+};
+
+struct Workspace {
+  torch::Tensor buffer; // One-dimensional `uint8` tensor.
+  int64_t offset = 0;   // Bytes requested by the current call.
+  int depth = 0;        // Nesting depth of current calls.
+
+  // The extension of the current call, and the statistics of each extension.
+  WorkspaceUser user = SCATTER_WORKSPACE;
+  WorkspaceStats stats[NUM_WORKSPACE_USERS];
+};
+
+inline Workspace &workspace() {
+  static thread_local Workspace workspace;
+  return workspace;
+}
+
+// Binds `buffer` to the current thread, or unbinds the current one, and
+// returns the previously bound buffer.
+inline torch::optional<torch::Tensor>
+bind_workspace(torch::optional<torch::Tensor> buffer) {
+  auto &ws = workspace();
+  AT_ASSERTM(ws.depth == 0, "Cannot re-bind the workspace during a call");
+  torch::optional<torch::Tensor> previous = torch::nullopt;
+  if (ws.buffer.defined())
+    previous = ws.buffer;
+  if (buffer.has_value()) {
+    auto value = buffer.value();
+    AT_ASSERTM(value.dim() == 1 && value.is_contiguous() &&
+                   value.scalar_type() == torch::kByte,
+               "Expected the workspace to be a contiguous uint8 vector");
+    ws.buffer = value;
+  } else {
+    ws.buffer = torch::Tensor();
+  }
+  return previous;
+}
+
+// Returns the number of requests of calls of `user` served from and missing
+// the bound workspace, and the number of bytes a workspace would need to serve
+// all requests of any single call (whether a workspace is bound or not).
+inline std::vector<int64_t> workspace_stats(WorkspaceUser user, bool reset) {
+  auto &stats = workspace().stats[user];
+  std::vector<int64_t> out = {stats.hits, stats.misses, stats.peak};
+  if (reset)
+    stats = WorkspaceStats();
+  return out;
+}
+
+// Marks the workspace requests of a single call of `user`, which are released
+// once the outermost scope is left.
+struct WorkspaceScope {
+  WorkspaceScope(WorkspaceUser user) {
+    if (workspace().depth++ == 0)
+      workspace().user = user;
+  }
+  ~WorkspaceScope() {
+    if (--workspace().depth == 0)
+      workspace().offset = 0;
+  }
+};
+
+// Same as `torch::empty(sizes, options)`, but served from the bound workspace
+// if possible. Needs to be called within a `WorkspaceScope`.
+inline torch::Tensor workspace_empty(at::IntArrayRef sizes,
+                                     const torch::TensorOptions &options) {
+  auto &ws = workspace();
+  int64_t numel = 1;
+  for (auto size : sizes)
+    numel *= size;
+  if (ws.depth == 0 || numel == 0)
+    return torch::empty(sizes, options);
+
+  // Offsets advance for missed requests as well, such that `peak` reports
+  // the size needed to serve all of them.
+  auto bytes = numel * (int64_t)options.dtype().itemsize();
+  auto offset = (ws.offset + WORKSPACE_ALIGNMENT - 1) / WORKSPACE_ALIGNMENT *
+                WORKSPACE_ALIGNMENT;
+  ws.offset = offset + bytes;
+  auto &stats = ws.stats[ws.user];
+  stats.peak = std::max(stats.peak, ws.offset);
+
+  if (!ws.buffer.defined())
+    return torch::empty(sizes, options);
+  if (ws.buffer.device() != options.device() ||
+      ws.offset > ws.buffer.numel()) {
+    stats.misses++;
+    return torch::empty(sizes, options);
+  }
+
+  stats.hits++;
+  return ws.buffer.narrow(0, offset, bytes)
+      .view(c10::typeMetaToScalarType(options.dtype()))
+      .view(sizes);
+}
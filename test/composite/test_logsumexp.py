@@ -1,5 +1,6 @@
 import torch
-from torch_scatter import scatter_logsumexp
+from torch.autograd import gradcheck
+from torch_scatter import scatter_logsumexp, segment_logsumexp_csr
 
 
 def test_logsumexp():
@@ -21,3 +22,16 @@ def test_logsumexp():
 
     jit = torch.jit.script(scatter_logsumexp)
     assert jit(inputs, index).tolist() == outputs.tolist()
+
+
+def test_segment_logsumexp():
+    src = torch.tensor([0.5, 0.5, 0.0, -2.1, 3.2, 7.0, -1.0, -100.0])
+    indptr = torch.tensor([0, 2, 5, 6, 6, 8])
+
+    out = segment_logsumexp_csr(src, indptr)
+    expected = scatter_logsumexp(src, torch.tensor([0, 0, 1, 1, 1, 2, 4, 4]),
+                                 dim_size=5)
+    assert torch.allclose(out, expected)
+
+    src = torch.randn(8, 3, dtype=torch.double, requires_grad=True)
+    assert gradcheck(segment_logsumexp_csr, (src, indptr))
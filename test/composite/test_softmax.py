@@ -1,5 +1,12 @@
+from itertools import product
+
+import pytest
 import torch
-from torch_scatter import scatter_log_softmax, scatter_softmax
+from torch.autograd import gradcheck
+from torch_scatter import (scatter_log_softmax, scatter_softmax,
+                           segment_softmax_csr)
+
+from ..utils import devices, grad_dtypes
 
 
 def test_softmax():
@@ -48,3 +55,23 @@ def test_log_softmax():
 
     jit = torch.jit.script(scatter_log_softmax)
     assert jit(src, index).tolist() == out.tolist()
+
+
+@pytest.mark.parametrize('log,dtype,device',
+                         product([False, True], grad_dtypes, devices))
+def test_segment_softmax(log, dtype, device):
+    src = torch.randn(2, 10, 3, dtype=dtype, device=device)
+    src.requires_grad_()
+    index = torch.tensor([0, 0, 0, 1, 1, 3, 3, 3, 3, 3], device=device)
+    indptr = torch.tensor([0, 3, 5, 5, 10], device=device)
+
+    func = scatter_log_softmax if log else scatter_softmax
+    expected = func(src, index, dim=1)
+    out = segment_softmax_csr(src, indptr, log=log)
+    assert torch.allclose(out, expected)
+
+    if dtype != torch.double:  # Gradient checks need double precision.
+        return
+    for index in [index, index.view(1, -1, 1).expand_as(src).contiguous()]:
+        assert gradcheck(func, (src, index, 1)) is True
+    assert gradcheck(segment_softmax_csr, (src, indptr, log)) is True
@@ -1,5 +1,6 @@
 import torch
-from torch_scatter import scatter_std
+from torch.autograd import gradcheck
+from torch_scatter import scatter_std, segment_coo, segment_std_csr
 
 
 def test_std():
@@ -16,3 +17,18 @@ def test_std():
 
     jit = torch.jit.script(scatter_std)
     assert jit(src, index, dim=-1, unbiased=True).tolist() == out.tolist()
+
+
+def test_segment_std():
+    src = torch.randn(2, 9, 4, dtype=torch.double, requires_grad=True)
+    index = torch.tensor([0, 0, 0, 1, 1, 3, 3, 3, 3])
+    indptr = torch.tensor([[0, 3, 5, 5, 9]]).expand(2, 5)
+
+    out = segment_std_csr(src, indptr)
+    expected = scatter_std(src, index, dim=1, dim_size=4)
+    assert torch.allclose(out, expected)
+
+    out = segment_coo(src, index.view(1, -1).expand(2, 9), reduce='var')
+    assert torch.allclose(out, expected**2)
+
+    assert gradcheck(segment_std_csr, (src, indptr, False))
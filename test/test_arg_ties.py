@@ -0,0 +1,52 @@
+from itertools import product
+
+import pytest
+import torch
+from torch_scatter import scatter_max, scatter_min
+from torch_scatter import segment_max_coo, segment_min_coo
+
+from .utils import devices, tensor
+
+src = [[1, 2], [3, 1], [3, 2], [1, 1]]
+index = [0, 0, 0, 0]
+
+
+@pytest.mark.parametrize('dtype,device',
+                         product([torch.half, torch.float], devices))
+def test_arg_ties(dtype, device):
+    x = tensor(src, dtype, device)
+    idx = tensor(index, torch.long, device)
+
+    # Ties are broken in favor of the smallest argument:
+    for fn in [scatter_max, lambda x, idx, dim: segment_max_coo(x, idx)]:
+        out, arg_out = fn(x, idx, dim=0)
+        assert out.tolist() == [[3, 2]]
+        assert arg_out.tolist() == [[1, 0]]
+
+    for fn in [scatter_min, lambda x, idx, dim: segment_min_coo(x, idx)]:
+        out, arg_out = fn(x, idx, dim=0)
+        assert out.tolist() == [[1, 1]]
+        assert arg_out.tolist() == [[0, 1]]
+
+    out, arg_out = scatter_max(x, idx, dim=0, out=x.new_full((2, 2), 2.5))
+    assert out.tolist() == [[3, 2.5], [2.5, 2.5]]
+    assert arg_out.tolist() == [[1, 4], [4, 4]]
+
+
+@pytest.mark.parametrize('dtype,device',
+                         product([torch.half, torch.float], devices))
+def test_arg_signed_zero_ties(dtype, device):
+    # `-0.0` and `0.0` compare equal, such that the first argument wins on
+    # all devices:
+    x = tensor([[-0.0, 0.0], [0.0, -0.0], [-1.0, -1.0]], dtype, device)
+    idx = tensor([0, 0, 0], torch.long, device)
+
+    for fn in [scatter_max, lambda x, idx, dim: segment_max_coo(x, idx)]:
+        out, arg_out = fn(x, idx, dim=0)
+        assert out.tolist() == [[0, 0]]
+        assert arg_out.tolist() == [[0, 0]]
+
+    for fn in [scatter_min, lambda x, idx, dim: segment_min_coo(x, idx)]:
+        out, arg_out = fn(x.neg(), idx, dim=0)
+        assert out.tolist() == [[0, 0]]
+        assert arg_out.tolist() == [[0, 0]]
@@ -25,3 +25,22 @@ def test_broadcasting(reduce, device):
     index = torch.randint(0, H, (H, )).to(device, torch.long)
     out = scatter(src, index, dim=2, dim_size=H, reduce=reduce)
     assert out.size() == (B, C, H, W)
+
+
+@pytest.mark.parametrize('reduce,device', product(reductions, devices))
+def test_broadcasting_layouts(reduce, device):
+    B, C, H, W = (4, 3, 8, 8)
+
+    src = torch.randn((B, C, H, W), device=device)
+    index = torch.randint(0, H, (1, 1, H, 1), device=device)
+    expected = scatter(src, index.expand(B, C, H, W).contiguous(), dim=2,
+                       dim_size=H, reduce=reduce)
+
+    # Expanded, contiguous and permuted layouts of the same index values:
+    index = index.expand(B, C, H, W)
+    for idx in [index, index.contiguous(),
+                index.permute(3, 2, 1, 0).contiguous().permute(3, 2, 1, 0)]:
+        for dtype in [torch.long, torch.int]:
+            out = scatter(src, idx.to(dtype), dim=2, dim_size=H,
+                          reduce=reduce)
+            assert torch.allclose(out, expected, atol=1e-6)
@@ -0,0 +1,55 @@
+import pytest
+import torch
+import torch.distributed as dist
+import torch.multiprocessing as mp
+from torch_scatter import scatter_distributed, segment_csr_distributed
+from torch_scatter import scatter, scatter_max, scatter_min, segment_csr
+
+from .utils import reductions
+
+WORLD_SIZE = 2
+
+
+def run(rank, init_file, reduce):
+    dist.init_process_group('gloo', init_method=f'file://{init_file}',
+                            rank=rank, world_size=WORLD_SIZE)
+
+    index = torch.tensor([0, 0, 1, 2, 2, 2, 4, 4, 0, 2])
+    indptr = torch.tensor([0, 2, 5, 5, 6, 10, 10])
+    src = torch.arange(20, dtype=torch.double).view(10, 2) % 7
+    src.requires_grad_()
+    shards = [(0, 6), (6, 10)]
+    start, end = shards[rank]
+
+    # Rank 0 owns the first three output rows, rank 1 the remaining ones.
+    expected_arg = None
+    if reduce == 'min' or reduce == 'max':
+        fn = scatter_min if reduce == 'min' else scatter_max
+        expected, expected_arg = fn(src, index, 0, dim_size=5)
+    else:
+        expected = scatter(src, index, 0, dim_size=5, reduce=reduce)
+    rows = [(0, 3), (3, 5)][rank]
+
+    out, arg_out = scatter_distributed(src[start:end], index[start:end], 0,
+                                       5, reduce)
+    assert torch.allclose(out, expected[rows[0]:rows[1]])
+    if expected_arg is not None:
+        assert arg_out.tolist() == expected_arg[rows[0]:rows[1]].tolist()
+
+    # Gradients of all ranks sum up to the ones of the non-sharded operation.
+    grad = torch.autograd.grad(out.sum(), src)[0]
+    dist.all_reduce(grad)
+    assert torch.allclose(grad, torch.autograd.grad(expected.sum(), src)[0])
+
+    expected = segment_csr(src, indptr, reduce=reduce)
+    rows = [(0, 3), (3, 6)][rank]
+    out, _ = segment_csr_distributed(src[start:end], indptr, reduce)
+    assert torch.allclose(out, expected[rows[0]:rows[1]])
+
+    dist.destroy_process_group()
+
+
+@pytest.mark.skipif(not dist.is_available(), reason='No distributed support')
+@pytest.mark.parametrize('reduce', reductions)
+def test_distributed(reduce, tmp_path):
+    mp.spawn(run, args=(str(tmp_path / 'init'), reduce), nprocs=WORLD_SIZE)
@@ -0,0 +1,54 @@
+from itertools import product
+
+import pytest
+import torch
+from torch_scatter import gather_coo, gather_csr, scatter, segment_coo
+from torch_scatter import scatter_max, segment_csr, segment_max_csr
+
+from .utils import devices, reductions, tensor
+
+src = [[1, 2], [5, 6], [3, 4], [7, 8], [9, 10], [11, 12]]
+index = [0, 0, 1, 1, 1, 3]
+indptr = [0, 2, 5, 5, 6]
+
+
+@pytest.mark.parametrize('reduce,device', product(reductions, devices))
+def test_int32_index(reduce, device):
+    x = tensor(src, torch.float, device)
+    x.requires_grad_()
+
+    outs = []
+    for dtype in [torch.long, torch.int]:
+        idx = tensor(index, dtype, device)
+        ptr = tensor(indptr, dtype, device)
+
+        out1 = scatter(x, idx, dim=0, reduce=reduce)
+        out2 = segment_coo(x, idx, reduce=reduce)
+        out3 = segment_csr(x, ptr, reduce=reduce)
+        out4 = gather_coo(out3, idx)
+        out5 = gather_csr(out3, ptr)
+
+        grads = []
+        for out in [out1, out2, out3, out4, out5]:
+            grad, = torch.autograd.grad(out.sum(), x, retain_graph=True)
+            grads.append(grad)
+
+        outs.append([out1, out2, out3, out4, out5] + grads)
+
+    for out1, out2 in zip(outs[0], outs[1]):
+        assert torch.allclose(out1, out2)
+
+
+@pytest.mark.parametrize('device', devices)
+def test_int32_arg_out(device):
+    x = tensor(src, torch.float, device)
+    idx = tensor(index, torch.int, device)
+    ptr = tensor(indptr, torch.int, device)
+
+    out, arg_out = scatter_max(x, idx, dim=0)
+    assert arg_out.dtype == torch.int
+    assert arg_out.tolist() == [[1, 1], [4, 4], [6, 6], [5, 5]]
+
+    out, arg_out = segment_max_csr(x, ptr)
+    assert arg_out.dtype == torch.int
+    assert arg_out.tolist() == [[1, 1], [4, 4], [6, 6], [5, 5]]
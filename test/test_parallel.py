@@ -0,0 +1,35 @@
+from itertools import product
+
+import pytest
+import torch
+from torch_scatter import gather_coo, gather_csr, scatter, segment_coo
+from torch_scatter import segment_csr
+
+from .utils import reductions
+
+sizes = [(1, ), (2, ), (64, )]
+
+
+@pytest.mark.parametrize('reduce,size', product(reductions, sizes))
+def test_parallel_cpu(reduce, size):
+    num_threads = torch.get_num_threads()
+
+    index = torch.randint(0, 500, (50000, )).sort()[0]
+    indptr = torch.bincount(index, minlength=500).cumsum(0)
+    indptr = torch.cat([indptr.new_zeros(1), indptr])
+    src = torch.randn((index.numel(), ) + size).squeeze(-1)
+
+    outs = []
+    for threads in [1, 4]:
+        torch.set_num_threads(threads)
+        out1 = scatter(src, index, dim=0, dim_size=500, reduce=reduce)
+        out2 = segment_coo(src, index, dim_size=500, reduce=reduce)
+        out3 = segment_csr(src, indptr, reduce=reduce)
+        out4 = gather_coo(out3, index)
+        out5 = gather_csr(out3, indptr)
+        outs.append((out1, out2, out3, out4, out5))
+    torch.set_num_threads(num_threads)
+
+    # Results need to be deterministic regardless of the number of threads:
+    for out1, out2 in zip(outs[0], outs[1]):
+        assert torch.equal(out1, out2)
@@ -0,0 +1,46 @@
+from itertools import product
+
+import pytest
+import torch
+import torch_scatter
+from torch_scatter import ScatterPlan
+
+from .utils import devices, reductions
+
+reductions = reductions + ['mul']
+
+
+@pytest.mark.parametrize('reduce,sort,device',
+                         product(reductions, [False, True], devices))
+def test_plan(reduce, sort, device):
+    index = torch.randint(0, 10, (50, ), device=device)
+    if sort:
+        index = index.sort()[0]
+    src = torch.randn(4, 50, 8, device=device)
+
+    plan = ScatterPlan(index, dim_size=12)
+    assert plan.is_sorted == sort
+
+    expected = torch_scatter.scatter(src, index, 1, dim_size=12,
+                                     reduce=reduce)
+    out = plan.scatter(src, 1, reduce)
+    assert torch.allclose(out, expected, atol=1e-6)
+    assert torch.allclose(plan.gather(out, 1), out.index_select(1, index))
+
+    if reduce in ['min', 'max']:
+        fn = getattr(torch_scatter, f'scatter_{reduce}')
+        expected = fn(src, index, 1, dim_size=12)[1]
+        arg_out = getattr(plan, f'scatter_{reduce}')(src, -2)[1]
+        assert arg_out.tolist() == expected.tolist()
+
+
+@pytest.mark.parametrize('device', devices)
+def test_plan_jit(device):
+    @torch.jit.script
+    def fn(src: torch.Tensor, index: torch.Tensor) -> torch.Tensor:
+        plan = ScatterPlan(index)
+        return plan.scatter(src, 0, 'mean') + plan.scatter(src, 0, 'max')
+
+    index = torch.tensor([0, 0, 1, 1, 1, 3], device=device)
+    src = torch.tensor([1., 2., 3., 4., 5., 6.], device=device)
+    assert fn(src, index).tolist() == [3.5, 9, 0, 12]
@@ -0,0 +1,54 @@
+import torch
+from torch_scatter import gather_csr, op_counters, scatter, segment_coo
+from torch_scatter import segment_csr
+
+from .utils import devices
+
+
+def test_op_counters():
+    for device in devices:
+        src = torch.randn(6, 4, device=device)
+        index = torch.tensor([0, 0, 1, 1, 1, 3], device=device)
+        indptr = torch.tensor([0, 2, 5, 5, 6], device=device)
+
+        op_counters(reset=True)
+        scatter(src, index, dim=0, dim_size=4, reduce='sum')
+        scatter(src, index, dim=0, dim_size=4, reduce='max')
+        segment_coo(src, index, dim_size=4, reduce='mean')
+        segment_csr(src, indptr, reduce='min')
+        segment_csr(src, indptr, reduce='sum')
+        segment_csr(src, indptr, reduce='sum')
+        gather_csr(src[:4], indptr)
+
+        counters = op_counters()
+        assert counters.keys() == {
+            'scatter_sum', 'scatter_max', 'segment_mean_coo',
+            'segment_min_csr', 'segment_sum_csr', 'gather_csr'
+        }
+        assert counters['scatter_sum']['calls'] == 1
+        assert counters['scatter_max']['calls'] == 1
+        assert counters['segment_mean_coo']['calls'] == 1
+        assert counters['segment_min_csr']['calls'] == 1
+        assert counters['segment_sum_csr']['calls'] == 2
+        assert counters['gather_csr']['calls'] == 1
+        nbytes = src.numel() * 4 + 4 * 4 * 4 + index.numel() * 8
+        assert counters['scatter_sum']['bytes'] == nbytes
+        nbytes = src.numel() * 4 + 4 * 4 * 4 + indptr.numel() * 8
+        assert counters['segment_sum_csr']['bytes'] == 2 * nbytes
+        assert op_counters(reset=True) == counters
+        assert op_counters() == {}
+
+        # Backward passes are not counted:
+        out = torch.randn(4, 4, device=device, requires_grad=True)
+        gather_csr(out, indptr).sum().backward()
+        assert op_counters().keys() == {'gather_csr'}
+
+
+def test_record_function():
+    src = torch.randn(6, 4)
+    indptr = torch.tensor([0, 2, 5, 5, 6])
+
+    with torch.profiler.profile() as prof:
+        segment_csr(src, indptr, reduce='max')
+    names = [event.name for event in prof.events()]
+    assert 'torch_scatter::segment_max_csr' in names
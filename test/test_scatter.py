@@ -172,3 +172,118 @@ def test_non_contiguous(test, reduce, dtype, device):
         arg_expected = tensor(test['arg_' + reduce], torch.long, device)
         assert torch.all(arg_out == arg_expected)
     assert torch.all(out == expected)
+
+
+@pytest.mark.parametrize('device', devices)
+def test_mean_counts(device):
+    src = torch.randn(2, 8, 3, device=device, requires_grad=True)
+    index1 = torch.randint(0, 4, (8, ), device=device)
+    index2 = torch.randint(0, 4, (2, 8, 3), device=device)
+
+    # Counts are shared across broadcasted dimensions (`index1`), and
+    # computed per entry otherwise (`index2`):
+    for index in [index1.view(1, 8, 1).expand_as(src), index2]:
+        out = torch_scatter.scatter_mean(src, index, 1, dim_size=5)
+        count = torch.zeros_like(out).scatter_add_(1, index,
+                                                   torch.ones_like(src))
+        expected = torch.zeros_like(out).scatter_add_(1, index, src)
+        expected = expected / count.clamp(min=1)
+        assert torch.allclose(out, expected, atol=1e-6)
+
+        grad, = torch.autograd.grad(out.sum(), src)
+        expected = 1 / count.clamp(min=1).gather(1, index)
+        assert torch.allclose(grad, expected, atol=1e-6)
+
+
+@pytest.mark.parametrize('reduce,device', product(reductions, devices))
+def test_assume_sorted(reduce, device):
+    src = torch.randn(100, 8, device=device)
+    index = torch.randint(0, 10, (100, ), device=device)
+
+    expected = torch_scatter.scatter(src, index, 0, dim_size=12,
+                                     reduce=reduce)
+
+    sorted_index, perm = torch_scatter.scatter_sort_permute(index)
+    out = torch_scatter.scatter(src.index_select(0, perm), sorted_index, 0,
+                                dim_size=12, reduce=reduce, assume_sorted=True)
+    assert torch.allclose(out, expected, atol=1e-6)
+
+    out = torch_scatter.scatter(src.t().index_select(1, perm), sorted_index,
+                                -1, dim_size=12, reduce=reduce,
+                                assume_sorted=True)
+    assert torch.allclose(out, expected.t(), atol=1e-6)
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason='CUDA not found')
+@pytest.mark.parametrize('reduce', ['sum', 'mean', 'mul'])
+def test_deterministic(reduce):
+    src = torch.randn(2000, 16, device='cuda')
+    src = 1 + 0.01 * src if reduce == 'mul' else src
+    index = torch.randint(0, 10, (2000, ), device='cuda')
+    sorted_index = index.sort()[0]
+
+    expected = torch_scatter.scatter(src.cpu().double(), index.cpu(), 0,
+                                     dim_size=12, reduce=reduce)
+
+    torch.use_deterministic_algorithms(True)
+    try:
+        outs = [
+            torch_scatter.scatter(src, index, 0, dim_size=12, reduce=reduce)
+            for _ in range(2)
+        ]
+        if reduce != 'mul':
+            outs += [
+                torch_scatter.segment_coo(src, sorted_index, dim_size=12,
+                                          reduce=reduce) for _ in range(2)
+            ]
+    finally:
+        torch.use_deterministic_algorithms(False)
+
+    assert torch.equal(outs[0], outs[1])
+    assert torch.allclose(outs[0].cpu().double(), expected, rtol=1e-4)
+    if reduce != 'mul':
+        assert torch.equal(outs[2], outs[3])
+
+
+@pytest.mark.parametrize('reduce,dtype,device',
+                         product(reductions, [torch.half, torch.float],
+                                 devices))
+def test_low_cardinality(reduce, dtype, device):
+    # Few outputs with many entries each get privatized in shared memory:
+    src = torch.rand(4000, 2, device=device).add_(0.5)
+    index = torch.randint(0, 8, (4000, ), device=device)
+
+    expected = torch_scatter.scatter(src.cpu().double(), index.cpu(), dim=0,
+                                     dim_size=10, reduce=reduce)
+    out = torch_scatter.scatter(src.to(dtype), index, dim=0, dim_size=10,
+                                reduce=reduce)
+    assert torch.allclose(out.cpu().double(), expected, rtol=1e-2)
+
+
+@pytest.mark.parametrize('reduce,assume_sorted,device',
+                         product(reductions, [False, True], devices))
+def test_scatter_compact(reduce, assume_sorted, device):
+    src = torch.randn(6, 3, 4, dtype=torch.double, device=device)
+    index = torch.tensor([7, 2, 7, 40, 2, 2], device=device)
+    if assume_sorted:
+        index = index.sort()[0]
+
+    unique_index, out = torch_scatter.scatter_compact(
+        src.transpose(0, 1), index, dim=1, reduce=reduce,
+        assume_sorted=assume_sorted)
+    assert unique_index.tolist() == [2, 7, 40]
+    expected = torch_scatter.scatter(src.transpose(0, 1), index, dim=1,
+                                     reduce=reduce)
+    assert torch.allclose(out, expected.index_select(1, unique_index))
+
+    # Far larger indices must not allocate dense outputs:
+    unique_index, out = torch_scatter.scatter_compact(
+        src, index * 10**12, dim=0, reduce=reduce,
+        assume_sorted=assume_sorted)
+    assert unique_index.tolist() == [2 * 10**12, 7 * 10**12, 40 * 10**12]
+    assert out.size() == (3, 3, 4)
+
+    src.requires_grad_()
+    assert gradcheck(
+        lambda x: torch_scatter.scatter_compact(
+            x, index, 0, reduce, assume_sorted)[1], src)
@@ -5,7 +5,7 @@ import torch
 from torch.autograd import gradcheck
 import torch_scatter
 
-from .utils import reductions, tensor, dtypes, devices
+from .utils import reductions, tensor, dtypes, grad_dtypes, devices
 
 tests = [
     {
@@ -190,3 +190,189 @@ def test_non_contiguous(test, reduce, dtype, device):
         arg_expected = tensor(test['arg_' + reduce], torch.long, device)
         assert torch.all(arg_out == arg_expected)
     assert torch.all(out == expected)
+
+
+@pytest.mark.parametrize('reduce,device,mode',
+                         product(reductions, devices, ['default', 'cache']))
+def test_imbalanced_rows(reduce, device, mode, monkeypatch):
+    # A few hub rows among many short ones trigger the merge path kernel,
+    # which gets selected on the device unless running in "cache" sync mode:
+    monkeypatch.setenv('TORCH_SCATTER_SYNC_MODE', mode)
+    deg = torch.randint(0, 4, (10000, ))
+    deg[torch.tensor([5, 500, 9999])] = torch.tensor([20000, 3000, 5000])
+    indptr = torch.cat([deg.new_zeros(1), deg.cumsum(0)]).to(device)
+    index = torch.repeat_interleave(torch.arange(deg.numel()), deg)
+    index = index.to(device)
+
+    for size in [(), (3, )]:
+        src = torch.randn((index.numel(), ) + size, device=device)
+
+        out1 = torch_scatter.segment_coo(src, index, dim_size=deg.numel(),
+                                         reduce=reduce)
+        torch_scatter.host_sync_count(reset=True)
+        out2 = torch_scatter.segment_csr(src, indptr, reduce=reduce)
+        if mode == 'default':
+            assert torch_scatter.host_sync_count() == 0
+        assert torch.allclose(out1, out2, atol=1e-4)
+
+
+@pytest.mark.parametrize('dtype,device',
+                         product([torch.half, torch.bfloat16], devices))
+def test_reduced_precision_accumulation(dtype, device):
+    # Accumulating in `dtype` would get stuck at 256 (bfloat16) or 2048 (half):
+    src = torch.ones(4096, dtype=dtype, device=device)
+    indptr = torch.tensor([0, 4096], device=device)
+
+    out = torch_scatter.segment_csr(src, indptr, reduce='sum')
+    assert out.tolist() == [4096]
+
+    out = torch_scatter.segment_csr(src, indptr, reduce='mean')
+    assert out.tolist() == [1]
+
+
+@pytest.mark.parametrize('reduce,dtype', product(reductions, grad_dtypes))
+def test_wide_rows(reduce, dtype):
+    # Covers both the vectorized and the remaining scalar columns on CPU:
+    index = torch.randint(0, 20, (200, )).sort()[0]
+    indptr = torch.cat([index.new_zeros(1),
+                        torch.bincount(index, minlength=20).cumsum(0)])
+    src = torch.randn(200, 37, dtype=dtype)
+    src[torch.arange(0, 200, 7)] = 0.5  # Introduces ties.
+
+    expected = torch_scatter.scatter(src, index, dim=0, dim_size=20,
+                                     reduce=reduce)
+    out1 = torch_scatter.segment_csr(src, indptr, reduce=reduce)
+    out2 = torch_scatter.segment_coo(src, index, dim_size=20, reduce=reduce)
+    assert torch.allclose(out1, expected)
+    assert torch.allclose(out2, expected)
+
+    if reduce in ['min', 'max']:
+        fn = getattr(torch_scatter, f'scatter_{reduce}')
+        expected = fn(src, index, dim=0, dim_size=20)[1]
+        fn = getattr(torch_scatter, f'segment_{reduce}_csr')
+        assert fn(src, indptr)[1].tolist() == expected.tolist()
+        fn = getattr(torch_scatter, f'segment_{reduce}_coo')
+        assert fn(src, index, dim_size=20)[1].tolist() == expected.tolist()
+
+
+@pytest.mark.parametrize('device', devices)
+def test_multi(device):
+    index = torch.randint(0, 10, (100, ), device=device).sort()[0]
+    indptr = torch.cat([index.new_zeros(1),
+                        torch.bincount(index, minlength=12).cumsum(0)])
+    src = torch.randn(100, 3, dtype=torch.double, device=device)
+    src.requires_grad_()
+
+    reduces = ['sum', 'mean', 'min', 'max', 'std']
+    expected = torch.stack([
+        torch_scatter.segment_csr(src, indptr, reduce=reduce)
+        for reduce in reduces
+    ])
+    out1 = torch_scatter.segment_csr_multi(src, indptr, reduces)
+    out2 = torch_scatter.segment_coo_multi(src, index, reduces, dim_size=12)
+    assert torch.allclose(out1, expected)
+    assert torch.allclose(out2, expected)
+
+    grad_out = torch.randn_like(out1)
+    expected = torch.autograd.grad(expected, src, grad_out)[0]
+    assert torch.allclose(torch.autograd.grad(out1, src, grad_out)[0],
+                          expected)
+
+    src = src[:20].detach().requires_grad_()
+    indptr = torch.tensor([0, 4, 9, 9, 16, 20], device=device)
+    assert gradcheck(torch_scatter.segment_csr_multi,
+                     (src, indptr, ['mean', 'var', 'max'], False))
+
+
+@pytest.mark.parametrize('device', devices)
+def test_arg_backward(device):
+    src = torch.tensor([[1., 4.], [3., 2.], [5., 6.]], device=device)
+    src.requires_grad_()
+    indptr = torch.tensor([0, 2, 2, 3], device=device)
+
+    out, _ = torch_scatter.segment_max_csr(src, indptr)
+    out.backward(torch.tensor([[1., 2.], [3., 4.], [5., 6.]], device=device))
+    assert src.grad.is_contiguous()
+    assert src.grad.tolist() == [[0, 2], [1, 0], [5, 6]]
+
+
+@pytest.mark.parametrize('reduce,device',
+                         product(['sum', 'mean', 'min', 'max'], devices))
+def test_weighted(reduce, device):
+    index = torch.tensor([0, 0, 1, 1, 1, 3], device=device)
+    indptr = torch.tensor([0, 2, 5, 5, 6], device=device)
+    src = torch.randn(6, 3, dtype=torch.double, device=device)
+    weight = torch.randn(6, dtype=torch.double, device=device)
+
+    expected = torch_scatter.segment_csr(src * weight.view(-1, 1), indptr,
+                                         reduce=reduce)
+    out1 = torch_scatter.segment_csr(src, indptr, reduce=reduce,
+                                     weight=weight)
+    out2 = torch_scatter.segment_coo(src, index, reduce=reduce,
+                                     weight=weight)
+    out3 = torch_scatter.scatter(src, index, 0, reduce=reduce, dim_size=4,
+                                 weight=weight)
+    assert torch.allclose(out1, expected)
+    assert torch.allclose(out2, expected)
+    assert torch.allclose(out3, expected)
+
+    src.requires_grad_()
+    weight.requires_grad_()
+    assert gradcheck(torch.ops.torch_scatter.segment_weighted_csr,
+                     (src, indptr, weight, reduce))
+    assert gradcheck(torch.ops.torch_scatter.scatter_weighted,
+                     (src.t(), index, weight, 1, 4, reduce))
+
+
+@pytest.mark.parametrize('reduce,dtype,device',
+                         product(reductions, [torch.half, torch.float,
+                                              torch.double], devices))
+def test_packed_columns(reduce, dtype, device):
+    # Covers all pack sizes of broadcast kernels, as well as the scalar
+    # fallback for odd `K` and misaligned inputs:
+    index = torch.randint(0, 20, (200, ), device=device).sort()[0]
+    indptr = torch.cat([index.new_zeros(1),
+                        torch.bincount(index, minlength=20).cumsum(0)])
+
+    for K, shift in product([2, 3, 4, 8, 16], [0, 1]):
+        src = torch.randn(200 * K + shift, dtype=dtype, device=device)
+        src = src[shift:].view(200, K)
+
+        expected = torch_scatter.scatter(src.double(), index, dim=0,
+                                         dim_size=20, reduce=reduce)
+        out1 = torch_scatter.segment_csr(src, indptr, reduce=reduce)
+        out2 = torch_scatter.segment_coo(src, index, dim_size=20,
+                                         reduce=reduce)
+        assert torch.allclose(out1.double(), expected, atol=5e-2)
+        assert torch.allclose(out2.double(), expected, atol=5e-2)
+
+        out = torch_scatter.gather_csr(out1, indptr)
+        assert torch.equal(out, out1[index])
+        out = torch_scatter.gather_coo(out1, index)
+        assert torch.equal(out, out1[index])
+
+
+@pytest.mark.parametrize('reduce,device', product(reductions, devices))
+def test_batched(reduce, device):
+    srcs, indptrs = [], []
+    for E, N, size in [(10, 4, (3, )), (0, 2, (3, )), (7, 7, ()), (0, 0, ())]:
+        index = torch.randint(0, max(N, 1), (E, )).sort()[0]
+        count = torch.bincount(index, minlength=N)[:N]
+        indptrs.append(torch.cat([count.new_zeros(1), count.cumsum(0)]))
+        indptrs[-1] = indptrs[-1].to(device)
+        srcs.append(torch.randn((E, ) + size, device=device))
+
+    outs = torch_scatter.segment_csr_batched(srcs, indptrs, reduce)
+    assert len(outs) == len(srcs)
+    offset = outs[0].data_ptr()
+    for src, indptr, out in zip(srcs, indptrs, outs):
+        expected = torch_scatter.segment_csr(src, indptr, reduce=reduce)
+        assert out.size() == expected.size()
+        assert torch.allclose(out, expected)
+        assert out.data_ptr() == offset  # Backed by a single allocation.
+        offset += out.numel() * out.element_size()
+
+    src = srcs[0].requires_grad_()
+    out = torch_scatter.segment_csr_batched([src], indptrs[:1], reduce)[0]
+    out.sum().backward()
+    assert src.grad is not None
@@ -0,0 +1,55 @@
+from itertools import product
+
+import pytest
+import torch
+from torch.autograd import gradcheck
+from torch_scatter import segment_csr, segment_csr_gather
+
+from .utils import reductions, tensor, grad_dtypes, devices
+
+tests = [
+    {
+        'src': [[1, 2], [3, 4], [5, 6], [7, 8]],
+        'indptr': [0, 2, 5, 5, 6],
+        'col': [0, 1, 1, 2, 3, 0],
+        'weight': [1, 2, 1, 1, 2, 3],
+    },
+    {
+        'src': [1, 2, 3, 4],
+        'indptr': [0, 3, 3, 4],
+        'col': [3, 2, 0, 1],
+        'weight': [2, 1, 1, 3],
+    },
+]
+
+
+@pytest.mark.parametrize('test,reduce,dtype,device',
+                         product(tests, reductions, grad_dtypes, devices))
+def test_forward(test, reduce, dtype, device):
+    src = tensor(test['src'], dtype, device)
+    indptr = tensor(test['indptr'], torch.long, device)
+    col = tensor(test['col'], torch.long, device)
+    weight = tensor(test['weight'], dtype, device)
+
+    out = segment_csr_gather(src, indptr, col, reduce=reduce)
+    expected = segment_csr(src[col], indptr, reduce=reduce)
+    assert torch.allclose(out, expected)
+
+    out = segment_csr_gather(src, indptr, col, weight, reduce=reduce)
+    tmp = src[col] * weight.view([-1] + [1] * (src.dim() - 1))
+    expected = segment_csr(tmp, indptr, reduce=reduce)
+    assert torch.allclose(out, expected)
+
+
+@pytest.mark.parametrize('test,reduce,device',
+                         product(tests, reductions, devices))
+def test_backward(test, reduce, device):
+    src = tensor(test['src'], torch.double, device)
+    src.requires_grad_()
+    indptr = tensor(test['indptr'], torch.long, device)
+    col = tensor(test['col'], torch.long, device)
+    weight = tensor(test['weight'], torch.double, device)
+    weight.requires_grad_()
+
+    assert gradcheck(segment_csr_gather, (src, indptr, col, None, reduce))
+    assert gradcheck(segment_csr_gather, (src, indptr, col, weight, reduce))
@@ -0,0 +1,26 @@
+import pytest
+import torch
+from torch_scatter import segment_csr, segment_csr_stream
+
+from .utils import reductions
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason='CUDA not available')
+@pytest.mark.parametrize('reduce', reductions)
+def test_segment_csr_stream(reduce):
+    count = torch.tensor([3, 0, 17, 1, 0, 0, 40, 2, 9])
+    indptr = torch.cat([count.new_zeros(1), count.cumsum(0)])
+    src = torch.randn(int(count.sum()), 4)
+    expected = segment_csr(src.cuda(), indptr.cuda(), reduce=reduce)
+
+    # Row-blocks of at most 8 entries plus their last segment.
+    chunk_size = 8 * 4 * src.element_size()
+    for x in [src, src.pin_memory()]:
+        out = segment_csr_stream(x, indptr, reduce=reduce,
+                                 chunk_size=chunk_size)
+        assert out.is_cuda
+        assert torch.allclose(out, expected)
+
+    out = torch.full_like(expected, float('nan'))
+    segment_csr_stream(src, indptr, out, reduce, num_streams=3)
+    assert torch.allclose(out, expected)
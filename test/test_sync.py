@@ -0,0 +1,96 @@
+import pytest
+import torch
+from torch_scatter import gather_csr, host_sync_count, scatter, segment_coo
+from torch_scatter import segment_csr, segment_std_coo
+
+from .utils import reductions, tensor
+
+src = [[1, 2], [5, 6], [3, 4], [7, 8], [9, 10], [11, 12]]
+index = [0, 0, 1, 1, 1, 3]
+indptr = [0, 2, 5, 5, 6]
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason='CUDA not available')
+@pytest.mark.parametrize('reduce', reductions)
+def test_sync_mode(reduce, monkeypatch):
+    x = tensor(src, torch.float, 'cuda')
+    idx = tensor(index, torch.long, 'cuda')
+    ptr = tensor(indptr, torch.long, 'cuda')
+
+    host_sync_count(reset=True)
+    scatter(x, idx, dim=0, dim_size=4, reduce=reduce)
+    segment_coo(x, idx, dim_size=4, reduce=reduce)
+    assert host_sync_count() == 0
+
+    monkeypatch.setenv('TORCH_SCATTER_SYNC_MODE', 'cache')
+    for _ in range(3):
+        out1 = scatter(x, idx, dim=0, reduce=reduce)
+        out2 = segment_coo(x, idx, reduce=reduce)
+        out3 = gather_csr(out1, ptr)
+    assert out1.size(0) == out2.size(0) == 4 and out3.size(0) == 6
+    assert host_sync_count(reset=True) == 3
+
+    # Modifying the index tensor in-place invalidates its cached size:
+    idx[-1] = 4
+    assert scatter(x, idx, dim=0, reduce=reduce).size(0) == 5
+    assert host_sync_count() == 1
+
+    monkeypatch.setenv('TORCH_SCATTER_SYNC_MODE', 'strict')
+    assert scatter(x, idx, dim=0, reduce=reduce).size(0) == 5
+    with pytest.raises(RuntimeError, match='dim_size'):
+        segment_coo(x, idx.clone(), reduce=reduce)
+    assert host_sync_count() == 1
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason='CUDA not available')
+def test_coo_to_csr_sync_mode(monkeypatch):
+    x = tensor(src, torch.float, 'cuda')
+    idx = tensor(index, torch.long, 'cuda')
+
+    # Reductions implemented via `segment_csr` infer their size just like
+    # `segment_coo` does:
+    host_sync_count(reset=True)
+    assert segment_std_coo(x, idx).size(0) == 4
+    assert host_sync_count(reset=True) == 1
+
+    monkeypatch.setenv('TORCH_SCATTER_SYNC_MODE', 'cache')
+    for _ in range(3):
+        segment_coo(x, idx)
+        segment_std_coo(x, idx)
+    assert host_sync_count(reset=True) == 1
+
+    monkeypatch.setenv('TORCH_SCATTER_SYNC_MODE', 'strict')
+    assert segment_std_coo(x, idx).size(0) == 4
+    with pytest.raises(RuntimeError, match='dim_size'):
+        segment_std_coo(x, idx.clone())
+    assert host_sync_count() == 0
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason='CUDA not available')
+@pytest.mark.parametrize('reduce', reductions)
+def test_cuda_graph_capture(reduce):
+    x = tensor(src, torch.float, 'cuda')
+    idx = tensor(index, torch.long, 'cuda')
+    ptr = tensor(indptr, torch.long, 'cuda')
+
+    def fn():
+        out1 = segment_coo(x, idx, dim_size=4, reduce=reduce)
+        out2 = segment_csr(x, ptr, reduce=reduce)
+        out3 = gather_csr(out2, ptr, out=torch.empty_like(x))
+        out4 = scatter(x, idx, dim=0, dim_size=4, reduce=reduce)
+        return out1, out2, out3, out4
+
+    stream = torch.cuda.Stream()
+    stream.wait_stream(torch.cuda.current_stream())
+    with torch.cuda.stream(stream):  # Warmup outside of the graph.
+        fn()
+    torch.cuda.current_stream().wait_stream(stream)
+
+    graph = torch.cuda.CUDAGraph()
+    with torch.cuda.graph(graph):
+        outs = fn()
+
+    x.copy_(torch.randn_like(x))
+    graph.replay()
+    for out, expected in zip(outs, fn()):
+        assert torch.allclose(out, expected)
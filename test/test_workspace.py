@@ -0,0 +1,58 @@
+import pytest
+import torch
+from torch_scatter import (ScatterPlan, bind_workspace, scatter_softmax,
+                           workspace_stats)
+
+from .utils import devices
+
+
+def test_workspace():
+    for device in devices:
+        src = torch.randn(6, 4, device=device)
+        index = torch.tensor([0, 0, 1, 1, 1, 3], device=device)
+        expected = scatter_softmax(src, index, dim=0)
+
+        workspace_stats(reset=True)
+        out = scatter_softmax(src, index, dim=0)
+        stats = workspace_stats(reset=True)
+        assert torch.allclose(out, expected)
+        assert stats['hits'] == 0 and stats['misses'] == 0
+        assert stats['peak'] > 0
+
+        # Too small workspaces fall back to regular allocations:
+        buffer = torch.empty(16, dtype=torch.uint8, device=device)
+        bind_workspace(buffer)
+        out = scatter_softmax(src, index, dim=0)
+        assert torch.allclose(out, expected)
+        assert workspace_stats(reset=True)['misses'] > 0
+
+        buffer = torch.empty(stats['peak'], dtype=torch.uint8, device=device)
+        bind_workspace(buffer)
+        for _ in range(2):
+            out = scatter_softmax(src, index, dim=0)
+            assert torch.allclose(out, expected)
+        assert bind_workspace(None).data_ptr() == buffer.data_ptr()
+        stats = workspace_stats(reset=True)
+        # Maximum and sum of exponentials for each of both calls:
+        assert stats['hits'] == 4 and stats['misses'] == 0
+
+
+def test_plan_workspace():
+    for device in devices:
+        index = torch.tensor([0, 2, 1, 1, 1, 3], device=device)
+        src = torch.randn(6, 4, device=device)
+
+        plan = ScatterPlan(index, workspace_size=1 << 16)
+        expected = ScatterPlan(index).scatter_max(src, 0)
+        out = plan.scatter_max(src, 0)
+        assert torch.equal(out[0], expected[0])
+        assert torch.equal(out[1], expected[1])
+
+        # Previous bindings are restored, also in case a reduction raises:
+        buffer = torch.empty(16, dtype=torch.uint8, device=device)
+        bind_workspace(buffer)
+        plan.scatter(src, 0, reduce='sum')
+        with pytest.raises(ValueError):
+            plan.scatter(src, 0, reduce='foo')
+        assert bind_workspace(None).data_ptr() == buffer.data_ptr()
+        assert bind_workspace(None) is None
@@ -22,12 +22,22 @@ for library in ['_version', '_scatter', '_segment_csr', '_segment_coo']:
         torch.ops.torch_scatter.cuda_version = cuda_version_placeholder
 
         from .placeholder import scatter_placeholder
+        torch.ops.torch_scatter.scatter_sum = scatter_placeholder
         torch.ops.torch_scatter.scatter_mul = scatter_placeholder
+        torch.ops.torch_scatter.scatter_mean = scatter_placeholder
 
         from .placeholder import scatter_arg_placeholder
         torch.ops.torch_scatter.scatter_min = scatter_arg_placeholder
         torch.ops.torch_scatter.scatter_max = scatter_arg_placeholder
 
+        from .placeholder import scatter_weighted_placeholder
+        torch.ops.torch_scatter.scatter_weighted = scatter_weighted_placeholder
+
+        from .placeholder import scatter_softmax_placeholder
+        torch.ops.torch_scatter.scatter_softmax = scatter_softmax_placeholder
+        torch.ops.torch_scatter.scatter_log_softmax = \
+            scatter_softmax_placeholder
+
         from .placeholder import segment_csr_placeholder
         from .placeholder import segment_csr_arg_placeholder
         from .placeholder import gather_csr_placeholder
@@ -37,6 +47,35 @@ for library in ['_version', '_scatter', '_segment_csr', '_segment_coo']:
         torch.ops.torch_scatter.segment_max_csr = segment_csr_arg_placeholder
         torch.ops.torch_scatter.gather_csr = gather_csr_placeholder
 
+        from .placeholder import segment_csr_gather_placeholder
+        torch.ops.torch_scatter.segment_csr_gather = \
+            segment_csr_gather_placeholder
+
+        from .placeholder import segment_stat_csr_placeholder
+        torch.ops.torch_scatter.segment_var_csr = segment_stat_csr_placeholder
+        torch.ops.torch_scatter.segment_std_csr = segment_stat_csr_placeholder
+        from .placeholder import segment_logsumexp_csr_placeholder
+        torch.ops.torch_scatter.segment_logsumexp_csr = \
+            segment_logsumexp_csr_placeholder
+
+        from .placeholder import segment_csr_multi_placeholder
+        torch.ops.torch_scatter.segment_csr_multi = \
+            segment_csr_multi_placeholder
+
+        from .placeholder import segment_weighted_csr_placeholder
+        torch.ops.torch_scatter.segment_weighted_csr = \
+            segment_weighted_csr_placeholder
+
+        from .placeholder import segment_csr_batched_placeholder
+        torch.ops.torch_scatter.segment_csr_batched = \
+            segment_csr_batched_placeholder
+
+        from .placeholder import segment_softmax_csr_placeholder
+        torch.ops.torch_scatter.segment_softmax_csr = \
+            segment_softmax_csr_placeholder
+        torch.ops.torch_scatter.segment_log_softmax_csr = \
+            segment_softmax_csr_placeholder
+
         from .placeholder import segment_coo_placeholder
         from .placeholder import segment_coo_arg_placeholder
         from .placeholder import gather_coo_placeholder
@@ -46,6 +85,37 @@ for library in ['_version', '_scatter', '_segment_csr', '_segment_coo']:
         torch.ops.torch_scatter.segment_max_coo = segment_coo_arg_placeholder
         torch.ops.torch_scatter.gather_coo = gather_coo_placeholder
 
+        from .placeholder import segment_coo_dim_size_placeholder
+        torch.ops.torch_scatter.segment_coo_dim_size = \
+            segment_coo_dim_size_placeholder
+
+        from .placeholder import host_syncs_placeholder
+        torch.ops.torch_scatter.scatter_host_syncs = host_syncs_placeholder
+        torch.ops.torch_scatter.segment_coo_host_syncs = host_syncs_placeholder
+        torch.ops.torch_scatter.segment_csr_host_syncs = host_syncs_placeholder
+
+        from .placeholder import count_op_placeholder
+        from .placeholder import op_count_placeholder
+        torch.ops.torch_scatter.scatter_count_op = count_op_placeholder
+        torch.ops.torch_scatter.scatter_op_count = op_count_placeholder
+        torch.ops.torch_scatter.segment_coo_op_count = op_count_placeholder
+        torch.ops.torch_scatter.segment_csr_op_count = op_count_placeholder
+
+        from .placeholder import bind_workspace_placeholder
+        from .placeholder import workspace_stats_placeholder
+        torch.ops.torch_scatter.scatter_bind_workspace = \
+            bind_workspace_placeholder
+        torch.ops.torch_scatter.scatter_workspace_stats = \
+            workspace_stats_placeholder
+        torch.ops.torch_scatter.segment_coo_bind_workspace = \
+            bind_workspace_placeholder
+        torch.ops.torch_scatter.segment_coo_workspace_stats = \
+            workspace_stats_placeholder
+        torch.ops.torch_scatter.segment_csr_bind_workspace = \
+            bind_workspace_placeholder
+        torch.ops.torch_scatter.segment_csr_workspace_stats = \
+            workspace_stats_placeholder
+
 cuda_version = torch.ops.torch_scatter.cuda_version()
 if torch.version.cuda is not None and cuda_version != -1:  # pragma: no cover
     if cuda_version < 10000:
@@ -64,14 +134,28 @@ if torch.version.cuda is not None and cuda_version != -1:  # pragma: no cover
 
 from .scatter import scatter_sum, scatter_add, scatter_mul  # noqa
 from .scatter import scatter_mean, scatter_min, scatter_max, scatter  # noqa
+from .scatter import scatter_sort_permute, scatter_compact  # noqa
 from .segment_csr import segment_sum_csr, segment_add_csr  # noqa
 from .segment_csr import segment_mean_csr, segment_min_csr  # noqa
 from .segment_csr import segment_max_csr, segment_csr, gather_csr  # noqa
+from .segment_csr import segment_csr_gather, segment_softmax_csr  # noqa
+from .segment_csr import segment_var_csr, segment_std_csr  # noqa
+from .segment_csr import segment_logsumexp_csr, segment_csr_multi  # noqa
+from .segment_csr import segment_csr_batched  # noqa
 from .segment_coo import segment_sum_coo, segment_add_coo  # noqa
 from .segment_coo import segment_mean_coo, segment_min_coo  # noqa
 from .segment_coo import segment_max_coo, segment_coo, gather_coo  # noqa
+from .segment_coo import segment_var_coo, segment_std_coo  # noqa
+from .segment_coo import segment_logsumexp_coo, segment_coo_multi  # noqa
 from .composite import scatter_std, scatter_logsumexp  # noqa
 from .composite import scatter_softmax, scatter_log_softmax  # noqa
+from .plan import ScatterPlan  # noqa
+from .streaming import segment_csr_stream  # noqa
+from .distributed import scatter_distributed  # noqa
+from .distributed import segment_csr_distributed  # noqa
+from .sync import host_sync_count  # noqa
+from .profile import op_counters  # noqa
+from .workspace import bind_workspace, workspace_stats  # noqa
 
 __all__ = [
     'scatter_sum',
@@ -81,6 +165,8 @@ __all__ = [
     'scatter_min',
     'scatter_max',
     'scatter',
+    'scatter_sort_permute',
+    'scatter_compact',
     'segment_sum_csr',
     'segment_add_csr',
     'segment_mean_csr',
@@ -88,17 +174,36 @@ __all__ = [
     'segment_max_csr',
     'segment_csr',
     'gather_csr',
+    'segment_csr_gather',
+    'segment_softmax_csr',
+    'segment_var_csr',
+    'segment_std_csr',
+    'segment_logsumexp_csr',
+    'segment_csr_multi',
+    'segment_csr_batched',
     'segment_sum_coo',
     'segment_add_coo',
     'segment_mean_coo',
     'segment_min_coo',
     'segment_max_coo',
     'segment_coo',
+    'segment_var_coo',
+    'segment_std_coo',
+    'segment_logsumexp_coo',
+    'segment_coo_multi',
     'gather_coo',
     'scatter_std',
     'scatter_logsumexp',
     'scatter_softmax',
     'scatter_log_softmax',
+    'ScatterPlan',
+    'segment_csr_stream',
+    'scatter_distributed',
+    'segment_csr_distributed',
+    'host_sync_count',
+    'op_counters',
+    'bind_workspace',
+    'workspace_stats',
     'torch_scatter',
     '__version__',
 ]
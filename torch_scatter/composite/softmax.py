@@ -2,7 +2,6 @@ from typing import Optional
 
 import torch
 
-from torch_scatter import scatter_sum, scatter_max
 from torch_scatter.utils import broadcast
 
 
@@ -15,18 +14,9 @@ def scatter_softmax(src: torch.Tensor, index: torch.Tensor,
 
     index = broadcast(index, src, dim)
 
-    max_value_per_index = scatter_max(
-        src, index, dim=dim, dim_size=dim_size)[0]
-    max_per_src_element = max_value_per_index.gather(dim, index)
-
-    recentered_scores = src - max_per_src_element
-    recentered_scores_exp = recentered_scores.exp_()
-
-    sum_per_index = scatter_sum(
-        recentered_scores_exp, index, dim, dim_size=dim_size)
-    normalizing_constants = sum_per_index.gather(dim, index)
-
-    return recentered_scores_exp.div(normalizing_constants)
+    # Maxima and normalizers are computed natively, such that the output is
+    # written exactly once, and the backward pass is fused as well.
+    return torch.ops.torch_scatter.scatter_softmax(src, index, dim, dim_size)
 
 
 def scatter_log_softmax(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
@@ -38,14 +28,8 @@ def scatter_log_softmax(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
 
     index = broadcast(index, src, dim)
 
-    max_value_per_index = scatter_max(
-        src, index, dim=dim, dim_size=dim_size)[0]
-    max_per_src_element = max_value_per_index.gather(dim, index)
-
-    recentered_scores = src - max_per_src_element
-
-    sum_per_index = scatter_sum(
-        recentered_scores.exp(), index, dim, dim_size=dim_size)
-    normalizing_constants = sum_per_index.add_(eps).log_().gather(dim, index)
-
-    return recentered_scores.sub_(normalizing_constants)
+    # The normalizer of each non-empty group is at least one after
+    # subtracting its maximum, such that `eps` is not needed for stability
+    # and only kept for backward compatibility.
+    return torch.ops.torch_scatter.scatter_log_softmax(src, index, dim,
+                                                       dim_size)
@@ -0,0 +1,204 @@
+from typing import Any, Optional, Tuple
+
+import torch
+import torch.distributed as dist
+
+from .scatter import scatter, scatter_max, scatter_min
+from .segment_csr import segment_csr, segment_max_csr, segment_min_csr
+
+
+def all_to_all(x: torch.Tensor, group: Optional[Any]) -> torch.Tensor:
+    # Sends the `i`-th of `world_size` equally sized chunks of `x` along the
+    # first dimension to rank `i`, and returns the received chunks
+    # concatenated in rank order.
+    out = torch.empty_like(x)
+    dist.all_to_all_single(out, x.contiguous(), group=group)
+    return out
+
+
+class AllToAll(torch.autograd.Function):
+    # Exchanging equally sized chunks is its own adjoint operation.
+    @staticmethod
+    def forward(ctx, x, group):
+        ctx.group = group
+        return all_to_all(x, group)
+
+    @staticmethod
+    def backward(ctx, grad_out):
+        return all_to_all(grad_out, ctx.group), None
+
+
+def shard_offset(size: int, device: torch.device,
+                 group: Optional[Any]) -> Tuple[int, int]:
+    # Returns the offset of the local shard within the global source tensor,
+    # i.e., the concatenation of all shards in rank order, and its size.
+    world_size = dist.get_world_size(group)
+    sizes = [
+        torch.zeros(1, dtype=torch.long, device=device)
+        for _ in range(world_size)
+    ]
+    dist.all_gather(sizes, torch.tensor([size], device=device), group=group)
+    sizes = [int(s) for s in sizes]
+    return sum(sizes[:dist.get_rank(group)]), sum(sizes)
+
+
+def combine(out: torch.Tensor, arg_out: Optional[torch.Tensor],
+            count: Optional[torch.Tensor], reduce: str, num_src: int,
+            group: Optional[Any]
+            ) -> Tuple[torch.Tensor, Optional[torch.Tensor]]:
+    # Combines the partial outputs `out` of all ranks, which are reduced along
+    # their first dimension with size `dim_size`, such that each rank receives
+    # the result for its partition of `ceil(dim_size / world_size)` rows.
+    # For MIN/MAX, `arg_out` needs to hold global arguments, and `num_src` for
+    # rows the local shard does not contribute to.
+    world_size, rank = dist.get_world_size(group), dist.get_rank(group)
+    dim_size = out.size(0)
+    rows = (dim_size + world_size - 1) // world_size
+    length = max(min(rows, dim_size - rank * rows), 0)
+
+    def exchange(x: torch.Tensor, differentiable: bool) -> torch.Tensor:
+        pad = [0, 0] * (x.dim() - 1) + [0, world_size * rows - dim_size]
+        x = torch.nn.functional.pad(x, pad)
+        if differentiable:
+            x = AllToAll.apply(x, group)
+        else:
+            x = all_to_all(x, group)
+        return x.view([world_size, rows] + list(x.size())[1:])[:, :length]
+
+    if reduce == 'sum' or reduce == 'add':
+        return exchange(out, True).sum(0), None
+
+    if reduce == 'mean':
+        assert count is not None
+        count = exchange(count, False).sum(0).clamp_(min=1)
+        count = count.view([-1] + [1] * (out.dim() - 1))
+        out = exchange(out, True).sum(0)
+        if out.is_floating_point():
+            return out / count, None
+        return torch.div(out, count, rounding_mode='floor'), None
+
+    # MIN/MAX: Ties across ranks are broken in favor of the smallest global
+    # argument, and gradients only flow to the partial output of the winner.
+    assert arg_out is not None
+    outs = exchange(out, True)
+    args = exchange(arg_out, False)
+    if outs.is_floating_point():
+        info = torch.finfo(outs.dtype)
+    else:
+        info = torch.iinfo(outs.dtype)
+    fill = info.max if reduce == 'min' else info.min
+    values = outs.detach().masked_fill(args == num_src, fill)
+    if reduce == 'min':
+        best = values.amin(0, keepdim=True)
+    else:
+        best = values.amax(0, keepdim=True)
+    args = args.masked_fill(values != best, num_src)
+    arg_out = args.amin(0)
+    winner = (args == arg_out.unsqueeze(0)).to(torch.uint8).argmax(0)
+    out = outs.gather(0, winner.unsqueeze(0)).squeeze(0)
+    return out.masked_fill(arg_out == num_src, 0), arg_out
+
+
+def global_arg(arg_out: torch.Tensor, size: int, offset: int,
+               num_src: int) -> torch.Tensor:
+    # Maps arguments within the local shard of `size` entries to arguments
+    # within the global source tensor.
+    return torch.where(arg_out < size, arg_out + offset,
+                       torch.full_like(arg_out, num_src))
+
+
+def scatter_distributed(
+        src: torch.Tensor, index: torch.Tensor, dim: int, dim_size: int,
+        reduce: str = "sum", group: Optional[Any] = None
+) -> Tuple[torch.Tensor, Optional[torch.Tensor]]:
+    r"""Computes :meth:`scatter` over a source tensor that is sharded along
+    :attr:`dim` across all ranks of the process :attr:`group`, such that
+    each rank only holds the output rows of its partition.
+
+    Each rank passes its shard :attr:`src` together with the global output
+    indices :attr:`index` of its entries.
+    Shards are reduced locally via :meth:`scatter`, and partial outputs are
+    exchanged via a single all-to-all between the owners of output rows.
+    Rank :obj:`r` receives the output rows
+    :obj:`[r * ceil(dim_size / world_size), (r + 1) * ceil(dim_size /
+    world_size))`, reduced over all shards in rank order.
+
+    For :obj:`"min"` and :obj:`"max"`, arguments are returned with respect to
+    the global source tensor, *i.e.*, the concatenation of all shards in rank
+    order, and ties across ranks are broken in favor of the smallest one.
+    Output rows without any entries are filled with zero and an argument of
+    the global source size.
+    All reductions are differentiable with respect to :attr:`src`.
+
+    :param src: The local shard of the source tensor.
+    :param index: The one-dimensional global output indices of :attr:`src`.
+    :param dim: The axis along which to index.
+    :param dim_size: The global size of the output at dimension :attr:`dim`.
+    :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
+        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+    :param group: The process group to work on. (default: :obj:`None`)
+
+    :rtype: (:class:`Tensor`, :class:`LongTensor` or :obj:`None`)
+    """
+    dim = src.dim() + dim if dim < 0 else dim
+    assert index.dim() == 1 and index.numel() == src.size(dim)
+
+    if reduce == 'sum' or reduce == 'add':
+        out = scatter(src, index, dim, dim_size=dim_size, reduce='sum')
+        out, arg_out = combine(out.movedim(dim, 0), None, None, reduce, 0,
+                               group)
+    elif reduce == 'mean':
+        out = scatter(src, index, dim, dim_size=dim_size, reduce='sum')
+        count = torch.bincount(index, minlength=dim_size)
+        out, arg_out = combine(out.movedim(dim, 0), None, count, reduce, 0,
+                               group)
+    elif reduce == 'min' or reduce == 'max':
+        fn = scatter_min if reduce == 'min' else scatter_max
+        out, arg_out = fn(src, index, dim, dim_size=dim_size)
+        offset, num_src = shard_offset(src.size(dim), src.device, group)
+        arg_out = global_arg(arg_out, src.size(dim), offset, num_src)
+        out, arg_out = combine(out.movedim(dim, 0), arg_out.movedim(dim, 0),
+                               None, reduce, num_src, group)
+        arg_out = arg_out.movedim(0, dim)
+    else:
+        raise ValueError
+    return out.movedim(0, dim), arg_out
+
+
+def segment_csr_distributed(
+        src: torch.Tensor, indptr: torch.Tensor, reduce: str = "sum",
+        group: Optional[Any] = None
+) -> Tuple[torch.Tensor, Optional[torch.Tensor]]:
+    r"""Computes :meth:`segment_csr` over a source tensor that is sharded
+    along its first dimension across all ranks of the process :attr:`group`.
+    Each rank passes its shard :attr:`src` of consecutive entries (in rank
+    order) together with the one-dimensional global index pointers
+    :attr:`indptr`. See :meth:`scatter_distributed` for the partitioning of
+    outputs and the semantics of arguments.
+
+    :param src: The local shard of the source tensor.
+    :param indptr: The one-dimensional global index pointers.
+    :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
+        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+    :param group: The process group to work on. (default: :obj:`None`)
+
+    :rtype: (:class:`Tensor`, :class:`LongTensor` or :obj:`None`)
+    """
+    assert indptr.dim() == 1
+    offset, num_src = shard_offset(src.size(0), src.device, group)
+    local_indptr = (indptr - offset).clamp(0, src.size(0))
+
+    if reduce == 'sum' or reduce == 'add':
+        out = segment_csr(src, local_indptr, reduce='sum')
+        return combine(out, None, None, reduce, num_src, group)
+    elif reduce == 'mean':
+        out = segment_csr(src, local_indptr, reduce='sum')
+        count = local_indptr[1:] - local_indptr[:-1]
+        return combine(out, None, count, reduce, num_src, group)
+    elif reduce == 'min' or reduce == 'max':
+        fn = segment_min_csr if reduce == 'min' else segment_max_csr
+        out, arg_out = fn(src, local_indptr)
+        arg_out = global_arg(arg_out, src.size(0), offset, num_src)
+        return combine(out, arg_out, None, reduce, num_src, group)
+    else:
+        raise ValueError
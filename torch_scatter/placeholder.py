@@ -1,4 +1,4 @@
-from typing import Optional, Tuple
+from typing import Dict, List, Optional, Tuple
 
 import torch
 
@@ -22,6 +22,21 @@ def scatter_arg_placeholder(src: torch.Tensor, index: torch.Tensor, dim: int,
     return src, index
 
 
+def scatter_weighted_placeholder(src: torch.Tensor, index: torch.Tensor,
+                                 weight: torch.Tensor, dim: int,
+                                 dim_size: Optional[int],
+                                 reduce: str) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
+def scatter_softmax_placeholder(src: torch.Tensor, index: torch.Tensor,
+                                dim: int,
+                                dim_size: Optional[int]) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
 def segment_csr_placeholder(src: torch.Tensor, indptr: torch.Tensor,
                             out: Optional[torch.Tensor]) -> torch.Tensor:
     raise ImportError
@@ -41,6 +56,53 @@ def gather_csr_placeholder(src: torch.Tensor, indptr: torch.Tensor,
     return src
 
 
+def segment_csr_gather_placeholder(src: torch.Tensor, indptr: torch.Tensor,
+                                   col: torch.Tensor,
+                                   edge_weight: Optional[torch.Tensor],
+                                   reduce: str) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
+def segment_stat_csr_placeholder(src: torch.Tensor, indptr: torch.Tensor,
+                                 unbiased: bool) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
+def segment_logsumexp_csr_placeholder(src: torch.Tensor,
+                                      indptr: torch.Tensor) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
+def segment_csr_multi_placeholder(src: torch.Tensor, indptr: torch.Tensor,
+                                  reduces: List[str],
+                                  unbiased: bool) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
+def segment_weighted_csr_placeholder(src: torch.Tensor, indptr: torch.Tensor,
+                                     weight: torch.Tensor,
+                                     reduce: str) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
+def segment_csr_batched_placeholder(srcs: List[torch.Tensor],
+                                    indptrs: List[torch.Tensor],
+                                    reduce: str) -> List[torch.Tensor]:
+    raise ImportError
+    return srcs
+
+
+def segment_softmax_csr_placeholder(src: torch.Tensor,
+                                    indptr: torch.Tensor) -> torch.Tensor:
+    raise ImportError
+    return src
+
+
 def segment_coo_placeholder(src: torch.Tensor, index: torch.Tensor,
                             out: Optional[torch.Tensor],
                             dim_size: Optional[int]) -> torch.Tensor:
@@ -60,3 +122,29 @@ def gather_coo_placeholder(src: torch.Tensor, index: torch.Tensor,
                            out: Optional[torch.Tensor]) -> torch.Tensor:
     raise ImportError
     return src
+
+
+def segment_coo_dim_size_placeholder(index: torch.Tensor) -> int:
+    raise ImportError
+    return 0
+
+
+def host_syncs_placeholder(reset: bool) -> int:
+    return 0
+
+
+def count_op_placeholder(op: str, tensors: List[torch.Tensor]) -> None:
+    pass
+
+
+def op_count_placeholder(reset: bool) -> Dict[str, List[int]]:
+    return {}
+
+
+def bind_workspace_placeholder(
+        buffer: Optional[torch.Tensor]) -> Optional[torch.Tensor]:
+    return None
+
+
+def workspace_stats_placeholder(reset: bool) -> List[int]:
+    return [0, 0, 0]
@@ -0,0 +1,163 @@
+from typing import Any, List, Optional, Tuple
+
+import torch
+
+from .workspace import bind_workspace
+
+
+class _WorkspaceBinding(object):
+    # Binds `workspace` (if given) within a `with` block, and restores the
+    # previously bound workspace on exit, also in case the block raises.
+    def __init__(self, workspace: Optional[torch.Tensor]):
+        self.workspace = workspace
+        self.previous: Optional[torch.Tensor] = None
+
+    def __enter__(self):
+        if self.workspace is not None:
+            self.previous = bind_workspace(self.workspace)
+
+    def __exit__(self, type: Any, value: Any, traceback: Any):
+        if self.workspace is not None:
+            bind_workspace(self.previous)
+
+
+class ScatterPlan(object):
+    r"""Analyzes a one-dimensional :attr:`index` tensor once, such that
+    subsequent reductions via the same :attr:`index` (*e.g.*, across layers,
+    attention heads and the backward pass of a GNN) do not need to recompute
+    its output size, its sortedness or its compressed representation.
+
+    In case :attr:`index` is sorted, all reductions are performed via
+    :meth:`segment_csr`, which does not require any atomic operations and is
+    deterministic.
+    Otherwise, reductions fall back to :meth:`scatter` with a known output
+    size, which avoids a host-device sync on the GPU.
+
+    The plan can be passed to and used inside of TorchScript functions.
+
+    :param index: The indices of elements to scatter.
+    :param dim_size: The size of the output. If not given, it is inferred as
+        :obj:`index.max() + 1`. (default: :obj:`None`)
+    :param is_sorted: Whether :attr:`index` is sorted in ascending order. If
+        not given, this is checked once. (default: :obj:`None`)
+    :param workspace_size: If set to a positive number of bytes, allocates a
+        workspace on the device of :attr:`index` which is bound via
+        :meth:`torch_scatter.bind_workspace` during all reductions of the
+        plan, such that their scratch buffers are not re-allocated on every
+        call. The plan must then only be used on a single stream.
+        (default: :obj:`0`)
+
+    .. code-block:: python
+
+        from torch_scatter import ScatterPlan
+
+        index = torch.tensor([0, 0, 1, 1, 1, 3])
+        plan = ScatterPlan(index)
+
+        src = torch.randn(6, 16)
+        out1 = plan.scatter(src, dim=0, reduce="sum")
+        out2, argmax = plan.scatter_max(src, dim=0)
+    """
+    def __init__(self, index: torch.Tensor, dim_size: Optional[int] = None,
+                 is_sorted: Optional[bool] = None, workspace_size: int = 0):
+        assert index.dim() == 1
+
+        if dim_size is None:
+            dim_size = int(index.max()) + 1 if index.numel() > 0 else 0
+        if is_sorted is None:
+            is_sorted = bool((index[1:] >= index[:-1]).all())
+
+        self.index = index
+        self.dim_size: int = dim_size
+        self.is_sorted: bool = is_sorted
+
+        self.indptr: Optional[torch.Tensor] = None
+        if is_sorted:
+            count = torch.bincount(index, minlength=dim_size)
+            indptr = torch.cat([count.new_zeros(1), count.cumsum(0)])
+            self.indptr = indptr.to(index.dtype)
+
+        self.workspace: Optional[torch.Tensor] = None
+        if workspace_size > 0:
+            self.workspace = torch.empty(workspace_size, dtype=torch.uint8,
+                                         device=index.device)
+
+    def _indptr(self, src: torch.Tensor, dim: int) -> torch.Tensor:
+        indptr = self.indptr
+        assert indptr is not None
+        size: List[int] = list(src.size())[:dim] + [indptr.numel()]
+        return indptr.view([1] * dim + [-1]).expand(size)
+
+    def scatter(self, src: torch.Tensor, dim: int = -1,
+                reduce: str = "sum") -> torch.Tensor:
+        r"""Equals :obj:`scatter(src, index, dim, dim_size=dim_size,
+        reduce=reduce)`."""
+        with _WorkspaceBinding(self.workspace):
+            out = self._scatter(src, dim, reduce)
+        return out
+
+    def _scatter(self, src: torch.Tensor, dim: int,
+                 reduce: str) -> torch.Tensor:
+        dim = src.dim() + dim if dim < 0 else dim
+        if reduce == 'sum' or reduce == 'add':
+            if self.is_sorted:
+                return torch.ops.torch_scatter.segment_sum_csr(
+                    src, self._indptr(src, dim), None)
+            return torch.ops.torch_scatter.scatter_sum(
+                src, self.index, dim, None, self.dim_size)
+        elif reduce == 'mul':
+            return torch.ops.torch_scatter.scatter_mul(
+                src, self.index, dim, None, self.dim_size)
+        elif reduce == 'mean':
+            if self.is_sorted:
+                return torch.ops.torch_scatter.segment_mean_csr(
+                    src, self._indptr(src, dim), None)
+            return torch.ops.torch_scatter.scatter_mean(
+                src, self.index, dim, None, self.dim_size)
+        elif reduce == 'min':
+            return self._scatter_min(src, dim)[0]
+        elif reduce == 'max':
+            return self._scatter_max(src, dim)[0]
+        else:
+            raise ValueError
+
+    def scatter_min(self, src: torch.Tensor,
+                    dim: int = -1) -> Tuple[torch.Tensor, torch.Tensor]:
+        r"""Equals :obj:`scatter_min(src, index, dim, dim_size=dim_size)`."""
+        with _WorkspaceBinding(self.workspace):
+            out = self._scatter_min(src, dim)
+        return out
+
+    def _scatter_min(self, src: torch.Tensor,
+                     dim: int) -> Tuple[torch.Tensor, torch.Tensor]:
+        dim = src.dim() + dim if dim < 0 else dim
+        if self.is_sorted:
+            return torch.ops.torch_scatter.segment_min_csr(
+                src, self._indptr(src, dim), None)
+        return torch.ops.torch_scatter.scatter_min(src, self.index, dim, None,
+                                                   self.dim_size)
+
+    def scatter_max(self, src: torch.Tensor,
+                    dim: int = -1) -> Tuple[torch.Tensor, torch.Tensor]:
+        r"""Equals :obj:`scatter_max(src, index, dim, dim_size=dim_size)`."""
+        with _WorkspaceBinding(self.workspace):
+            out = self._scatter_max(src, dim)
+        return out
+
+    def _scatter_max(self, src: torch.Tensor,
+                     dim: int) -> Tuple[torch.Tensor, torch.Tensor]:
+        dim = src.dim() + dim if dim < 0 else dim
+        if self.is_sorted:
+            return torch.ops.torch_scatter.segment_max_csr(
+                src, self._indptr(src, dim), None)
+        return torch.ops.torch_scatter.scatter_max(src, self.index, dim, None,
+                                                   self.dim_size)
+
+    def gather(self, src: torch.Tensor, dim: int = -1) -> torch.Tensor:
+        r"""Equals :obj:`src.index_select(dim, index)`, *i.e.*, the inverse
+        operation of :meth:`scatter`."""
+        dim = src.dim() + dim if dim < 0 else dim
+        if self.is_sorted:
+            return torch.ops.torch_scatter.gather_csr(
+                src, self._indptr(src, dim), None)
+        return src.index_select(dim, self.index)
@@ -0,0 +1,38 @@
+from typing import Dict
+
+import torch
+
+
+def op_counters(reset: bool = False) -> Dict[str, Dict[str, int]]:
+    r"""Returns the number of forward calls of each operator performed so far
+    (not counting calls made within backward passes), keyed by operator name
+    (*e.g.*, :obj:`"scatter_sum"` or :obj:`"segment_max_csr"`), together with
+    the number of bytes they read from and wrote to their :attr:`src`,
+    :attr:`index` (or :attr:`indptr`) and :attr:`out` tensors.
+    Operators that have not been called are omitted.
+
+    In addition, all kernels open profiler ranges which are named after the
+    applied reduction (*e.g.*, :obj:`"torch_scatter::segment_sum_csr"`), and
+    on the GPU, nested ranges that name the picked kernel variant together
+    with the problem size, *e.g.*,
+    :obj:`"torch_scatter::segment_csr_cuda[broadcast](E=..., K=..., N=...)"`.
+    These show up in :obj:`torch.profiler` traces, and as NVTX ranges within
+    :obj:`torch.autograd.profiler.emit_nvtx()`.
+    Host-device syncs are recorded as :obj:`"torch_scatter::host_sync"`.
+
+    :param reset: If set to :obj:`True`, resets all counters to zero.
+        (default: :obj:`False`)
+
+    :rtype: :class:`Dict[str, Dict[str, int]]`
+    """
+    # Each extension only reports the operators it implements:
+    counts = torch.ops.torch_scatter.scatter_op_count(reset)
+    counts.update(torch.ops.torch_scatter.segment_coo_op_count(reset))
+    counts.update(torch.ops.torch_scatter.segment_csr_op_count(reset))
+    return {
+        key: {
+            'calls': count[0],
+            'bytes': count[1]
+        }
+        for key, count in counts.items()
+    }
@@ -5,10 +5,33 @@ import torch
 from .utils import broadcast
 
 
+def coo_index(src: torch.Tensor, index: torch.Tensor,
+              dim: int) -> torch.Tensor:
+    # Reshapes a one-dimensional sorted `index` such that `segment_coo` reduces
+    # along `dim` of `src`.
+    dim = src.dim() + dim if dim < 0 else dim
+    return index.view([1] * dim + [-1]).expand(src.size()[:dim + 1])
+
+
+def use_coo(index: torch.Tensor, out: Optional[torch.Tensor],
+            assume_sorted: bool) -> bool:
+    # `segment_coo` pre-reduces consecutive entries of equal indices, which
+    # saves most of the atomic operations of `scatter` on GPU.
+    return assume_sorted and index.dim() == 1 and out is None
+
+
 def scatter_sum(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
                 out: Optional[torch.Tensor] = None,
-                dim_size: Optional[int] = None) -> torch.Tensor:
-    index = broadcast(index, src, dim)
+                dim_size: Optional[int] = None,
+                assume_sorted: bool = False) -> torch.Tensor:
+    if use_coo(index, out, assume_sorted):
+        return torch.ops.torch_scatter.segment_sum_coo(
+            src, coo_index(src, index, dim), None, dim_size)
+    # PyTorch's `scatter_add_` needs `int64`, and on GPU we need to follow
+    # both `TORCH_SCATTER_SYNC_MODE` and `torch.use_deterministic_algorithms`:
+    if index.dtype != torch.long or index.is_cuda:
+        return torch.ops.torch_scatter.scatter_sum(src, index, dim, out,
+                                                   dim_size)
     if out is None:
         size = list(src.size())
         if dim_size is not None:
@@ -17,16 +40,21 @@ def scatter_sum(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
             size[dim] = 0
         else:
             size[dim] = int(index.max()) + 1
-        out = torch.zeros(size, dtype=src.dtype, device=src.device)
-        return out.scatter_add_(dim, index, src)
+        result = torch.zeros(size, dtype=src.dtype, device=src.device)
     else:
-        return out.scatter_add_(dim, index, src)
+        result = out
+    result.scatter_add_(dim, broadcast(index, src, dim), src)
+    # Counted with the original `index`, as done on GPU:
+    torch.ops.torch_scatter.scatter_count_op('scatter_sum',
+                                             [src, index, result])
+    return result
 
 
 def scatter_add(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
                 out: Optional[torch.Tensor] = None,
-                dim_size: Optional[int] = None) -> torch.Tensor:
-    return scatter_sum(src, index, dim, out, dim_size)
+                dim_size: Optional[int] = None,
+                assume_sorted: bool = False) -> torch.Tensor:
+    return scatter_sum(src, index, dim, out, dim_size, assume_sorted)
 
 
 def scatter_mul(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
@@ -37,44 +65,64 @@ def scatter_mul(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
 
 def scatter_mean(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
                  out: Optional[torch.Tensor] = None,
-                 dim_size: Optional[int] = None) -> torch.Tensor:
-    out = scatter_sum(src, index, dim, out, dim_size)
-    dim_size = out.size(dim)
-
-    index_dim = dim
-    if index_dim < 0:
-        index_dim = index_dim + src.dim()
-    if index.dim() <= index_dim:
-        index_dim = index.dim() - 1
-
-    ones = torch.ones(index.size(), dtype=src.dtype, device=src.device)
-    count = scatter_sum(ones, index, index_dim, None, dim_size)
-    count[count < 1] = 1
-    count = broadcast(count, out, dim)
-    if out.is_floating_point():
-        out.true_divide_(count)
-    else:
-        out.div_(count, rounding_mode='floor')
-    return out
+                 dim_size: Optional[int] = None,
+                 assume_sorted: bool = False) -> torch.Tensor:
+    if use_coo(index, out, assume_sorted):
+        return torch.ops.torch_scatter.segment_mean_coo(
+            src, coo_index(src, index, dim), None, dim_size)
+    return torch.ops.torch_scatter.scatter_mean(src, index, dim, out, dim_size)
 
 
 def scatter_min(
         src: torch.Tensor, index: torch.Tensor, dim: int = -1,
-        out: Optional[torch.Tensor] = None,
-        dim_size: Optional[int] = None) -> Tuple[torch.Tensor, torch.Tensor]:
+        out: Optional[torch.Tensor] = None, dim_size: Optional[int] = None,
+        assume_sorted: bool = False) -> Tuple[torch.Tensor, torch.Tensor]:
+    if use_coo(index, out, assume_sorted):
+        return torch.ops.torch_scatter.segment_min_coo(
+            src, coo_index(src, index, dim), None, dim_size)
     return torch.ops.torch_scatter.scatter_min(src, index, dim, out, dim_size)
 
 
 def scatter_max(
         src: torch.Tensor, index: torch.Tensor, dim: int = -1,
-        out: Optional[torch.Tensor] = None,
-        dim_size: Optional[int] = None) -> Tuple[torch.Tensor, torch.Tensor]:
+        out: Optional[torch.Tensor] = None, dim_size: Optional[int] = None,
+        assume_sorted: bool = False) -> Tuple[torch.Tensor, torch.Tensor]:
+    if use_coo(index, out, assume_sorted):
+        return torch.ops.torch_scatter.segment_max_coo(
+            src, coo_index(src, index, dim), None, dim_size)
     return torch.ops.torch_scatter.scatter_max(src, index, dim, out, dim_size)
 
 
+def scatter_sort_permute(
+        index: torch.Tensor) -> Tuple[torch.Tensor, torch.Tensor]:
+    r"""Sorts a one-dimensional :attr:`index` tensor and returns it together
+    with the permutation :obj:`perm` that sorts it, such that
+
+    .. code-block:: python
+
+        scatter(src.index_select(dim, perm), index[perm], dim,
+                assume_sorted=True)
+
+    equals :obj:`scatter(src, index, dim)`.
+    This allows pipelines that scatter via the same :attr:`index` multiple
+    times to pay for sorting only once.
+    Note that :obj:`scatter_min` and :obj:`scatter_max` then return arguments
+    with respect to the permuted :attr:`src`, which can be mapped back via
+    :obj:`perm[arg]`.
+
+    :param index: The indices of elements to scatter.
+
+    :rtype: (:class:`Tensor`, :class:`LongTensor`)
+    """
+    assert index.dim() == 1
+    index, perm = torch.sort(index, stable=True)
+    return index, perm
+
+
 def scatter(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
             out: Optional[torch.Tensor] = None, dim_size: Optional[int] = None,
-            reduce: str = "sum") -> torch.Tensor:
+            reduce: str = "sum", assume_sorted: bool = False,
+            weight: Optional[torch.Tensor] = None) -> torch.Tensor:
     r"""
     |
 
@@ -118,6 +166,10 @@ def scatter(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
         to the same value is undetermined.
         For floating-point variables, this results in a source of variance in
         the result.
+        If :obj:`torch.use_deterministic_algorithms(True)` is set,
+        :obj:`"sum"`, :obj:`"mean"` and :obj:`"mul"` reduce over a stably
+        sorted :attr:`index` without atomic operations instead, which yields
+        bitwise reproducible results at the cost of an additional sort.
 
     :param src: The source tensor.
     :param index: The indices of elements to scatter.
@@ -129,6 +181,21 @@ def scatter(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
         according to :obj:`index.max() + 1` is returned.
     :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mul"`,
         :obj:`"mean"`, :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+    :param assume_sorted: If set to :obj:`True`, assumes that a
+        one-dimensional :attr:`index` is sorted in ascending order, and
+        reduces via :meth:`segment_coo` instead, which requires far fewer
+        atomic operations on the GPU.
+        Has no effect in case :attr:`out` is given or :obj:`reduce="mul"`.
+        See :meth:`scatter_sort_permute` for sorting :attr:`index` once up
+        front. (default: :obj:`False`)
+    :param weight: If given, a one-dimensional tensor holding a scale for each
+        entry of :attr:`src` along :attr:`dim`, such that
+        :obj:`weight.view(-1, 1) * src` is reduced for :obj:`dim=0` without
+        ever materializing the weighted source tensor.
+        Only supported for :obj:`"sum"`, :obj:`"mean"`, :obj:`"min"` and
+        :obj:`"max"`, and in case :attr:`out` is not given.
+        Gradients are computed for both :attr:`src` and :attr:`weight`.
+        (default: :obj:`None`)
 
     :rtype: :class:`Tensor`
 
@@ -148,15 +215,86 @@ def scatter(src: torch.Tensor, index: torch.Tensor, dim: int = -1,
 
         torch.Size([10, 3, 64])
     """
+    if weight is not None:
+        if out is not None:
+            raise ValueError('`weight` is not supported in case `out` is '
+                             'given')
+        reduce = 'sum' if reduce == 'add' else reduce
+        return torch.ops.torch_scatter.scatter_weighted(
+            src, index, weight, dim, dim_size, reduce)
     if reduce == 'sum' or reduce == 'add':
-        return scatter_sum(src, index, dim, out, dim_size)
+        return scatter_sum(src, index, dim, out, dim_size, assume_sorted)
     if reduce == 'mul':
         return scatter_mul(src, index, dim, out, dim_size)
     elif reduce == 'mean':
-        return scatter_mean(src, index, dim, out, dim_size)
+        return scatter_mean(src, index, dim, out, dim_size, assume_sorted)
     elif reduce == 'min':
-        return scatter_min(src, index, dim, out, dim_size)[0]
+        return scatter_min(src, index, dim, out, dim_size, assume_sorted)[0]
     elif reduce == 'max':
-        return scatter_max(src, index, dim, out, dim_size)[0]
+        return scatter_max(src, index, dim, out, dim_size, assume_sorted)[0]
     else:
         raise ValueError
+
+
+def scatter_compact(
+        src: torch.Tensor, index: torch.Tensor, dim: int = -1,
+        reduce: str = "sum",
+        assume_sorted: bool = False) -> Tuple[torch.Tensor, torch.Tensor]:
+    r"""Reduces all values from the :attr:`src` tensor at the indices
+    specified in the one-dimensional :attr:`index` tensor along a given axis
+    :attr:`dim` just like :meth:`scatter`, but only returns the rows of the
+    output that receive at least one element, together with their indices
+    :obj:`unique_index` (in ascending order), such that
+
+    .. code-block:: python
+
+        scatter(src, index, dim, dim_size=int(index.max()) + 1,
+                reduce=reduce).index_select(dim, unique_index)
+
+    equals :obj:`out`.
+    Since the output is never materialized for all :obj:`index.max() + 1`
+    rows, runtime and memory scale with :obj:`index.numel()` rather than
+    with the output size, which pays off for very sparse :attr:`index`
+    tensors, *e.g.*, when scattering the nodes of a sampled mini-batch into
+    a global node table.
+    Gradients are computed for :attr:`src`.
+
+    :param src: The source tensor.
+    :param index: The one-dimensional indices of elements to scatter.
+    :param dim: The axis along which to index. (default: :obj:`-1`)
+    :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mul"`,
+        :obj:`"mean"`, :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+    :param assume_sorted: If set to :obj:`True`, assumes that :attr:`index`
+        is sorted in ascending order, which avoids sorting it and reduces via
+        :meth:`segment_coo` instead. (default: :obj:`False`)
+
+    :rtype: (:class:`LongTensor`, :class:`Tensor`)
+
+    .. code-block:: python
+
+        from torch_scatter import scatter_compact
+
+        src = torch.randn(4, 64)
+        index = torch.tensor([1000000, 7, 1000000, 42])
+
+        unique_index, out = scatter_compact(src, index, dim=0)
+
+        print(unique_index, out.size())
+
+    .. code-block::
+
+        tensor([      7,      42, 1000000]) torch.Size([3, 64])
+    """
+    assert index.dim() == 1
+    if assume_sorted:
+        unique_index, inverse = torch.unique_consecutive(
+            index, return_inverse=True)
+    else:
+        unique_index, inverse = torch.unique(index, sorted=True,
+                                             return_inverse=True)
+    # `inverse` holds dense indices in `[0, unique_index.numel())`, which
+    # keeps all outputs (and the `masked_fill_` of empty `"min"` and `"max"`
+    # rows) at the size of `unique_index`:
+    out = scatter(src, inverse, dim, dim_size=unique_index.numel(),
+                  reduce=reduce, assume_sorted=assume_sorted)
+    return unique_index, out
@@ -1,4 +1,4 @@
-from typing import Optional, Tuple
+from typing import List, Optional, Tuple
 
 import torch
 
@@ -35,10 +35,54 @@ def segment_max_coo(
     return torch.ops.torch_scatter.segment_max_coo(src, index, out, dim_size)
 
 
+def coo_to_csr(index: torch.Tensor,
+               dim_size: Optional[int] = None) -> torch.Tensor:
+    # Converts a sorted `index` into index pointers along its last dimension,
+    # for reductions that are only implemented via `segment_csr`. The output
+    # size is inferred just like in `segment_coo`, *i.e.*, respecting the
+    # `TORCH_SCATTER_SYNC_MODE`.
+    if dim_size is None:
+        dim_size = torch.ops.torch_scatter.segment_coo_dim_size(index)
+    size = list(index.size())[:-1] + [dim_size + 1]
+    bins = torch.arange(dim_size + 1, dtype=index.dtype, device=index.device)
+    return torch.searchsorted(index.contiguous(),
+                              bins.expand(size).contiguous())
+
+
+def segment_var_coo(src: torch.Tensor, index: torch.Tensor,
+                    dim_size: Optional[int] = None,
+                    unbiased: bool = True) -> torch.Tensor:
+    return torch.ops.torch_scatter.segment_var_csr(
+        src, coo_to_csr(index, dim_size), unbiased)
+
+
+def segment_std_coo(src: torch.Tensor, index: torch.Tensor,
+                    dim_size: Optional[int] = None,
+                    unbiased: bool = True) -> torch.Tensor:
+    return torch.ops.torch_scatter.segment_std_csr(
+        src, coo_to_csr(index, dim_size), unbiased)
+
+
+def segment_logsumexp_coo(src: torch.Tensor, index: torch.Tensor,
+                          dim_size: Optional[int] = None) -> torch.Tensor:
+    return torch.ops.torch_scatter.segment_logsumexp_csr(
+        src, coo_to_csr(index, dim_size))
+
+
+def segment_coo_multi(src: torch.Tensor, index: torch.Tensor,
+                      reduces: List[str], dim_size: Optional[int] = None,
+                      unbiased: bool = True) -> torch.Tensor:
+    r"""Equals :obj:`torch.stack([segment_coo(src, index, dim_size=dim_size,
+    reduce=r) for r in reduces])`, but reads :attr:`src` only once.
+    See :meth:`segment_csr_multi` for details."""
+    return torch.ops.torch_scatter.segment_csr_multi(
+        src, coo_to_csr(index, dim_size), reduces, unbiased)
+
+
 def segment_coo(src: torch.Tensor, index: torch.Tensor,
                 out: Optional[torch.Tensor] = None,
-                dim_size: Optional[int] = None,
-                reduce: str = "sum") -> torch.Tensor:
+                dim_size: Optional[int] = None, reduce: str = "sum",
+                weight: Optional[torch.Tensor] = None) -> torch.Tensor:
     r"""
     |
 
@@ -100,7 +144,17 @@ def segment_coo(src: torch.Tensor, index: torch.Tensor,
         If :attr:`dim_size` is not given, a minimal sized output tensor
         according to :obj:`index.max() + 1` is returned.
     :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
-        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+        :obj:`"min"`, :obj:`"max"`, :obj:`"var"`, :obj:`"std"` or
+        :obj:`"logsumexp"`). The latter three are computed in a single pass
+        over index pointers derived from :attr:`index`, and do not support
+        :attr:`out`. (default: :obj:`"sum"`)
+    :param weight: If given, a one-dimensional tensor holding a scale for each
+        entry of :attr:`src` along dimension :obj:`index.dim() - 1`, which is
+        applied while reducing over index pointers derived from
+        :attr:`index`.
+        Only supported for :obj:`"sum"`, :obj:`"mean"`, :obj:`"min"` and
+        :obj:`"max"`, and in case :attr:`out` is not given.
+        (default: :obj:`None`)
 
     :rtype: :class:`Tensor`
 
@@ -120,6 +174,13 @@ def segment_coo(src: torch.Tensor, index: torch.Tensor,
 
         torch.Size([10, 3, 64])
     """
+    if weight is not None:
+        if out is not None:
+            raise ValueError('`weight` is not supported in case `out` is '
+                             'given')
+        reduce = 'sum' if reduce == 'add' else reduce
+        return torch.ops.torch_scatter.segment_weighted_csr(
+            src, coo_to_csr(index, dim_size), weight, reduce)
     if reduce == 'sum' or reduce == 'add':
         return segment_sum_coo(src, index, out, dim_size)
     elif reduce == 'mean':
@@ -128,6 +189,12 @@ def segment_coo(src: torch.Tensor, index: torch.Tensor,
         return segment_min_coo(src, index, out, dim_size)[0]
     elif reduce == 'max':
         return segment_max_coo(src, index, out, dim_size)[0]
+    elif reduce in ['var', 'std', 'logsumexp'] and out is None:
+        if reduce == 'var':
+            return segment_var_coo(src, index, dim_size)
+        elif reduce == 'std':
+            return segment_std_coo(src, index, dim_size)
+        return segment_logsumexp_coo(src, index, dim_size)
     else:
         raise ValueError
 
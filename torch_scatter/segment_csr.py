@@ -1,4 +1,4 @@
-from typing import Optional, Tuple
+from typing import List, Optional, Tuple
 
 import torch
 
@@ -32,9 +32,24 @@ def segment_max_csr(
     return torch.ops.torch_scatter.segment_max_csr(src, indptr, out)
 
 
+def segment_var_csr(src: torch.Tensor, indptr: torch.Tensor,
+                    unbiased: bool = True) -> torch.Tensor:
+    return torch.ops.torch_scatter.segment_var_csr(src, indptr, unbiased)
+
+
+def segment_std_csr(src: torch.Tensor, indptr: torch.Tensor,
+                    unbiased: bool = True) -> torch.Tensor:
+    return torch.ops.torch_scatter.segment_std_csr(src, indptr, unbiased)
+
+
+def segment_logsumexp_csr(src: torch.Tensor,
+                          indptr: torch.Tensor) -> torch.Tensor:
+    return torch.ops.torch_scatter.segment_logsumexp_csr(src, indptr)
+
+
 def segment_csr(src: torch.Tensor, indptr: torch.Tensor,
-                out: Optional[torch.Tensor] = None,
-                reduce: str = "sum") -> torch.Tensor:
+                out: Optional[torch.Tensor] = None, reduce: str = "sum",
+                weight: Optional[torch.Tensor] = None) -> torch.Tensor:
     r"""
     Reduces all values from the :attr:`src` tensor into :attr:`out` within the
     ranges specified in the :attr:`indptr` tensor along the last dimension of
@@ -77,7 +92,17 @@ def segment_csr(src: torch.Tensor, indptr: torch.Tensor,
         equal to :attr:`src`.
     :param out: The destination tensor.
     :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
-        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+        :obj:`"min"`, :obj:`"max"`, :obj:`"var"`, :obj:`"std"` or
+        :obj:`"logsumexp"`). The latter three are computed in a single pass
+        via Welford's algorithm and an online log-sum-exp, respectively,
+        and do not support :attr:`out`. (default: :obj:`"sum"`)
+    :param weight: If given, a one-dimensional tensor holding a scale for each
+        entry of :attr:`src` along dimension :obj:`indptr.dim() - 1`, which
+        is applied while reducing, *i.e.*, without materializing the weighted
+        source tensor.
+        Only supported for :obj:`"sum"`, :obj:`"mean"`, :obj:`"min"` and
+        :obj:`"max"`, and in case :attr:`out` is not given.
+        (default: :obj:`None`)
 
     :rtype: :class:`Tensor`
 
@@ -97,6 +122,13 @@ def segment_csr(src: torch.Tensor, indptr: torch.Tensor,
 
         torch.Size([10, 3, 64])
     """
+    if weight is not None:
+        if out is not None:
+            raise ValueError('`weight` is not supported in case `out` is '
+                             'given')
+        reduce = 'sum' if reduce == 'add' else reduce
+        return torch.ops.torch_scatter.segment_weighted_csr(
+            src, indptr, weight, reduce)
     if reduce == 'sum' or reduce == 'add':
         return segment_sum_csr(src, indptr, out)
     elif reduce == 'mean':
@@ -105,6 +137,12 @@ def segment_csr(src: torch.Tensor, indptr: torch.Tensor,
         return segment_min_csr(src, indptr, out)[0]
     elif reduce == 'max':
         return segment_max_csr(src, indptr, out)[0]
+    elif reduce in ['var', 'std', 'logsumexp'] and out is None:
+        if reduce == 'var':
+            return segment_var_csr(src, indptr)
+        elif reduce == 'std':
+            return segment_std_csr(src, indptr)
+        return segment_logsumexp_csr(src, indptr)
     else:
         raise ValueError
 
@@ -112,3 +150,186 @@ def segment_csr(src: torch.Tensor, indptr: torch.Tensor,
 def gather_csr(src: torch.Tensor, indptr: torch.Tensor,
                out: Optional[torch.Tensor] = None) -> torch.Tensor:
     return torch.ops.torch_scatter.gather_csr(src, indptr, out)
+
+
+def segment_csr_multi(src: torch.Tensor, indptr: torch.Tensor,
+                      reduces: List[str],
+                      unbiased: bool = True) -> torch.Tensor:
+    r"""
+    Computes multiple reductions of :meth:`segment_csr` in a single pass
+    over :attr:`src`, and returns them stacked along a new leading
+    dimension, *i.e.*, the result equals
+
+    .. code-block:: python
+
+        torch.stack([segment_csr(src, indptr, reduce=r) for r in reduces])
+
+    but reads :attr:`src` only once, both in the forward and the backward
+    pass.
+    This is useful for aggregators that combine several reductions over the
+    same segments, *e.g.*, as in Principal Neighbourhood Aggregation (PNA).
+
+    :param src: The source tensor.
+    :param indptr: The index pointers between elements to segment.
+    :param reduces: The reduce operations (any of :obj:`"sum"`,
+        :obj:`"mean"`, :obj:`"min"`, :obj:`"max"`, :obj:`"var"` and
+        :obj:`"std"`), at most eight.
+    :param unbiased: Whether :obj:`"var"` and :obj:`"std"` use Bessel's
+        correction. (default: :obj:`True`)
+
+    :rtype: :class:`Tensor`
+
+    .. code-block:: python
+
+        from torch_scatter import segment_csr_multi
+
+        src = torch.randn(10, 6, 64)
+        indptr = torch.tensor([0, 2, 5, 6])
+        indptr = indptr.view(1, -1)  # Broadcasting in the first and last dim.
+
+        out = segment_csr_multi(src, indptr, ["mean", "min", "max", "std"])
+
+        print(out.size())
+
+    .. code-block::
+
+        torch.Size([4, 10, 3, 64])
+    """
+    return torch.ops.torch_scatter.segment_csr_multi(src, indptr, reduces,
+                                                     unbiased)
+
+
+def segment_csr_gather(src: torch.Tensor, indptr: torch.Tensor,
+                       col: torch.Tensor,
+                       edge_weight: Optional[torch.Tensor] = None,
+                       reduce: str = "sum") -> torch.Tensor:
+    r"""
+    Fused variant of :meth:`segment_csr` that gathers its inputs on the fly.
+    It computes the same result as
+
+    .. code-block:: python
+
+        segment_csr(src[col] * edge_weight.view(-1, 1), indptr, reduce=reduce)
+
+    but never materializes the gathered :obj:`src[col]` tensor, neither in
+    the forward nor in the backward pass.
+    This corresponds to a sparse-dense matrix multiplication (SpMM) between
+    a sparse matrix in CSR format given by :attr:`indptr`, :attr:`col` and
+    :attr:`edge_weight`, and a dense matrix :attr:`src`.
+
+    :param src: The source tensor, gathered along its first dimension.
+    :param indptr: The one-dimensional index pointers of rows to segment.
+    :param col: The indices of :attr:`src` to gather for each entry.
+    :param edge_weight: The optional weight of each entry.
+        (default: :obj:`None`)
+    :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
+        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+
+    :rtype: :class:`Tensor`
+
+    .. code-block:: python
+
+        from torch_scatter import segment_csr_gather
+
+        x = torch.randn(4, 64)
+        indptr = torch.tensor([0, 2, 5, 6])
+        col = torch.tensor([0, 1, 1, 2, 3, 0])
+
+        out = segment_csr_gather(x, indptr, col, reduce="sum")
+
+        print(out.size())
+
+    .. code-block::
+
+        torch.Size([3, 64])
+    """
+    if reduce == 'add':
+        reduce = 'sum'
+    if reduce not in ['sum', 'mean', 'min', 'max']:
+        raise ValueError
+    return torch.ops.torch_scatter.segment_csr_gather(src, indptr, col,
+                                                      edge_weight, reduce)
+
+
+def segment_softmax_csr(src: torch.Tensor, indptr: torch.Tensor,
+                        log: bool = False) -> torch.Tensor:
+    r"""Computes the softmax (or log-softmax if :obj:`log=True`) of all
+    values of :attr:`src` within each segment defined by :attr:`indptr`,
+    *i.e.*, the same result as :meth:`torch_scatter.scatter_softmax` for a
+    sorted index.
+    Maxima and normalizers are computed in a single fused kernel that writes
+    its output exactly once, and the backward pass is fused as well.
+    All entries of :attr:`src` along the reduced dimension need to belong to
+    a segment, *i.e.*, :obj:`indptr[..., 0] == 0` and
+    :obj:`indptr[..., -1] == src.size(indptr.dim() - 1)`.
+
+    :param src: The source tensor.
+    :param indptr: The index pointers between elements to segment.
+    :param log: Whether to compute the log-softmax instead.
+        (default: :obj:`False`)
+
+    :rtype: :class:`Tensor`
+    """
+    if not torch.is_floating_point(src):
+        raise ValueError('`segment_softmax_csr` can only be computed over '
+                         'tensors with floating point data types.')
+    if log:
+        return torch.ops.torch_scatter.segment_log_softmax_csr(src, indptr)
+    return torch.ops.torch_scatter.segment_softmax_csr(src, indptr)
+
+
+def segment_csr_batched(srcs: List[torch.Tensor], indptrs: List[torch.Tensor],
+                        reduce: str = "sum") -> List[torch.Tensor]:
+    r"""
+    Computes :obj:`segment_csr(src, indptr, reduce=reduce)` for each pair of
+    :attr:`srcs` and :attr:`indptrs`, *e.g.*, for many small graphs or the
+    edge types of a heterogeneous graph.
+
+    On the GPU, all problems are reduced within a single kernel launch
+    driven by a device-side array of problem descriptors, and all outputs
+    are views into a single allocation.
+    This avoids the per-call launch and front-end overhead that dominates
+    the runtime of :meth:`segment_csr` on small inputs.
+    Gradients are supported by falling back to one :meth:`segment_csr` call
+    per problem in case any of :attr:`srcs` requires them.
+
+    :param srcs: The source tensors, which need to share their data type
+        and device.
+    :param indptrs: The one-dimensional index pointers between elements to
+        segment along the first dimension of the corresponding source
+        tensor, which need to share their data type.
+    :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
+        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+
+    :rtype: list of :class:`Tensor`
+
+    .. code-block:: python
+
+        from torch_scatter import segment_csr_batched
+
+        srcs = [torch.randn(5, 16), torch.randn(3, 16)]
+        indptrs = [torch.tensor([0, 2, 5]), torch.tensor([0, 1, 1, 3])]
+
+        outs = segment_csr_batched(srcs, indptrs, reduce="sum")
+
+        print([out.size() for out in outs])
+
+    .. code-block::
+
+        [torch.Size([2, 16]), torch.Size([3, 16])]
+    """
+    if reduce == 'add':
+        reduce = 'sum'
+    if reduce not in ['sum', 'mean', 'min', 'max']:
+        raise ValueError
+
+    requires_grad = False
+    for src in srcs:
+        requires_grad = requires_grad or src.requires_grad
+    if requires_grad and torch.is_grad_enabled():
+        return [
+            segment_csr(src, indptr, reduce=reduce)
+            for src, indptr in zip(srcs, indptrs)
+        ]
+
+    return torch.ops.torch_scatter.segment_csr_batched(srcs, indptrs, reduce)
@@ -0,0 +1,138 @@
+from typing import List, Optional, Tuple
+
+import torch
+
+from .segment_csr import segment_csr
+
+
+def chunk_indptr(indptr: torch.Tensor,
+                 chunk_nnz: int) -> List[Tuple[int, int]]:
+    # Splits the segments of a one-dimensional `indptr` into consecutive
+    # row-blocks by grouping all segments starting within the same window of
+    # `chunk_nnz` entries of `src`. Blocks therefore hold at most `chunk_nnz`
+    # entries plus the size of their last segment.
+    if indptr.numel() <= 1:
+        return []
+    window = torch.div(indptr[:-1], chunk_nnz, rounding_mode='floor')
+    count = torch.unique_consecutive(window, return_counts=True)[1]
+    bounds = [0] + count.cumsum(0).tolist()
+    return list(zip(bounds[:-1], bounds[1:]))
+
+
+def segment_csr_stream(src: torch.Tensor, indptr: torch.Tensor,
+                       out: Optional[torch.Tensor] = None,
+                       reduce: str = "sum",
+                       device: Optional[torch.device] = None,
+                       chunk_size: int = 64 * 2**20,
+                       num_streams: int = 2) -> torch.Tensor:
+    r"""Computes :obj:`segment_csr(src, indptr, reduce=reduce)` on the GPU for
+    a :attr:`src` tensor residing in (pinned or memory-mapped) host memory,
+    *e.g.*, in case it does not fit into GPU memory.
+
+    Along the first dimension, :attr:`src` is split into row-blocks of
+    roughly :attr:`chunk_size` bytes each, with boundaries aligned to the
+    segments of :attr:`indptr`.
+    Blocks are processed round-robin on :attr:`num_streams` CUDA streams,
+    each owning its own device buffer, such that the host-to-device copy of
+    one block overlaps with the reduction of the previous one.
+    In case :attr:`src` is not pinned, blocks are staged through pinned
+    buffers first.
+
+    :param src: The source tensor in host memory.
+    :param indptr: The one-dimensional index pointers between elements to
+        segment along the first dimension of :attr:`src`.
+    :param out: The destination tensor on the GPU. (default: :obj:`None`)
+    :param reduce: The reduce operation (:obj:`"sum"`, :obj:`"mean"`,
+        :obj:`"min"` or :obj:`"max"`). (default: :obj:`"sum"`)
+    :param device: The GPU to reduce on in case :attr:`out` is not given.
+        (default: :obj:`None`)
+    :param chunk_size: The targeted size of row-blocks in bytes.
+        (default: :obj:`64MB`)
+    :param num_streams: The number of CUDA streams and buffers to pipeline
+        row-blocks with. (default: :obj:`2`)
+
+    :rtype: :class:`Tensor`
+
+    .. code-block:: python
+
+        from torch_scatter import segment_csr_stream
+
+        src = torch.randn(100_000_000, 16).pin_memory()
+        indptr = torch.tensor([0, 40_000_000, 60_000_000, 100_000_000])
+
+        out = segment_csr_stream(src, indptr, reduce="sum")
+
+        print(out.device, out.size())
+
+    .. code-block::
+
+        cuda:0 torch.Size([3, 16])
+    """
+    if reduce not in ['sum', 'add', 'mean', 'min', 'max']:
+        raise ValueError
+    assert src.device.type == 'cpu' and indptr.dim() == 1
+    assert num_streams >= 1 and not src.requires_grad
+
+    if out is not None:
+        device = out.device
+    elif device is None:
+        device = torch.device('cuda', torch.cuda.current_device())
+
+    src = src.contiguous()
+    size = list(src.size())
+    size[0] = max(indptr.numel() - 1, 0)
+    if out is None:
+        out = torch.empty(size, dtype=src.dtype, device=device)
+    assert out.is_contiguous() and list(out.size()) == size
+
+    row_size = max(torch.Size(size[1:]).numel(), 1)
+    chunk_nnz = max(chunk_size // (row_size * src.element_size()), 1)
+    indptr_cpu = indptr.to('cpu', torch.long)
+    chunks = chunk_indptr(indptr_cpu, chunk_nnz)
+    if len(chunks) == 0:
+        return out
+    max_nnz = max(int(indptr_cpu[e] - indptr_cpu[s]) for s, e in chunks)
+
+    # Buffers are allocated on the current stream, which every stream waits
+    # on before its first copy.
+    buf_size = [max_nnz] + size[1:]
+    num_streams = min(num_streams, len(chunks))
+    current_stream = torch.cuda.current_stream(device)
+    streams = [torch.cuda.Stream(device) for _ in range(num_streams)]
+    buffers = [src.new_empty(buf_size, device=device) for _ in streams]
+    staging: List[torch.Tensor] = []
+    copied: List[Optional[torch.cuda.Event]] = [None] * num_streams
+    if not src.is_pinned():
+        staging = [src.new_empty(buf_size).pin_memory() for _ in streams]
+    indptr = indptr_cpu.to(device, non_blocking=True)
+
+    for stream in streams:
+        stream.wait_stream(current_stream)
+
+    for i, (start, end) in enumerate(chunks):
+        b = i % num_streams
+        lo, hi = int(indptr_cpu[start]), int(indptr_cpu[end])
+        with torch.cuda.stream(streams[b]):
+            if hi == lo:  # Only empty segments.
+                out[start:end].zero_()
+                continue
+            if len(staging) > 0:
+                # The staging buffer is still read by the previous copy.
+                event = copied[b]
+                if event is not None:
+                    event.synchronize()
+                staging[b][:hi - lo].copy_(src[lo:hi])
+                block = staging[b][:hi - lo]
+            else:
+                block = src[lo:hi]
+            buffer = buffers[b][:hi - lo]
+            buffer.copy_(block, non_blocking=True)
+            event = torch.cuda.Event()
+            event.record()
+            copied[b] = event
+            segment_csr(buffer, indptr[start:end + 1] - lo, out[start:end],
+                        reduce)
+
+    for stream in streams:
+        current_stream.wait_stream(stream)
+    return out
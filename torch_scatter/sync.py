@@ -0,0 +1,23 @@
+import torch
+
+
+def host_sync_count(reset: bool = False) -> int:
+    r"""Returns the number of host-device syncs performed by GPU operations
+    in order to infer their output size, *e.g.*, when calling
+    :meth:`torch_scatter.scatter` without passing :obj:`dim_size`.
+
+    Syncs can be avoided by passing the output size explicitly, or by setting
+    the environment variable :obj:`TORCH_SCATTER_SYNC_MODE` to
+    :obj:`"cache"` (sync once per index tensor) or :obj:`"strict"` (never
+    sync and raise an error instead).
+
+    :param reset: If set to :obj:`True`, resets the counter to zero.
+        (default: :obj:`False`)
+
+    :rtype: :class:`int`
+    """
+    # Each extension only reports the syncs of its own operations:
+    count = torch.ops.torch_scatter.scatter_host_syncs(reset)
+    count += torch.ops.torch_scatter.segment_coo_host_syncs(reset)
+    count += torch.ops.torch_scatter.segment_csr_host_syncs(reset)
+    return count
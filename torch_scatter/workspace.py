@@ -0,0 +1,62 @@
+from typing import Dict, Optional
+
+import torch
+
+
+def bind_workspace(
+        buffer: Optional[torch.Tensor]) -> Optional[torch.Tensor]:
+    r"""Binds the one-dimensional :obj:`torch.uint8` tensor :attr:`buffer`
+    as workspace of all operations called from the current thread, or
+    unbinds the current workspace in case :attr:`buffer` is :obj:`None`.
+    Returns the previously bound workspace (or :obj:`None`), such that it
+    can be restored afterwards.
+
+    Scratch memory that kernels only need for the duration of a single call
+    (*e.g.*, packed value-argument keys of :obj:`"min"` and :obj:`"max"`,
+    partial results of load-balanced :meth:`segment_csr`, or the
+    accumulators of :meth:`scatter_softmax`) is then carved out of
+    :attr:`buffer` instead of being allocated and released on every call.
+    Requests that do not fit into :attr:`buffer` or target another device
+    fall back to regular allocations.
+    Outputs and tensors saved for the backward pass are never taken from the
+    workspace.
+
+    Since the workspace is re-used by subsequent calls, it must only be used
+    by operations running on a single stream.
+    Backward passes that are executed by autograd worker threads (*e.g.*, on
+    the GPU) do not see the binding.
+    Use :meth:`workspace_stats` to determine the required size.
+
+    :param buffer: The workspace. (default: :obj:`None`)
+
+    :rtype: :class:`Tensor` or :obj:`None`
+    """
+    previous = torch.ops.torch_scatter.scatter_bind_workspace(buffer)
+    torch.ops.torch_scatter.segment_coo_bind_workspace(buffer)
+    torch.ops.torch_scatter.segment_csr_bind_workspace(buffer)
+    return previous
+
+
+def workspace_stats(reset: bool = False) -> Dict[str, int]:
+    r"""Returns the number of scratch buffer requests of the current thread
+    that were served from (:obj:`"hits"`) or missed (:obj:`"misses"`) the
+    workspace bound via :meth:`bind_workspace`, and the number of bytes a
+    workspace needs to hold in order to serve all requests of any single
+    call so far (:obj:`"peak"`).
+
+    :param reset: If set to :obj:`True`, resets all statistics to zero.
+        (default: :obj:`False`)
+
+    :rtype: :class:`Dict[str, int]`
+    """
+    # Each extension only reports the requests of its own operations:
+    stats = [
+        torch.ops.torch_scatter.scatter_workspace_stats(reset),
+        torch.ops.torch_scatter.segment_coo_workspace_stats(reset),
+        torch.ops.torch_scatter.segment_csr_workspace_stats(reset),
+    ]
+    return {
+        'hits': sum([s[0] for s in stats]),
+        'misses': sum([s[1] for s in stats]),
+        'peak': max([s[2] for s in stats]),
+    }